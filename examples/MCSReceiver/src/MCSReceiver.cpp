@@ -60,6 +60,12 @@ void setup() {
   rx->setMix(speedInput, AxisMix(0, INTERP_LIN_CENTERED));
   rx->setMix(turnInput, AxisMix(1, INTERP_LIN_CENTERED));
 
+  // If your mixes never change, you can instead fix them at compile time, which makes handling packets 
+  // considerably cheaper. Declare the receiver globally:
+  //   MStaticReceiver<StaticMix<0, INTERP_LIN_CENTERED>, StaticMix<1, INTERP_LIN_CENTERED>> 
+  //     staticRx({INPUT_NAME_SPEED, INPUT_NAME_TURN_RATE}, {&speed, &turn});
+  // and use rx = protocol.createReceiver(&staticRx) above instead of addInput() and setMix().
+
   // Tell the receiver to call dataFinishedCB() whenever a packet was handled
   rx->setDataFinishedCallback(dataFinishedCB);
 
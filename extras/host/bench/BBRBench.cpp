@@ -0,0 +1,50 @@
+#include "BBRBench.h"
+#include <Arduino.h>
+#include <string.h>
+#include <vector>
+
+using namespace bb;
+using namespace bb::bench;
+
+struct Entry {
+    const char* name;
+    BenchFn fn;
+};
+
+static std::vector<Entry>& registry() {
+    static std::vector<Entry> entries;
+    return entries;
+}
+
+static unsigned int failures_ = 0;
+
+Registrar::Registrar(const char* name, BenchFn fn) {
+    registry().push_back({name, fn});
+}
+
+bool bb::bench::check(bool condition, const char* what) {
+    if(!condition) {
+        printf("  CHECK FAILED: %s\n", what);
+        failures_++;
+    }
+    return condition;
+}
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+
+    // Library diagnostics go to Serial; keep them out of the results.
+    Serial.setMuted(true);
+
+    for(auto& e: registry()) {
+        if(filter != nullptr && strstr(e.name, filter) == nullptr) continue;
+        printf("%s\n", e.name);
+        e.fn();
+    }
+
+    if(failures_ != 0) {
+        printf("%u check(s) failed\n", failures_);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+#if !defined(BBRBENCH_H)
+#define BBRBENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+
+namespace bb {
+namespace bench {
+
+/**
+ * Tiny microbenchmark harness for the host build.
+ * 
+ * Benchmarks register themselves with `BBR_BENCH(name)` and are run by `bbrbench [filter]`.
+ * Inside a benchmark, `measure()` times a callable and reports ns/op; `check()` records a
+ * correctness failure, which makes `bbrbench` exit non-zero. Benchmarks verify their results
+ * against the reference implementation before timing, so a fast-but-wrong change shows up.
+ */
+
+typedef void (*BenchFn)();
+
+struct Registrar {
+    Registrar(const char* name, BenchFn fn);
+};
+
+//! Keep the compiler from optimizing away a computed value.
+template<typename T> inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+//! Prevent the compiler from caching memory contents across this point.
+inline void clobberMemory() {
+    asm volatile("" : : : "memory");
+}
+
+//! Run `fn` `iterations` times (after a short warmup), print and return ns per call.
+template<typename F> double measure(const char* label, uint64_t iterations, F fn) {
+    for(uint64_t i=0; i<iterations/10+1; i++) fn();
+    auto start = std::chrono::steady_clock::now();
+    for(uint64_t i=0; i<iterations; i++) fn();
+    auto end = std::chrono::steady_clock::now();
+    double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count()) / double(iterations);
+    printf("  %-56s %10.2f ns/op\n", label, ns);
+    return ns;
+}
+
+//! Print a measured value that is not a ns/op timing, in the same format.
+inline void report(const char* label, double value, const char* unit) {
+    ::printf("  %-56s %10.2f %s\n", label, value, unit);
+}
+
+//! Record a correctness failure if `condition` is false.
+bool check(bool condition, const char* what);
+
+}; // bench
+}; // bb
+
+#define BBR_BENCH_CONCAT2(a, b) a##b
+#define BBR_BENCH_CONCAT(a, b) BBR_BENCH_CONCAT2(a, b)
+#define BBR_BENCH(name) \
+    static void name(); \
+    static bb::bench::Registrar BBR_BENCH_CONCAT(name, _registrar)(#name, name); \
+    static void name()
+
+#endif // BBRBENCH_H
@@ -0,0 +1,156 @@
+// Debug messages are compiled out in this file, so the benchmarks can check that they cost nothing.
+#define BBR_LOG_LEVEL BBR_LOG_LEVEL_INFO
+
+#include "BBRBench.h"
+#include "BBRLog.h"
+#include <string.h>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace bb;
+using namespace bb::rmt;
+using namespace bb::bench;
+
+enum TestEnum { TEST_ENUM_A = 3, TEST_ENUM_B = -7 };
+
+// Log deferred, format from the ring, and compare with snprintf() of the same arguments.
+template<typename... Args> static bool formatsLikeSnprintf(const char* format, Args... args) {
+    char want[Log::LINE_LENGTH], got[Log::LINE_LENGTH];
+    snprintf(want, sizeof(want), format, args...);
+    Log::log(Log::LEVEL_INFO, format, args...);
+    if(!Log::pop(got, sizeof(got))) return false;
+    if(strcmp(want, got) == 0) return true;
+    ::printf("    \"%s\": want \"%s\", got \"%s\"\n", format, want, got);
+    return false;
+}
+
+static const unsigned int RING_SIZE = 64;
+
+BBR_BENCH(deferredLog) {
+    check(Log::setDeferred(true, RING_SIZE), "deferred logging turns on");
+    char buf[Log::LINE_LENGTH];
+    while(Log::pop(buf, sizeof(buf)));
+
+    bool same = true;
+    same &= formatsLikeSnprintf("plain text\n");
+    same &= formatsLikeSnprintf("%d %i %u %x %X %o", -5, 17, 7u, 0xbeefu, 0xabcu, 8u);
+    same &= formatsLikeSnprintf("%ld %lu %lx", -100000L, 4000000000UL, 0xdeadbeefUL);
+    same &= formatsLikeSnprintf("%lld %llu", -(1LL << 40), 1ULL << 63);
+    same &= formatsLikeSnprintf("%hhd %hhu %hd %hu", 300, 300, 70000, 70000);
+    same &= formatsLikeSnprintf("[%5d|%-5d|%05d|%+d|% d]", 42, 42, 42, 42, 42);
+    same &= formatsLikeSnprintf("[%*d|%-*s|%.*f]", 6, 42, 8, "ab", 3, 3.14159);
+    same &= formatsLikeSnprintf("%.2f %e %g %f", 1.005, 12345.678, 0.0001, float(2.5f));
+    same &= formatsLikeSnprintf("%#x %#o %8.3s|", 255u, 8u, "abcdef");
+    same &= formatsLikeSnprintf("%c%c %s", 'o', 'k', "done");
+    same &= formatsLikeSnprintf("%p", (const void*)&same);
+    same &= formatsLikeSnprintf("100%% of %d", 5);
+    same &= formatsLikeSnprintf("enum %d %d", TEST_ENUM_A, TEST_ENUM_B);
+    same &= formatsLikeSnprintf("0x%02x 0x%02x", uint8_t(0x0a), uint16_t(0xff));
+    check(same, "deferred messages format the same as snprintf()");
+
+    std::string name("temporary");
+    BBR_LOGW("Node \"%s\" at %s\n", name.c_str(), std::string("00:11:22").c_str());
+    name = "overwritten";
+    Log::Level level;
+    check(Log::pop(buf, sizeof(buf), &level) && !strcmp(buf, "Node \"temporary\" at 00:11:22\n") &&
+          level == Log::LEVEL_WARN, "string arguments are copied when logged");
+
+    std::string longName(100, 'x');
+    Log::log(Log::LEVEL_INFO, "%s", longName.c_str());
+    check(Log::pop(buf, sizeof(buf)) && strlen(buf) == Log::STRING_SPACE - 1, "long strings are cut off");
+    Log::log(Log::LEVEL_INFO, "%d %d", 1);
+    check(Log::pop(buf, sizeof(buf)) && !strcmp(buf, "1 ?"), "missing arguments print as ?");
+    Log::log(Log::LEVEL_INFO, "%d%d%d%d%d%d%d", 1, 2, 3, 4, 5, 6, 7);
+    check(Log::pop(buf, sizeof(buf)) && !strcmp(buf, "123456?"), "arguments past MAX_ARGS print as ?");
+    check(!Log::pop(buf, sizeof(buf)), "ring is empty after popping everything");
+
+    int evaluated = 0;
+    BBR_LOGD("%d\n", ++evaluated);
+    check(evaluated == 0 && !Log::pop(buf, sizeof(buf)), "compiled-out levels don't evaluate their arguments");
+
+    // Overfill the ring: the newest messages are dropped, the stored ones stay in order
+    uint32_t droppedBefore = Log::dropped();
+    for(unsigned int i=0; i<RING_SIZE+10; i++) BBR_LOGI("message %u\n", i);
+    check(Log::dropped() - droppedBefore == 10, "messages that don't fit are counted as dropped");
+    bool inOrder = true;
+    for(unsigned int i=0; i<RING_SIZE; i++) {
+        char want[32];
+        snprintf(want, sizeof(want), "message %u\n", i);
+        inOrder &= Log::pop(buf, sizeof(buf)) && !strcmp(buf, want);
+    }
+    check(inOrder && !Log::pop(buf, sizeof(buf)), "stored messages come out oldest first");
+
+    // Several producers against one consumer: every message either arrives intact or is counted as dropped
+    const unsigned int numThreads = 4, perThread = 20000;
+    droppedBefore = Log::dropped();
+    std::atomic<unsigned int> finished(0);
+    std::vector<std::thread> threads;
+    for(unsigned int t=0; t<numThreads; t++) {
+        threads.emplace_back([t, &finished]() {
+            for(unsigned int i=0; i<perThread; i++) BBR_LOGI("thread %u message %u %s\n", t, i, "payload");
+            finished++;
+        });
+    }
+    unsigned int popped = 0;
+    bool intact = true;
+    std::vector<int> lastSeen(numThreads, -1);
+    auto drain = [&]() {
+        while(Log::pop(buf, sizeof(buf))) {
+            unsigned int t, i;
+            char word[16];
+            if(sscanf(buf, "thread %u message %u %15s", &t, &i, word) != 3 || t >= numThreads ||
+               int(i) <= lastSeen[t] || strcmp(word, "payload")) {
+                intact = false;
+                continue;
+            }
+            lastSeen[t] = i;
+            popped++;
+        }
+    };
+    while(finished < numThreads) drain();
+    for(auto& th: threads) th.join();
+    drain();
+    check(intact, "messages from concurrent producers arrive intact and in per-producer order");
+    check(popped + (Log::dropped() - droppedBefore) == numThreads * perThread,
+          "every concurrent message is either delivered or counted as dropped");
+    report("concurrent messages delivered", 100.0 * popped / (numThreads * perThread), "%");
+
+    // Cost at the call site. Serial is muted, so immediate mode measures formatting, not the port.
+    Log::setDeferred(false);
+    measure("bb::rmt::printf(), 3 args", 1000000, [&]() {
+        bb::rmt::printf("Got control packet from %s, seqnum %d, %d bytes\n", "0013a200:41b4c8e2", 5, 18);
+    });
+    measure("BBR_LOGW() printing right away, 3 args", 1000000, [&]() {
+        BBR_LOGW("Got control packet from %s, seqnum %d, %d bytes\n", "0013a200:41b4c8e2", 5, 18);
+    });
+    measure("BBR_LOGD() compiled out", 10000000, [&]() {
+        BBR_LOGD("Got control packet from %s, seqnum %d, %d bytes\n", "0013a200:41b4c8e2", 5, 18);
+        clobberMemory();
+    });
+
+    // Storing and formatting are timed apart, a ring's worth at a time
+    Log::setDeferred(true);
+    const unsigned int rounds = 20000;
+    std::chrono::nanoseconds storing(0), formatting(0);
+    for(unsigned int r=0; r<rounds; r++) {
+        auto t0 = std::chrono::steady_clock::now();
+        for(unsigned int i=0; i<RING_SIZE; i++) {
+            BBR_LOGW("Got control packet from %s, seqnum %d, %d bytes\n", "0013a200:41b4c8e2", 5, 18);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        while(Log::pop(buf, sizeof(buf)));
+        auto t2 = std::chrono::steady_clock::now();
+        storing += t1 - t0;
+        formatting += t2 - t1;
+    }
+    report("BBR_LOGW() deferred, 3 args", double(storing.count()) / (rounds * RING_SIZE), "ns/op");
+    report("Log::pop(), formatting the same message", double(formatting.count()) / (rounds * RING_SIZE), "ns/op");
+    while(Log::pop(buf, sizeof(buf)));
+    measure("BBR_LOGW() deferred, ring full (dropped)", 1000000, [&]() {
+        BBR_LOGW("Got control packet from %s, seqnum %d, %d bytes\n", "0013a200:41b4c8e2", 5, 18);
+    });
+    Log::setDeferred(false);
+}
@@ -0,0 +1,728 @@
+#include "BBRBench.h"
+#include "BBRHostHAL.h"
+#include "MCS/Loopback/BBRMLoopbackProtocol.h"
+#include "MCS/BBRMTransmitter.h"
+#include "BBRLatencyStats.h"
+
+#include <algorithm>
+
+using namespace bb;
+using namespace bb::rmt;
+using namespace bb::bench;
+
+// One remote and one droid on a simulated link, running on virtual time.
+struct LoopbackSystem {
+    MLoopbackMedium medium;
+    MLoopbackProtocol remote, droid;
+    Transmitter* tx;
+    Receiver* rx;
+    float speed, turn;
+    unsigned int callbacks;
+
+    LoopbackSystem(unsigned long latencyUS, unsigned long jitterUS, float loss): remote(medium), droid(medium) {
+        medium.setLatencyUS(latencyUS, jitterUS);
+        medium.setLossRate(loss);
+        speed = turn = 0;
+        callbacks = 0;
+
+        droid.init("Droid");
+        rx = droid.createReceiver();
+        InputID speedInput = rx->addInput(INPUT_NAME_SPEED, [this](float v) { speed = v; callbacks++; });
+        InputID turnInput = rx->addInput(INPUT_NAME_TURN_RATE, turn);
+        rx->setMix(speedInput, AxisMix(0, INTERP_LIN_CENTERED));
+        rx->setMix(turnInput, AxisMix(1, INTERP_LIN_CENTERED));
+
+        remote.init("Remote");
+        remote.setTransmittersArePrimary(true);
+        tx = remote.createTransmitter();
+    }
+
+    bool pair() {
+        remote.discoverNodes(1.1);
+        if(remote.numDiscoveredNodes() != 1) return false;
+        return remote.pairWith(remote.discoveredNode(0)) && remote.isPaired();
+    }
+
+    void run(unsigned long us, unsigned long tickUS = 100) {
+        for(unsigned long t=0; t<us; t+=tickUS) {
+            medium.stepAll();
+            bb::hal::advanceMicros(tickUS);
+        }
+    }
+};
+
+BBR_BENCH(loopbackEndToEnd) {
+    bb::hal::setVirtualTime(true);
+    Protocol::setTransmitFrequencyHz(50);
+
+    LoopbackSystem sys(2000, 1000, 0);
+
+    unsigned long start = micros();
+    check(sys.pair(), "remote pairs with droid over loopback");
+    report("pairing (discovery + pairWith)", (micros()-start)/1000.0f, "ms (virtual)");
+
+    start = micros();
+    check(sys.remote.retrieveInputs(sys.remote.pairedNodes()[0]), "retrieveInputs() succeeds");
+    report("retrieveInputs(), 2 inputs", (micros()-start)/1000.0f, "ms (virtual)");
+    NodeAddr droidAddr = sys.droid.address();
+    check(sys.remote.numInputs(droidAddr) == 2 && 
+          sys.remote.inputName(droidAddr, 0) == INPUT_NAME_SPEED, "retrieved inputs match the droid's");
+
+    // Stick-to-callback latency: move the stick at a random phase relative to the transmit
+    // cycle and wait for the droid's input callback to see the new value.
+    const unsigned int numSamples = 200;
+    unsigned long sumUS = 0, maxUS = 0;
+#if defined(BBR_LATENCY_STATS)
+    LatencyStats::reset();
+#endif
+#if defined(BBR_STEP_PROFILER)
+    sys.remote.stepProfiler().reset(); // pairing and retrieveInputs() block transmits
+#endif
+    bool allArrived = true;
+    for(unsigned int i=0; i<numSamples; i++) {
+        sys.run(1000 + (i*7919) % 20000);
+        float target = (i%2) ? 1.0f : -1.0f;
+        sys.tx->setAxisValue(0, target, UNIT_UNITY_CENTERED);
+        unsigned long t0 = micros();
+        while(fabs(sys.speed - target) > 0.01 && micros()-t0 < 1000000) sys.run(50, 50);
+        unsigned long latency = micros()-t0;
+        if(fabs(sys.speed - target) > 0.01) allArrived = false;
+        sumUS += latency;
+        if(latency > maxUS) maxUS = latency;
+    }
+    check(allArrived, "every stick movement reaches the droid");
+    report("stick-to-callback latency, mean @50Hz, 2+-1ms link", sumUS/1000.0f/numSamples, "ms (virtual)");
+    report("stick-to-callback latency, max", maxUS/1000.0f, "ms (virtual)");
+
+#if defined(BBR_LATENCY_STATS)
+    // Per-stage breakdown of the same runs, as seen by the instrumentation hooks.
+    for(uint8_t s=0; s<LatencyStats::NUM_STAGES; s++) {
+        const Histogram& h = LatencyStats::histogram(LatencyStats::Stage(s));
+        std::string label = std::string("  stage ") + LatencyStats::stageName(LatencyStats::Stage(s));
+        report((label + " p50").c_str(), h.percentile(50)/1000.0f, "ms (virtual, upper bound)");
+        report((label + " max").c_str(), h.max()/1000.0f, "ms (virtual)");
+    }
+    const Histogram& e2e = LatencyStats::histogram(LatencyStats::SET_TO_CALLBACK);
+    check(e2e.count() >= numSamples, "every stick movement is stamped end to end");
+    check(LatencyStats::histogram(LatencyStats::TRANSMIT_TO_RECEIVE).max() <= 3000, 
+          "transmit->receive stays within the simulated 2+-1ms link");
+#endif
+
+#if defined(BBR_STEP_PROFILER)
+    // Virtual time doesn't advance inside step(), so durations are all zero here; what we can check is that
+    // transmits happen on schedule when step() is called every 50-100us.
+    const Histogram& jitter = sys.remote.stepProfiler().transmitJitterHistogram();
+    report("transmit jitter @50Hz, step() every 50-100us, p99", jitter.percentile(99), "us (virtual, upper bound)");
+    report("transmit jitter, max", jitter.max(), "us (virtual)");
+    check(jitter.count() > 0 && jitter.max() <= 150, "transmit period stays within one step() interval of nominal");
+#endif
+
+    // Host cost of simulating the full transmit -> receive -> callback path.
+    Protocol::setTransmitFrequencyHz(250);
+    unsigned int callbacksBefore = sys.callbacks;
+    double ns = measure("simulated 100us tick (both nodes step)", 200000, [&]() {
+        sys.medium.stepAll();
+        bb::hal::advanceMicros(100);
+    });
+    unsigned int packets = sys.callbacks - callbacksBefore;
+    if(packets > 0) {
+        report("host cost per delivered control packet", ns * 220000 / packets, "ns/packet");
+    }
+
+    Protocol::setTransmitFrequencyHz(50);
+    bb::hal::setVirtualTime(false);
+}
+
+BBR_BENCH(loopbackLossyLink) {
+    bb::hal::setVirtualTime(true);
+    Protocol::setTransmitFrequencyHz(50);
+
+    LoopbackSystem sys(2000, 0, 0.2);
+    check(sys.pair(), "pairing succeeds on a 20% lossy link");
+    unsigned int before = sys.callbacks;
+    unsigned long sentBefore = sys.medium.numSent(), deliveredBefore = sys.medium.numDelivered();
+    sys.remote.resetStats();
+    sys.droid.resetStats();
+    sys.run(10000000);
+
+    ProtocolStats rs = sys.remote.stats(), ds = sys.droid.stats();
+    check(rs.packetsSent == sys.medium.numSent() - sentBefore, "remote counts every packet sent");
+    check(ds.packetsReceived == sys.medium.numDelivered() - deliveredBefore, "droid counts every packet delivered");
+    check(ds.packetsByType[MPacket::PACKET_TYPE_CONTROL] == sys.callbacks - before, "one control packet per callback");
+    check(sys.remote.nodeStats(sys.droid.address()).packetsSent == rs.packetsSent, "per node send counter matches");
+    report("effective update rate @50Hz, 20% loss", (sys.callbacks-before)/10.0f, "Hz (virtual)");
+    report("packets lost", 100.0*sys.medium.numLost()/sys.medium.numSent(), "%");
+
+    bb::hal::setVirtualTime(false);
+}
+
+BBR_BENCH(sequenceTracking) {
+    // Tracker alone: a sender's stream through a bursty (two-state) lossy link that delays packets by up to two
+    // send intervals and duplicates some. Arrival order is by delivery time. The stream ends with a clean stretch,
+    // so all losses have fallen out of the reorder window.
+    struct Arrival { uint32_t at; uint16_t seq; };
+    std::vector<Arrival> arrivals;
+    const uint16_t numPackets = 20000;
+    uint32_t seed = 4711, truthLost = 0, truthDup = 0;
+    bool bad = false;
+    auto rnd = [&seed]() { seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5; return seed; };
+    for(uint16_t s=0; s<numPackets; s++) {
+        bool clean = s >= numPackets - 32;
+        bad = bad ? (rnd() % 100) < 60 : (rnd() % 100) < 3;
+        if(bad && !clean) { truthLost++; continue; }
+        unsigned int copies = (rnd() % 100) < 3 && !clean ? 2 : 1;
+        truthDup += copies - 1;
+        for(unsigned int c=0; c<copies; c++) arrivals.push_back({uint32_t(s)*100 + rnd() % 250, s});
+    }
+    std::stable_sort(arrivals.begin(), arrivals.end(), [](const Arrival& a, const Arrival& b) { return a.at < b.at; });
+
+    for(uint8_t bits: {3, 7}) {
+        SequenceTracker tracker(bits);
+        uint32_t lost = 0, dup = 0, late = 0, bursts = 0, maxBurst = 0;
+        for(auto& a: arrivals) {
+            SequenceTracker::Loss l;
+            SequenceTracker::Result res = tracker.track(a.seq, l);
+            if(res == SequenceTracker::SEQ_DUPLICATE) dup++;
+            else if(res == SequenceTracker::SEQ_LATE) late++;
+            lost += l.lost;
+            bursts += l.bursts;
+            if(l.longestBurst > maxBurst) maxBurst = l.longestBurst;
+        }
+        if(bits == 7) {
+            check(lost == truthLost, "7 bit sequence: every lost packet is counted");
+            check(dup == truthDup, "7 bit sequence: every duplicate is detected");
+            check(late > 0, "7 bit sequence: reordered packets are detected");
+            report("true loss rate, bursty link", 100.0 * truthLost / numPackets, "%");
+            report("loss bursts, mean length", bursts ? double(lost) / bursts : 0, "packets");
+            report("loss bursts, max length", maxBurst, "packets");
+        }
+        std::string label = std::string("loss estimate, ") + char('0' + bits) + " bit sequence";
+        report(label.c_str(), 100.0 * lost / numPackets, "%");
+    }
+
+    SequenceTracker tracker(7);
+    size_t i = 0;
+    measure("SequenceTracker::track()", 10000000, [&]() {
+        SequenceTracker::Loss l;
+        doNotOptimize(tracker.track(arrivals[i].seq, l));
+        if(++i == arrivals.size()) i = 0;
+    });
+
+    // End to end: a stick ramping up steadily over a link with 30ms jitter (packets every 20ms), 10% loss and
+    // 5% duplicates. Late and duplicate control packets must not reach the mix, or the droid would see the
+    // stick move backwards.
+    bb::hal::setVirtualTime(true);
+    Protocol::setTransmitFrequencyHz(50);
+    LoopbackSystem sys(2000, 30000, 0);
+    sys.droid.setExtendedSequence(true);
+    check(sys.pair(), "pairing succeeds on a jittery link");
+    sys.tx->setAxisValue(0, -1, UNIT_UNITY_CENTERED);
+    sys.run(500000);
+
+    sys.droid.resetStats();
+    sys.medium.setLossRate(0.1);
+    sys.medium.setDuplicateRate(0.05);
+    unsigned long lostBefore = sys.medium.numLost(), dupBefore = sys.medium.numDuplicated();
+    const unsigned long durationUS = 10000000, tickUS = 500;
+    float lastSpeed = sys.speed;
+    bool monotonic = true;
+    for(unsigned long t=0; t<durationUS; t+=tickUS) {
+        sys.tx->setAxisValue(0, -0.9f + 1.8f*t/durationUS, UNIT_UNITY_CENTERED);
+        sys.run(tickUS, tickUS);
+        if(sys.speed < lastSpeed) monotonic = false;
+        lastSpeed = sys.speed;
+    }
+    check(monotonic, "stick ramp never goes backwards at the droid");
+
+    // A clean second, so the last losses fall out of the reorder window and the last duplicates arrive
+    sys.medium.setLossRate(0);
+    sys.medium.setDuplicateRate(0);
+    sys.run(1000000);
+    NodeStats ns = sys.droid.nodeStats(sys.remote.address());
+    check(ns.packetsLost == sys.medium.numLost() - lostBefore, "droid's loss count matches the medium's");
+    check(ns.duplicates == sys.medium.numDuplicated() - dupBefore, "droid's duplicate count matches the medium's");
+    check(ns.reordered > 0 && sys.droid.stats().reordered == ns.reordered, "reordered packets are detected and counted");
+    report("loss rate seen by the droid, 10% loss", 100.0 * ns.lossRate(), "%");
+    report("late packets dropped, 30ms jitter @50Hz", 100.0 * ns.reordered / ns.packetsSequenced, "%");
+
+    bb::hal::setVirtualTime(false);
+}
+
+BBR_BENCH(sequenceResync) {
+    // Good control packets must get through after a long burst of lost ones, and after the remote restarts.
+    // A restart is simulated by setting the remote's sequence number back a few packets during a silence.
+    bb::hal::setVirtualTime(true);
+    Protocol::setTransmitFrequencyHz(50);
+    for(int ext=0; ext<2; ext++) {
+        LoopbackSystem sys(2000, 0, 0);
+        sys.droid.setExtendedSequence(ext);
+        check(sys.pair(), "pairing succeeds");
+        unsigned int timeouts = 0;
+        sys.droid.setCommTimeoutWatchdog(0.25, [&timeouts](Protocol*, float) { timeouts++; });
+        sys.run(200000);
+
+        // Every packet sent from now on arrives and is dispatched
+        auto allArrive = [&sys](unsigned long us) {
+            unsigned long sentBefore = sys.medium.numSent(), callbacksBefore = sys.callbacks;
+            sys.run(us);
+            return sys.callbacks - callbacksBefore + sys.medium.numInFlight() == sys.medium.numSent() - sentBefore;
+        };
+
+        sys.medium.setLossRate(1);
+        sys.run(6*20000 + 5000);
+        sys.medium.setLossRate(0);
+        check(allArrive(200000), ext ? "7 bit sequence: packets after a burst of 6 lost ones are dispatched" :
+                                       "3 bit sequence: packets after a burst of 6 lost ones are dispatched");
+
+        timeouts = 0;
+        sys.medium.setLossRate(1);
+        unsigned long sentBefore = sys.medium.numSent();
+        sys.run(500000);
+        unsigned int back = sys.medium.numSent() - sentBefore + 5;
+        for(unsigned int i=0; i<16*MAX_SEQUENCE_NUMBER - back; i++) sys.remote.bumpSeqnum();
+        sys.medium.setLossRate(0);
+        check(allArrive(200000) && timeouts == 1, ext ? "7 bit sequence: packets after a comm timeout are dispatched" :
+                                                        "3 bit sequence: packets after a comm timeout are dispatched");
+    }
+    bb::hal::setVirtualTime(false);
+}
+
+BBR_BENCH(deltaControl) {
+    // Codec: random keyframes with a few changed axes
+    bool roundTrip = true, wireOK = true;
+    uint32_t seed = 99;
+    for(int n=0; n<10000; n++) {
+        uint32_t key[MControlPacket::NUM_AXES], raw[MControlPacket::NUM_AXES], out[MControlPacket::NUM_AXES];
+        for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+            seed = seed * 1103515245 + 12345;
+            key[i] = raw[i] = (seed >> 8) & MCONTROL_AXIS_FIELDS[i].mask;
+        }
+        for(uint8_t k=0; k<=n%6; k++) {
+            seed = seed * 1103515245 + 12345;
+            uint8_t i = (seed >> 16) % MControlPacket::NUM_AXES;
+            raw[i] = (seed >> 4) & MCONTROL_AXIS_FIELDS[i].mask;
+        }
+
+        MPacket packet(MPacket::PACKET_TYPE_CONTROL, MPacket::PACKET_SOURCE_LEFT_REMOTE, n);
+        packet.extended = 1;
+        if(!packet.payload.delta.encode(n & 0xff, key, raw, n & 1)) { roundTrip = false; continue; }
+        packet.crc = packet.calculateCRC();
+
+        uint8_t wire[sizeof(MPacket)];
+        uint8_t len = packet.toWire(wire);
+        MPacketView view(wire, len);
+        MPacket received;
+        if(len >= sizeof(MPacket) || !view.valid() || !view.isDelta() || view.deltaKeyframe() != (n & 0xff) ||
+           !received.fromWire(wire, len) || received.calculateCRC() != received.crc) wireOK = false;
+
+        memcpy(out, key, sizeof(out));
+        received.payload.delta.apply(out);
+        if(memcmp(out, raw, sizeof(out)) != 0 || received.payload.delta.primary != (n & 1)) roundTrip = false;
+    }
+    check(roundTrip, "delta applied to its keyframe reproduces all axes");
+    check(wireOK, "delta packets are shorter than full ones, and survive toWire() / fromWire() with a valid CRC");
+
+    uint32_t key[MControlPacket::NUM_AXES] = {0}, all[MControlPacket::NUM_AXES];
+    for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) all[i] = MCONTROL_AXIS_FIELDS[i].mask;
+    MControlDelta d;
+    check(!d.encode(0, key, all, true), "a delta with all axes changed doesn't fit, so it's a keyframe");
+
+    // End to end: one stick moving, everything else still. Same traffic with and without deltas.
+    bb::hal::setVirtualTime(true);
+    Protocol::setTransmitFrequencyHz(50);
+    float bytesPerPacket[2], finalSpeed[2];
+    for(int withDelta=0; withDelta<2; withDelta++) {
+        LoopbackSystem sys(2000, 0, withDelta ? 0.2 : 0);
+        check(sys.pair(), "pairing succeeds");
+        ((MTransmitter*)sys.tx)->setDeltaEncoding(withDelta, 10);
+        sys.tx->setAxisValue(1, 0.3, UNIT_UNITY_CENTERED);
+        sys.run(100000);
+
+        unsigned long bytesBefore = sys.medium.numBytesSent(), sentBefore = sys.medium.numSent();
+        bool tracks = true;
+        for(int i=0; i<200; i++) {
+            sys.tx->setAxisValue(0, sinf(i * 0.05f), UNIT_UNITY_CENTERED);
+            sys.run(20000);
+        }
+        sys.tx->setAxisValue(0, 0.5, UNIT_UNITY_CENTERED);
+        sys.run(300000); // at least one keyframe, even with loss
+        if(fabs(sys.speed - 0.5) > 0.01 || fabs(sys.turn - 0.3) > 0.01) tracks = false;
+        check(tracks, withDelta ? "droid ends up with the remote's values with deltas on a 20% lossy link" :
+                                  "droid ends up with the remote's values");
+        bytesPerPacket[withDelta] = float(sys.medium.numBytesSent() - bytesBefore) / (sys.medium.numSent() - sentBefore);
+        finalSpeed[withDelta] = sys.speed;
+    }
+    check(finalSpeed[0] == finalSpeed[1], "delta and full packets give identical values");
+    report("bytes per control packet, full", bytesPerPacket[0], "bytes");
+    report("bytes per control packet, delta (1 of 19 axes moving, keyframe every 10)", bytesPerPacket[1], "bytes");
+
+    Protocol::setTransmitFrequencyHz(50);
+    bb::hal::setVirtualTime(false);
+}
+
+BBR_BENCH(aggregateControl) {
+    // Framing: aggregate frames are told apart from full and delta packets by their length
+    MAggregatePacket agg;
+    agg.control.primary.setAxis(0, 0.25);
+    agg.control.secondary.setAxis(0, -0.25);
+    agg.crc = agg.calculateCRC();
+    MPacketView view((const uint8_t*)&agg, sizeof(agg));
+    check(view.valid() && view.isAggregate() && !view.isDelta() && 
+          view.aggregate().control.secondary.getRawAxis(0) == agg.control.secondary.getRawAxis(0), 
+          "aggregate frame validates in place");
+    check(!MPacketView((const uint8_t*)&agg, MPacketView::LENGTH).validLength(), 
+          "extended control packet of full length is rejected");
+
+    // One device with both sets of sticks. The droid mixes a primary axis, a secondary axis, and both together.
+    // Both sticks always move together, so after each dispatch speed and dome should agree.
+    bb::hal::setVirtualTime(true);
+    Protocol::setTransmitFrequencyHz(50);
+    float packetsPerSec[2], bytesPerSec[2];
+    unsigned int halfUpdated[2], frames[2];
+    bool crossWorks[2];
+    for(int aggregate=0; aggregate<2; aggregate++) {
+        LoopbackSystem sys(2000, 0, 0);
+        if(aggregate) sys.medium.setMaxWireLength(250);
+        float dome = 0, sum = 0;
+        InputID domeInput = sys.rx->addInput("Dome", dome);
+        InputID sumInput = sys.rx->addInput("Sum", sum);
+        sys.rx->setMix(domeInput, AxisMix(SECONDARY_ADD, INTERP_LIN_CENTERED));
+        sys.rx->setMix(sumInput, AxisMix(0, INTERP_LIN_CENTERED, SECONDARY_ADD, INTERP_LIN_CENTERED, MIX_ADD));
+        unsigned int& numFrames = frames[aggregate];
+        unsigned int& numHalf = halfUpdated[aggregate];
+        sys.rx->setDataFinishedCallback([&sys, &dome, &numFrames, &numHalf](const NodeAddr&, uint8_t) {
+            numFrames++;
+            if(fabs(sys.speed - dome) > 0.01) numHalf++;
+        });
+        check(sys.pair(), "pairing succeeds");
+        ((MTransmitter*)sys.tx)->setAggregate(true);
+        sys.run(100000);
+
+        unsigned long sentBefore = sys.medium.numSent(), bytesBefore = sys.medium.numBytesSent(), start = micros();
+        halfUpdated[aggregate] = frames[aggregate] = 0;
+        for(int i=0; i<200; i++) {
+            float v = sinf(i * 0.1f) * 0.8f;
+            sys.tx->setAxisValue(0, v, UNIT_UNITY_CENTERED);
+            sys.tx->setAxisValue(SECONDARY_ADD, v, UNIT_UNITY_CENTERED);
+            sys.run(20000);
+        }
+        float seconds = (micros() - start) / 1e6f;
+        packetsPerSec[aggregate] = (sys.medium.numSent() - sentBefore) / seconds;
+        bytesPerSec[aggregate] = (sys.medium.numBytesSent() - bytesBefore) / seconds;
+        crossWorks[aggregate] = fabs(sum - (sys.speed + dome)) < 0.01 && fabs(sys.speed) > 0.1;
+    }
+    check(frames[1] > 0 && halfUpdated[1] == 0, "aggregate frames never leave the droid half updated");
+    check(crossWorks[1], "aggregate frames feed mixes of a primary and a secondary axis");
+    check(!crossWorks[0], "separate packets can't feed those mixes");
+    report("packets/s, primary + secondary, separate packets", packetsPerSec[0], "packets/s (virtual)");
+    report("packets/s, primary + secondary, aggregate frames", packetsPerSec[1], "packets/s (virtual)");
+    report("bytes/s, separate packets", bytesPerSec[0], "bytes/s (virtual)");
+    report("bytes/s, aggregate frames", bytesPerSec[1], "bytes/s (virtual)");
+    report("half-updated dispatches, separate packets", 100.0f * halfUpdated[0] / frames[0], "%");
+    report("half-updated dispatches, aggregate frames", 100.0f * halfUpdated[1] / frames[1], "%");
+
+    bb::hal::setVirtualTime(false);
+}
+
+BBR_BENCH(fecControl) {
+    // Framing: FEC frames of every length validate in place and are told apart from everything else
+    bool wireOK = true, roundTrip = true;
+    uint32_t seed = 7;
+    for(int n=0; n<10000; n++) {
+        uint32_t cur[MControlPacket::NUM_AXES], prev[MControlPacket::NUM_AXES], out[MControlPacket::NUM_AXES];
+        for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+            seed = seed * 1103515245 + 12345;
+            cur[i] = prev[i] = (seed >> 8) & MCONTROL_AXIS_FIELDS[i].mask;
+        }
+        for(uint8_t k=0; k<n%12; k++) {
+            seed = seed * 1103515245 + 12345;
+            uint8_t i = (seed >> 16) % MControlPacket::NUM_AXES;
+            prev[i] = (seed >> 4) & MCONTROL_AXIS_FIELDS[i].mask;
+        }
+
+        MFECPacket packet;
+        packet.seqnum = n;
+        packet.current.control.encodeAll(cur);
+        packet.current.id = n & 0xff;
+        if(!packet.previous.encode((n-1) & 0xff, cur, prev, n & 1)) continue; // too many changes, sent as keyframe
+        packet.crc = packet.calculateCRC();
+
+        uint8_t wire[sizeof(MFECPacket)];
+        uint8_t len = packet.toWire(wire);
+        MPacketView view(wire, len);
+        MFECPacket received;
+        if(!view.valid() || !view.isFEC() || view.isAggregate() || view.isMPacket() || len == MPacketView::AGGREGATE_LENGTH ||
+           !received.fromWire(wire, len) || received.calculateCRC() != received.crc) wireOK = false;
+
+        received.current.control.decodeAll(out);
+        received.previous.apply(out);
+        if(memcmp(out, prev, sizeof(out)) != 0 || received.previous.primary != (n & 1)) roundTrip = false;
+    }
+    check(wireOK, "FEC frames validate in place and survive toWire() / fromWire() with a valid CRC");
+    check(roundTrip, "FEC delta applied to the current frame reproduces the previous one");
+
+    // End to end: a stick ramping up steadily on a 20% lossy link, with and without FEC. Every frame carries a
+    // new value, so frames dispatched per frame sent is the effective update rate.
+    bb::hal::setVirtualTime(true);
+    Protocol::setTransmitFrequencyHz(50);
+    float updateRate[2], bytesPerPacket[2];
+    for(int withFEC=0; withFEC<2; withFEC++) {
+        LoopbackSystem sys(2000, 0, 0);
+        sys.medium.setMaxWireLength(MPacketView::MAX_LENGTH);
+        unsigned int frames = 0;
+        float lastSpeed = -2;
+        bool monotonic = true;
+        sys.rx->setDataFinishedCallback([&](const NodeAddr&, uint8_t) {
+            frames++;
+            if(sys.speed < lastSpeed) monotonic = false;
+            lastSpeed = sys.speed;
+        });
+        check(sys.pair(), "pairing succeeds");
+        check(sys.remote.pairedNodes()[0].protoSpecific & MProtocol::CAPABILITY_FEC, "droid announces FEC when pairing");
+        ((MTransmitter*)sys.tx)->setFEC(withFEC);
+        sys.tx->setAxisValue(0, -1, UNIT_UNITY_CENTERED);
+        sys.run(100000);
+
+        sys.medium.setLossRate(0.2);
+        unsigned long sentBefore = sys.remote.nodeStats(sys.droid.address()).packetsSent;
+        unsigned long mediumBefore = sys.medium.numSent(), bytesBefore = sys.medium.numBytesSent();
+        frames = 0;
+        const unsigned long durationUS = 4000000, tickUS = 500;
+        for(unsigned long t=0; t<durationUS; t+=tickUS) {
+            sys.tx->setAxisValue(0, -0.9f + 1.8f*t/durationUS, UNIT_UNITY_CENTERED);
+            sys.run(tickUS, tickUS);
+        }
+        sys.medium.setLossRate(0);
+        sys.run(100000);
+
+        updateRate[withFEC] = float(frames) / (sys.remote.nodeStats(sys.droid.address()).packetsSent - sentBefore);
+        bytesPerPacket[withFEC] = float(sys.medium.numBytesSent() - bytesBefore) / (sys.medium.numSent() - mediumBefore);
+        check(monotonic, withFEC ? "recovered frames are dispatched in order" : "stick ramp never goes backwards");
+        NodeStats ns = sys.droid.nodeStats(sys.remote.address());
+        if(withFEC) check(ns.packetsRecovered > 0 && ns.packetsRecovered <= ns.packetsLost, "lost frames are recovered");
+        else check(ns.packetsRecovered == 0, "nothing is recovered without FEC");
+    }
+    check(updateRate[1] > updateRate[0] + 0.1f, "FEC raises the effective update rate on a lossy link");
+    report("frames dispatched per frame sent, 20% loss, no FEC", 100.0 * updateRate[0], "%");
+    report("frames dispatched per frame sent, 20% loss, FEC", 100.0 * updateRate[1], "%");
+    report("bytes per control packet, no FEC (1 axis moving)", bytesPerPacket[0], "bytes");
+    report("bytes per control packet, FEC (1 axis moving)", bytesPerPacket[1], "bytes");
+
+    // A droid whose link can't carry FEC frames doesn't announce it, and keeps getting full packets
+    LoopbackSystem small(2000, 0, 0);
+    check(small.pair(), "pairing succeeds");
+    check((small.remote.pairedNodes()[0].protoSpecific & MProtocol::CAPABILITY_FEC) == 0, 
+          "droid on a short-frame link doesn't announce FEC");
+    ((MTransmitter*)small.tx)->setFEC(true);
+    unsigned long sentBefore = small.medium.numSent(), bytesBefore = small.medium.numBytesSent();
+    small.run(200000);
+    check(small.medium.numBytesSent() - bytesBefore == (small.medium.numSent() - sentBefore) * MPacketView::LENGTH &&
+          small.callbacks > 0, "transmitter falls back to full packets");
+
+    bb::hal::setVirtualTime(false);
+}
+
+BBR_BENCH(integrityNegotiation) {
+    // The droid asks for a stronger check when the remote pairs with it; both ends tag everything but pairing.
+    bb::hal::setVirtualTime(true);
+    Protocol::setTransmitFrequencyHz(50);
+    const MIntegrity engines[3] = { INTEGRITY_CRC7, INTEGRITY_CRC16, INTEGRITY_CRC32C };
+    for(int e=0; e<3; e++) {
+        LoopbackSystem sys(2000, 0, 0);
+        sys.medium.setMaxWireLength(250);
+        sys.droid.setIntegrity(engines[e]);
+        check(sys.pair(), "pairing succeeds");
+        check(sys.remote.integrityFor(sys.droid.address()) == engines[e] && 
+              sys.droid.integrityFor(sys.remote.address()) == engines[e], "both ends agree on the integrity check");
+        sys.tx->setAxisValue(0, 0.5, UNIT_UNITY_CENTERED);
+        unsigned long sentBefore = sys.medium.numSent(), bytesBefore = sys.medium.numBytesSent();
+        sys.run(1000000);
+        check(fabs(sys.speed - 0.5) < 0.01 && sys.droid.stats().crcErrors == 0, "tagged control packets get through");
+        char label[80];
+        snprintf(label, sizeof(label), "bytes per control packet, integrity %d", int(engines[e]));
+        report(label, float(sys.medium.numBytesSent() - bytesBefore) / (sys.medium.numSent() - sentBefore), "bytes");
+    }
+
+    // A link that can't carry the tag falls back to CRC-7
+    LoopbackSystem small(2000, 0, 0);
+    small.droid.setIntegrity(INTEGRITY_CRC32C);
+    check(small.pair() && small.remote.integrityFor(small.droid.address()) == INTEGRITY_CRC7, 
+          "integrity check falls back to CRC-7 on a short-frame link");
+
+    bb::hal::setVirtualTime(false);
+}
+
+// Gives the droid 38 inputs, like a full-size droid, and checks that the remote's copy matches after retrieveInputs().
+static void addManyInputs(LoopbackSystem& sys) {
+    const Interpolator interps[4] = { INTERP_LIN_CENTERED, INTERP_LIN_POSITIVE, INTERP_LIN_CENTERED_INV, INTERP_LIN_POSITIVE_INV };
+    for(unsigned int i=2; i<38; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), i%3 ? "Input%u" : "Aux%u", i);
+        InputID input = sys.rx->addInput(name);
+        sys.rx->setMix(input, AxisMix(i % 19, interps[i % 4], (i*7) % 19, interps[(i+1) % 4], MixType(i % 3)));
+    }
+}
+
+static bool inputsMatch(LoopbackSystem& sys) {
+    NodeAddr droidAddr = sys.droid.address();
+    if(sys.remote.numInputs(droidAddr) != sys.rx->numInputs()) return false;
+    for(InputID i=0; i<sys.rx->numInputs(); i++) {
+        if(sys.remote.inputName(droidAddr, i) != sys.rx->inputName(i)) return false;
+        MConfigPacket::MixPacket want, got;
+        axisMixToMixPacket(i, sys.rx->mixForInput(i), want);
+        axisMixToMixPacket(i, sys.remote.mixManager(droidAddr).mixForInput(i), got);
+        if(memcmp(&want, &got, sizeof(want)) != 0) return false;
+    }
+    return true;
+}
+
+BBR_BENCH(manifestTransfer) {
+    bb::hal::setVirtualTime(true);
+    Protocol::setTransmitFrequencyHz(50);
+
+    // Round trips one input at a time on a link that only carries MPackets, one request over one that takes more
+    const uint8_t wireLengths[3] = { MPacketView::LENGTH, 38, MAX_TAGGED_LENGTH };
+    for(int w=0; w<3; w++) {
+        LoopbackSystem sys(2000, 1000, 0);
+        addManyInputs(sys);
+        sys.medium.setMaxWireLength(wireLengths[w]);
+        check(sys.pair(), "pairing succeeds");
+        unsigned long sentBefore = sys.medium.numSent(), start = micros();
+        check(sys.remote.retrieveInputs(sys.remote.pairedNodes()[0]), "retrieveInputs() succeeds");
+        float ms = (micros()-start)/1000.0f;
+        check(inputsMatch(sys), "retrieved names and mixes match the droid's");
+        if(wireLengths[w] > MPacketView::LENGTH) check(ms < 100, "38 inputs sync in under 100 ms");
+        char label[80];
+        snprintf(label, sizeof(label), "retrieveInputs(), 38 inputs, %d byte frames", wireLengths[w]);
+        report(label, ms, "ms (virtual)");
+        snprintf(label, sizeof(label), "  packets sent, %d byte frames", wireLengths[w]);
+        report(label, sys.medium.numSent() - sentBefore, "packets");
+    }
+
+    // Lost frames are asked for again
+    LoopbackSystem lossy(2000, 1000, 0);
+    addManyInputs(lossy);
+    lossy.medium.setMaxWireLength(MAX_TAGGED_LENGTH);
+    check(lossy.pair(), "pairing succeeds");
+    lossy.medium.setLossRate(0.2);
+    unsigned int succeeded = 0, numTries = 20;
+    unsigned long start = micros();
+    for(unsigned int i=0; i<numTries; i++) {
+        if(lossy.remote.retrieveInputs(lossy.remote.pairedNodes()[0]) && inputsMatch(lossy)) succeeded++;
+    }
+    check(succeeded == numTries, "retrieveInputs() survives 20% loss");
+    report("retrieveInputs(), 38 inputs, 20% loss, mean", (micros()-start)/1000.0f/numTries, "ms (virtual)");
+
+    bb::hal::setVirtualTime(false);
+}
+
+BBR_BENCH(transmitOnChange) {
+    // Scripted stick input: a step to a new position after an idle time of 1ms to 0.5s, repeated; then a long
+    // still phase. Same script at a fixed 50Hz and with send-on-change (1% threshold, 100ms keepalive).
+    bb::hal::setVirtualTime(true);
+    Protocol::setTransmitFrequencyHz(50);
+    const unsigned int numSteps = 100;
+    const float watchdogSeconds = 0.25;
+    float packetsPerSec[2], idlePacketsPerSec[2], meanLatencyMS[2], maxLatencyMS[2];
+    for(int onChange=0; onChange<2; onChange++) {
+        LoopbackSystem sys(2000, 0, 0);
+        check(sys.pair(), "pairing succeeds");
+        if(onChange) sys.tx->setTransmitOnChange(0.01, 0.1, 0.002);
+        unsigned int timeouts = 0;
+        sys.droid.setCommTimeoutWatchdog(watchdogSeconds, [&timeouts](Protocol*, float) { timeouts++; });
+        sys.run(200000);
+        timeouts = 0; // pairing blocks control packets, so the first step() after it may time out
+
+        unsigned long sentBefore = sys.medium.numSent(), start = micros();
+        unsigned long sumUS = 0, maxUS = 0;
+        bool allArrived = true;
+        for(unsigned int i=0; i<numSteps; i++) {
+            sys.run(1000 + (i*7919) % 500000);
+            float target = ((i*37) % 21) / 10.0f - 1.0f;
+            if(fabs(target - sys.speed) < 0.05) target = -target + 0.1f;
+            sys.tx->setAxisValue(0, target, UNIT_UNITY_CENTERED);
+            unsigned long t0 = micros();
+            while(fabs(sys.speed - target) > 0.01 && micros()-t0 < 1000000) sys.run(50, 50);
+            unsigned long latency = micros()-t0;
+            if(fabs(sys.speed - target) > 0.01) allArrived = false;
+            sumUS += latency;
+            if(latency > maxUS) maxUS = latency;
+        }
+        packetsPerSec[onChange] = (sys.medium.numSent() - sentBefore) * 1e6f / (micros() - start);
+        meanLatencyMS[onChange] = sumUS / 1000.0f / numSteps;
+        maxLatencyMS[onChange] = maxUS / 1000.0f;
+        check(allArrived, onChange ? "every stick movement reaches the droid with send-on-change" :
+                                     "every stick movement reaches the droid");
+
+        sentBefore = sys.medium.numSent();
+        start = micros();
+        sys.run(5000000);
+        idlePacketsPerSec[onChange] = (sys.medium.numSent() - sentBefore) * 1e6f / (micros() - start);
+        check(timeouts == 0, onChange ? "keepalive keeps the droid's comm watchdog quiet" : 
+                                        "periodic transmit keeps the droid's comm watchdog quiet");
+    }
+    check(meanLatencyMS[1] < meanLatencyMS[0], "send-on-change has lower stick-to-callback latency");
+    check(idlePacketsPerSec[1] < idlePacketsPerSec[0], "send-on-change sends less while the sticks are still");
+    report("packets/s, scripted steps, periodic @50Hz", packetsPerSec[0], "packets/s (virtual)");
+    report("packets/s, scripted steps, on change", packetsPerSec[1], "packets/s (virtual)");
+    report("packets/s, sticks still, periodic @50Hz", idlePacketsPerSec[0], "packets/s (virtual)");
+    report("packets/s, sticks still, on change (100ms keepalive)", idlePacketsPerSec[1], "packets/s (virtual)");
+    report("stick-to-callback latency, mean, periodic @50Hz", meanLatencyMS[0], "ms (virtual)");
+    report("stick-to-callback latency, max, periodic @50Hz", maxLatencyMS[0], "ms (virtual)");
+    report("stick-to-callback latency, mean, on change", meanLatencyMS[1], "ms (virtual)");
+    report("stick-to-callback latency, max, on change", maxLatencyMS[1], "ms (virtual)");
+
+    bb::hal::setVirtualTime(false);
+}
+
+BBR_BENCH(latencyHistogram) {
+    Histogram h;
+    for(uint32_t i=1; i<=1000; i++) h.add(i);
+    check(h.count() == 1000 && h.min() == 1 && h.max() == 1000 && h.mean() == 500, "histogram count/min/max/mean");
+    check(h.percentile(50) == 511, "p50 of 1..1000 reported as upper edge of its bucket");
+    check(h.percentile(99) == 1000, "p99 of 1..1000 clamped to max");
+    check(h.percentile(0) == 1, "p0 of 1..1000 is the lowest bucket");
+
+    uint32_t v = 1;
+    measure("Histogram::add()", 10000000, [&]() { 
+        h.add(v); 
+        v = v*1103515245 + 12345; 
+    });
+    doNotOptimize(h);
+}
+
+#if defined(BBR_STEP_PROFILER)
+BBR_BENCH(stepProfiler) {
+    // Phases must add up to the whole step, and nested step() calls must not be counted twice.
+    bb::hal::setVirtualTime(true);
+    StepProfiler prof;
+    for(int i=0; i<20; i++) {
+        prof.beginStep();
+        delayMicroseconds(100);
+        prof.beginPhase(StepProfiler::PHASE_RECEIVE);
+        delayMicroseconds(200);
+        prof.beginPhase(StepProfiler::PHASE_DISPATCH);
+        prof.beginStep(); // eg. waitForPacket() stepping from within a callback
+        delayMicroseconds(300);
+        prof.endStep();
+        prof.endPhase();
+        prof.endPhase();
+        prof.endStep();
+    }
+    bb::hal::setVirtualTime(false);
+    check(prof.stepHistogram().count() == 20 && prof.stepHistogram().max() == 600, "nested step() is counted once");
+    check(prof.phaseHistogram(StepProfiler::PHASE_HOUSEKEEPING).max() == 100, "unclaimed time is housekeeping");
+    check(prof.phaseHistogram(StepProfiler::PHASE_RECEIVE).max() == 200, "receive is paused while dispatching");
+    check(prof.phaseHistogram(StepProfiler::PHASE_DISPATCH).max() == 300, "dispatch includes the nested step");
+
+    prof.reset();
+    measure("StepProfiler step + 2 phases (overhead)", 1000000, [&]() {
+        prof.beginStep();
+        prof.beginPhase(StepProfiler::PHASE_RECEIVE);
+        prof.endPhase();
+        prof.beginPhase(StepProfiler::PHASE_DISPATCH);
+        prof.endPhase();
+        prof.endStep();
+    });
+}
+#endif
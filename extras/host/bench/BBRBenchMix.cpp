@@ -0,0 +1,191 @@
+#include "BBRBench.h"
+#include "BBRTypes.h"
+#include "BBRCompiledMix.h"
+#include "BBRMixManager.h"
+#include <map>
+#include <math.h>
+#include <vector>
+
+using namespace bb;
+using namespace bb::rmt;
+using namespace bb::bench;
+
+BBR_BENCH(axisMixCompute) {
+    AxisMix single(0, INTERP_LIN_CENTERED);
+    AxisMix added(0, INTERP_LIN_CENTERED, 1, INTERP_LIN_CENTERED, MIX_ADD);
+    AxisMix multiplied(0, INTERP_LIN_POSITIVE, 1, INTERP_LIN_CENTERED_INV, MIX_MULT);
+
+    check(single.compute(0.5f, 0, 1, 0, 0, 1) == 0.0f, "centered mix maps 0.5 to 0");
+    check(single.compute(1.0f, 0, 1, 0, 0, 1) == 1.0f, "centered mix maps 1 to 1");
+    check(added.compute(1.0f, 0, 1, 0.0f, 0, 1) == 0.0f, "additive mix of 1 and -1 is 0");
+
+    float v = 0;
+    measure("AxisMix::compute(), single axis", 10000000, [&]() {
+        v += 0.0001f; if(v > 1) v = 0;
+        doNotOptimize(single.compute(v, 0, 1, 0, 0, 1));
+    });
+    measure("AxisMix::compute(), MIX_ADD", 10000000, [&]() {
+        v += 0.0001f; if(v > 1) v = 0;
+        doNotOptimize(added.compute(v, 0, 1, 1-v, 0, 1));
+    });
+    measure("AxisMix::compute(), MIX_MULT", 10000000, [&]() {
+        v += 0.0001f; if(v > 1) v = 0;
+        doNotOptimize(multiplied.compute(v, 0, 1, 1-v, 0, 1));
+    });
+}
+
+// Port of src/testinterp.py. Note that it maps frac == 1 to 0 (its last segment is half-open); the
+// library maps it to the 100% value, so callers skip that point.
+static float testinterpReference(float frac, const Interpolator& ip) {
+    const float curve[5] = {ip.i0/100.0f, ip.i25/100.0f, ip.i50/100.0f, ip.i75/100.0f, ip.i100/100.0f};
+    float i0 = 0, i1 = 0;
+    if(frac >= 0 && frac < 0.25)      { i0 = curve[0]; i1 = curve[1]; frac = frac*4; }
+    else if(frac >= 0.25 && frac < 0.5) { i0 = curve[1]; i1 = curve[2]; frac = (frac-0.25)*4; }
+    else if(frac >= 0.5 && frac < 0.75) { i0 = curve[2]; i1 = curve[3]; frac = (frac-0.5)*4; }
+    else if(frac >= 0.75 && frac < 1)   { i0 = curve[3]; i1 = curve[4]; frac = (frac-0.75)*4; }
+    return i0 + (i1-i0)*frac;
+}
+
+BBR_BENCH(compiledMix) {
+    // Accuracy: every raw value of every Monaco bit depth, presets plus pseudo-random curves, all mix types.
+    std::vector<Interpolator> curves = { INTERP_LIN_POSITIVE, INTERP_LIN_POSITIVE_INV, INTERP_LIN_CENTERED, 
+                                         INTERP_LIN_CENTERED_INV, INTERP_ZERO, {-100, 100, -100, 100, -100} };
+    uint32_t seed = 0xdeadbeef;
+    for(int i=0; i<50; i++) {
+        Interpolator ip;
+        int8_t* p = (int8_t*)&ip;
+        for(int j=0; j<5; j++) {
+            seed = seed*1103515245 + 12345;
+            p[j] = int8_t(int((seed >> 16) % 255) - 127);
+        }
+        curves.push_back(ip);
+    }
+
+    const uint8_t bitDepths[] = {10, 8, 5, 1};
+    float maxErrFloat = 0, maxErrRef = 0;
+    for(uint8_t bd: bitDepths) {
+        uint32_t maxval = (1<<bd)-1;
+        for(const Interpolator& ip: curves) {
+            AxisMix mix(0, ip);
+            CompiledMix cm;
+            cm.compile(mix, bd, 0);
+            for(uint32_t raw=0; raw<=maxval; raw++) {
+                float frac = float(raw)/float(maxval);
+                float c = cm.compute(raw, 0);
+                float err = fabs(c - mix.compute(frac, 0, 1, 0, 0, 1));
+                if(err > maxErrFloat) maxErrFloat = err;
+                if(raw < maxval) {
+                    err = fabs(c - testinterpReference(frac, ip));
+                    if(err > maxErrRef) maxErrRef = err;
+                }
+            }
+        }
+    }
+    check(maxErrFloat < 1e-3, "compiled interpolator within 1e-3 of AxisMix::compute()");
+    check(maxErrRef < 1e-3, "compiled interpolator within 1e-3 of testinterp.py");
+    report("max abs error vs. AxisMix::compute(), single axis", maxErrFloat*1e6, "x 1e-6");
+    report("max abs error vs. testinterp.py", maxErrRef*1e6, "x 1e-6");
+
+    float maxErrMix = 0;
+    for(MixType mt: {MIX_NONE, MIX_ADD, MIX_MULT}) {
+        for(unsigned int c=0; c+1<curves.size(); c+=3) {
+            AxisMix mix(0, curves[c], 5, curves[c+1], mt);
+            CompiledMix cm;
+            check(cm.compile(mix, 10, 8), "10/8 bit mix compiles");
+            for(uint32_t r1=0; r1<1024; r1+=7) {
+                for(uint32_t r2=0; r2<256; r2+=5) {
+                    float err = fabs(cm.compute(r1, r2) - mix.compute(r1/1023.0f, 0, 1, r2/255.0f, 0, 1));
+                    if(err > maxErrMix) maxErrMix = err;
+                }
+            }
+        }
+    }
+    check(maxErrMix < 3e-3, "compiled two-axis mixes within 3e-3 of AxisMix::compute()");
+    report("max abs error vs. AxisMix::compute(), two axes", maxErrMix*1e6, "x 1e-6");
+
+    CompiledMix invalid;
+    check(invalid.compile(AxisMix(0, INTERP_LIN_CENTERED), 0, 0) == false, "unknown bit depth doesn't compile");
+
+    // Speed, same mixes as axisMixCompute, raw 10 bit input.
+    AxisMix single(0, INTERP_LIN_CENTERED);
+    AxisMix added(0, INTERP_LIN_CENTERED, 1, INTERP_LIN_CENTERED, MIX_ADD);
+    AxisMix multiplied(0, INTERP_LIN_POSITIVE, 1, INTERP_LIN_CENTERED_INV, MIX_MULT);
+    CompiledMix cSingle, cAdded, cMultiplied;
+    cSingle.compile(single, 10, 10);
+    cAdded.compile(added, 10, 10);
+    cMultiplied.compile(multiplied, 10, 10);
+
+    uint32_t raw = 0;
+    measure("CompiledMix::compute(), single axis", 10000000, [&]() {
+        raw = (raw+1) & 1023;
+        doNotOptimize(cSingle.compute(raw, 0));
+    });
+    measure("CompiledMix::compute(), MIX_ADD", 10000000, [&]() {
+        raw = (raw+1) & 1023;
+        doNotOptimize(cAdded.compute(raw, 1023-raw));
+    });
+    measure("CompiledMix::compute(), MIX_MULT", 10000000, [&]() {
+        raw = (raw+1) & 1023;
+        doNotOptimize(cMultiplied.compute(raw, 1023-raw));
+    });
+    measure("CompiledMix::computeQ16(), single axis (no float)", 10000000, [&]() {
+        raw = (raw+1) & 1023;
+        doNotOptimize(cSingle.computeQ16(raw, 0));
+    });
+}
+
+BBR_BENCH(mixManagerLookup) {
+    // Random setMix() / clearMixes() sequence, compared against a std::map.
+    MixManager mgr;
+    std::map<InputID,AxisMix> reference;
+    uint32_t seed = 4711;
+    bool same = true, versionChanged = true;
+    for(int n=0; n<5000; n++) {
+        seed = seed*1103515245 + 12345;
+        uint32_t version = mgr.version();
+        if((seed >> 16) % 500 == 0) {
+            mgr.clearMixes();
+            reference.clear();
+        } else {
+            InputID input = (seed >> 8) % 255;
+            AxisMix mix((seed >> 20) % 19, INTERP_LIN_CENTERED);
+            mgr.setMix(input, mix);
+            reference[input] = mix;
+        }
+        if(mgr.version() == version) versionChanged = false;
+
+        if(mgr.numMixes() != reference.size()) same = false;
+        uint8_t index = 0;
+        for(auto& r: reference) {
+            if(mgr.inputForMixIndex(index) != r.first || mgr.mixAtIndex(index).axis1 != r.second.axis1) same = false;
+            index++;
+        }
+        for(unsigned i=0; i<255; i++) {
+            auto it = reference.find(i);
+            if(mgr.hasMixForInput(i) != (it != reference.end())) same = false;
+            if(it != reference.end() && mgr.mixForInput(i).axis1 != it->second.axis1) same = false;
+        }
+    }
+    check(same, "dense storage matches std::map");
+    check(versionChanged, "every change bumps the version");
+    check(mgr.setMix(INPUT_INVALID, AxisMix()) == false, "INPUT_INVALID is rejected");
+    check(mgr.hasMixForInput(INPUT_INVALID) == false, "INPUT_INVALID has no mix");
+    check(MixManager().version() != MixManager().version(), "fresh managers have distinct versions");
+
+    // A typical droid has 20-40 inputs.
+    mgr.clearMixes();
+    for(InputID i=0; i<32; i++) if(i % 4 != 3) mgr.setMix(i, AxisMix(i % 19, INTERP_LIN_CENTERED));
+    InputID i = 0;
+    measure("MixManager::hasMixForInput(), 24 of 32 inputs", 10000000, [&]() {
+        i = (i+1) & 31;
+        doNotOptimize(mgr.hasMixForInput(i));
+    });
+    measure("MixManager::mixForInput(), 24 of 32 inputs", 10000000, [&]() {
+        i = (i+1) & 31;
+        doNotOptimize(mgr.mixForInput(i).axis1);
+    });
+    measure("MixManager::compiledMixForInput(), 24 of 32 inputs", 10000000, [&]() {
+        i = (i+1) & 31;
+        doNotOptimize(mgr.compiledMixForInput(i));
+    });
+}
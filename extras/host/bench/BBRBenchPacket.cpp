@@ -0,0 +1,403 @@
+#include "BBRBench.h"
+#include "MCS/BBRMPacket.h"
+#include "MCS/BBRMPacketView.h"
+#include "MCS/BBRMIntegrity.h"
+
+using namespace bb;
+using namespace bb::rmt;
+using namespace bb::bench;
+
+static MPacket makeControlPacket(uint32_t seed) {
+    MPacket packet(MPacket::PACKET_TYPE_CONTROL, MPacket::PACKET_SOURCE_LEFT_REMOTE, seed);
+    memset(&packet.payload, 0, sizeof(packet.payload));
+    MControlPacket& c = packet.payload.control;
+    for(uint8_t i=0; i<19; i++) {
+        c.setAxis(i, float((seed*(i+7)) % 1024), UNIT_RAW);
+    }
+    c.primary = true;
+    packet.crc = packet.calculateCRC();
+    return packet;
+}
+
+BBR_BENCH(packetCRC) {
+    MPacket packet = makeControlPacket(42);
+    check(packet.calculateCRC() == packet.crc, "CRC of freshly built packet matches");
+    packet.payload.control.axis0 ^= 1;
+    check(packet.calculateCRC() != packet.crc, "CRC detects single bit flip");
+
+    measure("MPacket::calculateCRC()", 10000000, [&]() {
+        clobberMemory();
+        doNotOptimize(packet.calculateCRC());
+    });
+}
+
+// Bitwise reference implementations
+static uint16_t referenceCRC16(const uint8_t* buf, size_t len) {
+    uint16_t crc = 0xffff;
+    for(size_t i=0; i<len; i++) {
+        crc ^= uint16_t(buf[i]) << 8;
+        for(int b=0; b<8; b++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+static uint32_t referenceCRC32C(const uint8_t* buf, size_t len) {
+    uint32_t crc = 0xffffffff;
+    for(size_t i=0; i<len; i++) {
+        crc ^= buf[i];
+        for(int b=0; b<8; b++) crc = (crc & 1) ? (crc >> 1) ^ 0x82f63b78 : crc >> 1;
+    }
+    return ~crc;
+}
+
+BBR_BENCH(integrityCheck) {
+    const uint8_t* check9 = (const uint8_t*)"123456789";
+    check(calculateCRC16(check9, 9) == 0x29b1, "CRC-16/CCITT-FALSE check value");
+    check(calculateCRC32C(check9, 9) == 0xe3069283, "CRC-32C check value");
+    uint8_t buf[256];
+    uint32_t seed = 1;
+    for(size_t i=0; i<sizeof(buf); i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = seed >> 16;
+    }
+    bool sameAsReference = true;
+    for(size_t off=0; off<8; off++) {
+        for(size_t len=0; len+off<=sizeof(buf); len++) {
+            if(calculateCRC16(buf+off, len) != referenceCRC16(buf+off, len) ||
+               calculateCRC32C(buf+off, len) != referenceCRC32C(buf+off, len)) sameAsReference = false;
+        }
+    }
+    check(sameAsReference, "CRC-16 and CRC-32C match the bitwise reference at all lengths and alignments");
+
+    // Fuzz: valid tagged control packets hit by random errors -- some bits anywhere, or a burst. An error goes
+    // undetected if the frame still has a valid tag (if any), length and CRC-7.
+    const MIntegrity engines[3] = { INTEGRITY_CRC7, INTEGRITY_CRC16, INTEGRITY_CRC32C };
+    const char* names[3] = { "CRC-7", "CRC-7 + CRC-16", "CRC-7 + CRC-32C" };
+    const int trials = 1000000;
+    unsigned int undetectedRandom[3] = {0}, undetectedBurst[3] = {0};
+    for(int e=0; e<3; e++) {
+        uint32_t rnd = 12345;
+        auto next = [&rnd]() { rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5; return rnd; };
+        for(int t=0; t<trials; t++) {
+            MPacket packet = makeControlPacket(next());
+            uint8_t wire[MAX_TAGGED_LENGTH];
+            uint8_t len = packet.toWire(wire);
+            len = appendIntegrityTag(engines[e], wire, len);
+            uint16_t bits = 8 * len;
+            bool burst = t & 1;
+            if(burst) {
+                // Up to 16 bits, first and last flipped
+                uint16_t blen = 1 + next() % 16, start = next() % (bits - blen + 1);
+                for(uint16_t b=0; b<blen; b++) {
+                    if(b == 0 || b == blen-1 || (next() & 1)) wire[(start+b)/8] ^= 1 << ((start+b)%8);
+                }
+            } else {
+                uint8_t nflips = 2 + next() % 7;
+                for(uint8_t f=0; f<nflips; f++) {
+                    uint16_t b = next() % bits;
+                    wire[b/8] ^= 1 << (b%8);
+                }
+            }
+            uint8_t l = len;
+            if(checkIntegrityTag(engines[e], wire, l) && MPacketView(wire, l).valid() && 
+               memcmp(wire, &packet, l-1) != 0) {
+                if(burst) undetectedBurst[e]++;
+                else undetectedRandom[e]++;
+            }
+        }
+    }
+    check(undetectedBurst[1] == 0 && undetectedBurst[2] == 0, "tagged frames: every burst of up to 16 bits is detected");
+    check(undetectedRandom[1] < undetectedRandom[0] / 100 && undetectedRandom[2] <= undetectedRandom[1],
+          "tagged frames: random errors slip through far less often than with CRC-7");
+    char label[80];
+    for(int e=0; e<3; e++) {
+        snprintf(label, sizeof(label), "undetected, 2..8 random bit errors, %s", names[e]);
+        report(label, 1e6 * undetectedRandom[e] / (trials/2), "per million");
+        snprintf(label, sizeof(label), "undetected, bursts up to 16 bits, %s", names[e]);
+        report(label, 1e6 * undetectedBurst[e] / (trials/2), "per million");
+    }
+
+    // Throughput on a full packet's 17 bytes and on a long buffer
+    size_t lens[2] = { 17, 256 };
+    for(int i=0; i<2; i++) {
+        size_t len = lens[i];
+        snprintf(label, sizeof(label), "calculateCRC7(), %d bytes", int(len));
+        double ns7 = measure(label, 10000000 / (1 + len/32), [&]() { clobberMemory(); doNotOptimize(calculateCRC7(buf, len)); });
+        snprintf(label, sizeof(label), "calculateCRC16(), %d bytes", int(len));
+        double ns16 = measure(label, 10000000 / (1 + len/32), [&]() { clobberMemory(); doNotOptimize(calculateCRC16(buf, len)); });
+        snprintf(label, sizeof(label), "calculateCRC32C(), %d bytes", int(len));
+        double ns32 = measure(label, 10000000 / (1 + len/32), [&]() { clobberMemory(); doNotOptimize(calculateCRC32C(buf, len)); });
+        snprintf(label, sizeof(label), "CRC-7 / CRC-16 / CRC-32C, %d bytes", int(len));
+        ::printf("  %-56s %5.2f / %5.2f / %5.2f bytes/ns\n", label, len / ns7, len / ns16, len / ns32);
+    }
+}
+
+BBR_BENCH(controlPacketAxes) {
+    MControlPacket c;
+    memset(&c, 0, sizeof(c));
+    for(uint8_t i=0; i<19; i++) {
+        uint32_t maxval = i<5 ? 1023 : i<10 ? 255 : i==10 ? 31 : 1;
+        c.setAxis(i, float(maxval), UNIT_RAW);
+        check(uint32_t(c.getAxis(i, UNIT_RAW)) == maxval, "setAxis / getAxis raw round trip");
+        c.setAxis(i, 0, UNIT_RAW);
+    }
+
+    uint32_t n = 0;
+    measure("MControlPacket::setAxis() x19, UNIT_RAW", 1000000, [&]() {
+        for(uint8_t i=0; i<19; i++) c.setAxis(i, float((n+i) & 0xff), UNIT_RAW);
+        n++;
+        doNotOptimize(c);
+    });
+    measure("MControlPacket::setAxis() x19, UNIT_UNITY_CENTERED", 1000000, [&]() {
+        for(uint8_t i=0; i<19; i++) c.setAxis(i, float((n+i) & 0xff)/128.0f - 1.0f);
+        n++;
+        doNotOptimize(c);
+    });
+    measure("MControlPacket::getAxis() x19, UNIT_RAW", 1000000, [&]() {
+        clobberMemory();
+        float sum = 0;
+        for(uint8_t i=0; i<19; i++) sum += c.getAxis(i, UNIT_RAW);
+        doNotOptimize(sum);
+    });
+    measure("MControlPacket::getAxis() x19, UNIT_UNITY", 1000000, [&]() {
+        clobberMemory();
+        float sum = 0;
+        for(uint8_t i=0; i<19; i++) sum += c.getAxis(i, UNIT_UNITY);
+        doNotOptimize(sum);
+    });
+}
+
+// The bitfield accessors MControlPacket used before the table-driven codec, as reference for the layout.
+static void refSetAxis(MControlPacket& c, uint8_t num, uint32_t v) {
+    switch(num) {
+    case 0: c.axis0 = v; break;   case 1: c.axis1 = v; break;   case 2: c.axis2 = v; break;
+    case 3: c.axis3 = v; break;   case 4: c.axis4 = v; break;   case 5: c.axis5 = v; break;
+    case 6: c.axis6 = v; break;   case 7: c.axis7 = v; break;   case 8: c.axis8 = v; break;
+    case 9: c.axis9 = v; break;   case 10: c.axis10 = v; break; case 11: c.axis11 = v; break;
+    case 12: c.axis12 = v; break; case 13: c.axis13 = v; break; case 14: c.axis14 = v; break;
+    case 15: c.axis15 = v; break; case 16: c.axis16 = v; break; case 17: c.axis17 = v; break;
+    default: c.axis18 = v; break;
+    }
+}
+
+static uint32_t refGetAxis(const MControlPacket& c, uint8_t num) {
+    switch(num) {
+    case 0: return c.axis0;   case 1: return c.axis1;   case 2: return c.axis2;   case 3: return c.axis3;
+    case 4: return c.axis4;   case 5: return c.axis5;   case 6: return c.axis6;   case 7: return c.axis7;
+    case 8: return c.axis8;   case 9: return c.axis9;   case 10: return c.axis10; case 11: return c.axis11;
+    case 12: return c.axis12; case 13: return c.axis13; case 14: return c.axis14; case 15: return c.axis15;
+    case 16: return c.axis16; case 17: return c.axis17; default: return c.axis18;
+    }
+}
+
+BBR_BENCH(controlPacketCodec) {
+    // Every value of every axis, with the other axes and primary set to random values
+    bool encodeOK = true, decodeOK = true, singleOK = true;
+    uint32_t seed = 1;
+    for(uint8_t axis=0; axis<MControlPacket::NUM_AXES; axis++) {
+        uint32_t maxval = (1 << MControlPacket::bitDepthForAxis(axis)) - 1;
+        for(uint32_t v=0; v<=maxval; v++) {
+            uint32_t raw[MControlPacket::NUM_AXES];
+            MControlPacket ref;
+            memset(&ref, 0, sizeof(ref));
+            for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+                seed = seed * 1103515245 + 12345;
+                raw[i] = i == axis ? v : (seed >> 8) & ((1 << MControlPacket::bitDepthForAxis(i)) - 1);
+                refSetAxis(ref, i, raw[i]);
+            }
+            ref.primary = (seed >> 20) & 1;
+
+            MControlPacket enc;
+            memset(&enc, 0, sizeof(enc));
+            enc.primary = ref.primary;
+            enc.encodeAll(raw);
+            if(memcmp(&enc, &ref, sizeof(ref)) != 0) encodeOK = false;
+
+            uint32_t dec[MControlPacket::NUM_AXES];
+            ref.decodeAll(dec);
+            for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+                if(dec[i] != refGetAxis(ref, i)) decodeOK = false;
+                if(ref.getRawAxis(i) != refGetAxis(ref, i)) singleOK = false;
+            }
+
+            MControlPacket single = ref;
+            single.setRawAxis(axis, maxval - v);
+            refSetAxis(ref, axis, maxval - v);
+            if(memcmp(&single, &ref, sizeof(ref)) != 0) singleOK = false;
+        }
+    }
+    check(encodeOK, "encodeAll() matches the bitfield layout for all values");
+    check(decodeOK, "decodeAll() matches the bitfield layout for all values");
+    check(singleOK, "getRawAxis() / setRawAxis() match the bitfield layout for all values");
+
+    uint32_t raw[MControlPacket::NUM_AXES];
+    MControlPacket c;
+    memset(&c, 0, sizeof(c));
+    uint32_t n = 0;
+    measure("bitfield setters x19", 1000000, [&]() {
+        for(uint8_t i=0; i<19; i++) refSetAxis(c, i, (n+i) & 0x1);
+        n++;
+        doNotOptimize(c);
+    });
+    measure("MControlPacket::encodeAll()", 1000000, [&]() {
+        for(uint8_t i=0; i<19; i++) raw[i] = (n+i) & 0x1;
+        n++;
+        c.encodeAll(raw);
+        doNotOptimize(c);
+    });
+    measure("bitfield getters x19", 1000000, [&]() {
+        clobberMemory();
+        for(uint8_t i=0; i<19; i++) raw[i] = refGetAxis(c, i);
+        doNotOptimize(raw);
+    });
+    measure("MControlPacket::decodeAll()", 1000000, [&]() {
+        clobberMemory();
+        c.decodeAll(raw);
+        doNotOptimize(raw);
+    });
+}
+
+BBR_BENCH(packetView) {
+    // Encoding: the writer must produce the same bytes as the MPacket bitfields
+    bool encodeOK = true, decodeOK = true;
+    uint32_t seed = 7;
+    for(int n=0; n<100000; n++) {
+        uint32_t raw[MControlPacket::NUM_AXES];
+        for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+            seed = seed * 1103515245 + 12345;
+            raw[i] = (seed >> 8) & ((1 << MControlPacket::bitDepthForAxis(i)) - 1);
+        }
+        MPacket::PacketSource source = MPacket::PacketSource((seed >> 4) & 3);
+        uint8_t seqnum = (seed >> 6) & 7;
+        bool primary = (seed >> 9) & 1;
+
+        MPacket ref(MPacket::PACKET_TYPE_CONTROL, source, seqnum);
+        memset(&ref.payload, 0, sizeof(ref.payload));
+        for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) refSetAxis(ref.payload.control, i, raw[i]);
+        ref.payload.control.primary = primary;
+        ref.crc = ref.calculateCRC();
+
+        uint8_t buf[MPacketView::LENGTH];
+        MPacketWriter w(buf);
+        w.clear();
+        w.setHeader(MPacket::PACKET_TYPE_CONTROL, source, seqnum);
+        w.setControl(raw, primary);
+        w.finish();
+        if(memcmp(buf, &ref, sizeof(ref)) != 0) encodeOK = false;
+    }
+    check(encodeOK, "MPacketWriter output is byte-identical to MPacket");
+
+    // Decoding: random bytes, read through the view and through the bitfields
+    for(int n=0; n<100000; n++) {
+        uint8_t buf[MPacketView::LENGTH];
+        for(uint8_t i=0; i<sizeof(buf); i++) {
+            seed = seed * 1103515245 + 12345;
+            buf[i] = seed >> 16;
+        }
+        buf[0] &= 0x7f; // full packets only -- deltas are covered by the deltaControl bench
+        MPacket ref;
+        memcpy(&ref, buf, sizeof(ref));
+        MPacketView v(buf, sizeof(buf));
+        if(v.type() != ref.type || v.source() != ref.source || v.seqnum() != ref.seqnum || v.crc() != ref.crc ||
+           v.calculateCRC() != ref.calculateCRC() || v.primary() != ref.payload.control.primary) decodeOK = false;
+        for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+            if(v.rawAxis(i) != refGetAxis(ref.payload.control, i)) decodeOK = false;
+        }
+    }
+    check(decodeOK, "MPacketView reads the same fields as MPacket");
+    check(!MPacketView((const uint8_t*)"", 0).validLength(), "MPacketView rejects short buffers");
+
+    // Validate and decode a received buffer: copy into an MPacket first, as the receive paths used to, or in place
+    MPacket packet = makeControlPacket(4711);
+    uint8_t rx[MPacketView::LENGTH + 1];
+    memcpy(rx + 1, &packet, sizeof(packet)); // odd address, as in a radio frame after its header
+    uint32_t raw[MControlPacket::NUM_AXES];
+    measure("copy to MPacket, CRC, decodeAll()", 1000000, [&]() {
+        clobberMemory();
+        MPacket p;
+        memcpy(&p, rx + 1, sizeof(p));
+        if(p.calculateCRC() == p.crc) p.payload.control.decodeAll(raw);
+        doNotOptimize(raw);
+    });
+    measure("MPacketView in place, CRC, rawAxes()", 1000000, [&]() {
+        clobberMemory();
+        MPacketView v(rx + 1, sizeof(packet));
+        if(v.valid()) v.rawAxes(raw);
+        doNotOptimize(raw);
+    });
+}
+
+// The hex codec as it was: std::string, sprintf and sscanf per byte.
+static std::string refSerializePacket(const MPacket& packet) {
+    char buf[3];
+    uint8_t wire[sizeof(MPacket)];
+    uint8_t len = packet.toWire(wire);
+    std::string retval = "[";
+    for(unsigned int i=0; i<len; i++) {
+        sprintf(buf, "%02x", wire[i]);
+        retval += buf;
+    }
+    retval += "]";
+    return retval;
+}
+
+static bool refDeserializePacket(MPacket& packet, const std::string& str) {
+    if(str.size() % 2 != 0 || str.size() < 2*2+2 || str.size() > 2*sizeof(packet)+2) return false;
+    if(str.rfind('[', 0) != 0 || str.rfind(']', str.size()-1) != str.size()-1) return false;
+    uint8_t wire[sizeof(MPacket)];
+    unsigned int len = (str.size()-2)/2;
+    const char* s = str.c_str()+1;
+    for(unsigned int i=0; i<len; i++) {
+        int a;
+        sscanf(s, "%02x", &a);
+        wire[i] = (uint8_t)a;
+        s += 2;
+    }
+    return packet.fromWire(wire, len) && packet.calculateCRC() == packet.crc;
+}
+
+BBR_BENCH(packetHexCodec) {
+    MPacket packet = makeControlPacket(4711);
+    std::string str = serializePacket(packet);
+    MPacket decoded;
+    check(deserializePacket(decoded, str), "deserializePacket() accepts serializePacket() output");
+    check(memcmp(&decoded, &packet, sizeof(packet)) == 0, "hex round trip is byte-identical");
+
+    bool sameAsBefore = true;
+    for(uint32_t seed=1; seed<1000; seed++) {
+        MPacket p = makeControlPacket(seed);
+        char buf[MAX_SERIALIZED_LENGTH+1];
+        size_t len = serializePacket(p, buf, sizeof(buf));
+        if(refSerializePacket(p) != std::string(buf, len) || strlen(buf) != len) sameAsBefore = false;
+    }
+    check(sameAsBefore, "buffer serializer produces the same strings as the sprintf version");
+
+    char buf[MAX_SERIALIZED_LENGTH+1];
+    size_t len = serializePacket(packet, buf, sizeof(buf));
+    check(serializePacket(packet, buf, len) == 0, "serializer refuses a buffer without room for the NUL");
+    for(size_t i=1; i<len-1; i++) buf[i] = toupper(buf[i]);
+    check(deserializePacket(decoded, buf, len), "upper case hex is accepted");
+    buf[5] = 'g';
+    check(!deserializePacket(decoded, buf, len), "non-hex character is rejected");
+    buf[5] = buf[5+2] == '0' ? '1' : '0';
+    check(!deserializePacket(decoded, buf, len), "wrong CRC is rejected");
+
+    len = serializePacket(packet, buf, sizeof(buf));
+    measure("serializePacket(), sprintf + std::string (before)", 200000, [&]() {
+        doNotOptimize(refSerializePacket(packet));
+    });
+    measure("serializePacket() into buffer", 1000000, [&]() {
+        doNotOptimize(serializePacket(packet, buf, sizeof(buf)));
+        clobberMemory();
+    });
+    measure("serializePacket() as std::string", 1000000, [&]() {
+        doNotOptimize(serializePacket(packet));
+    });
+    measure("deserializePacket(), sscanf (before)", 200000, [&]() {
+        doNotOptimize(refDeserializePacket(decoded, str));
+    });
+    measure("deserializePacket() from buffer", 1000000, [&]() {
+        clobberMemory();
+        doNotOptimize(deserializePacket(decoded, buf, len));
+    });
+}
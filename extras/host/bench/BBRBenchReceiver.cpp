@@ -0,0 +1,394 @@
+#include "BBRBench.h"
+#include "MCS/BBRMReceiver.h"
+#include "MCS/BBRMBatchMixer.h"
+#include "MCS/BBRMStaticReceiver.h"
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <functional>
+
+using namespace bb;
+using namespace bb::rmt;
+using namespace bb::bench;
+
+// Reimplementation of the routing MReceiver::incomingControlPacket() had before it used a dispatch plan:
+// walk all inputs, skip the ones whose axes belong to the other transmitter.
+static void referenceDispatch(const MReceiver& rx, uint8_t numInputs, const MControlPacket& packet, std::vector<float>& out) {
+    for(uint8_t i=0; i<numInputs; i++) {
+        if(!rx.hasMixForInput(i)) continue;
+        const AxisMix& mix = rx.mixForInput(i);
+        AxisID axis1 = mix.axis1, axis2 = mix.axis2;
+
+        if(packet.primary && ((axis1 >= SECONDARY_ADD && axis1 != AXIS_INVALID) || (axis2 >= SECONDARY_ADD && axis2 != AXIS_INVALID))) continue;
+        if(!packet.primary && (axis1 < SECONDARY_ADD || axis2 < SECONDARY_ADD)) continue;
+        if(axis1 >= SECONDARY_ADD && axis1 != AXIS_INVALID) axis1 -= SECONDARY_ADD;
+        if(axis2 >= SECONDARY_ADD && axis2 != AXIS_INVALID) axis2 -= SECONDARY_ADD;
+
+        const CompiledMix* compiled = rx.compiledMixForInput(i);
+        if(compiled != nullptr) {
+            out[i] = compiled->compute(packet.getRawAxis(axis1), packet.getRawAxis(axis2));
+        } else {
+            out[i] = mix.compute(packet.getAxis(axis1, UNIT_UNITY), 0, 1, packet.getAxis(axis2, UNIT_UNITY), 0, 1);
+        }
+    }
+}
+
+BBR_BENCH(receiverDispatch) {
+    static const uint8_t NUM_INPUTS = 32;
+    MReceiver rx;
+    std::vector<float> values(NUM_INPUTS, -99);
+    for(uint8_t i=0; i<NUM_INPUTS; i++) {
+        rx.addInput(std::string("in") + std::to_string(i), values[i]);
+    }
+
+    // A typical droid: most inputs on the primary remote, some on the secondary, a few two-axis mixes,
+    // an unused input, one with no valid axis, and one with an out-of-range axis that can't be compiled.
+    for(uint8_t i=0; i<NUM_INPUTS-4; i++) {
+        AxisID a = (i*7) % MControlPacket::NUM_AXES;
+        if(i % 3 == 1) a += SECONDARY_ADD;
+        if(i % 5 == 0) {
+            AxisID b = (a + 1) % MControlPacket::NUM_AXES + (a >= SECONDARY_ADD ? SECONDARY_ADD : 0);
+            rx.setMix(i, AxisMix(a, INTERP_LIN_CENTERED, b, INTERP_LIN_POSITIVE, i % 2 ? MIX_ADD : MIX_MULT));
+        } else {
+            rx.setMix(i, AxisMix(a, i % 2 ? INTERP_LIN_CENTERED : INTERP_LIN_POSITIVE_INV));
+        }
+    }
+    rx.setMix(NUM_INPUTS-3, AxisMix(AXIS_INVALID, INTERP_LIN_CENTERED));
+    rx.setMix(NUM_INPUTS-2, AxisMix(2*SECONDARY_ADD + 3, INTERP_LIN_CENTERED));
+    check(rx.compiledMixForInput(NUM_INPUTS-2) == nullptr, "out-of-range axis falls back to float mix");
+
+    MControlPacket packet;
+    memset(&packet, 0, sizeof(packet));
+    NodeAddr addr;
+    uint32_t seed = 12345;
+    bool same = true;
+    for(int n=0; n<2000; n++) {
+        for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+            seed = seed*1103515245 + 12345;
+            packet.setAxis(i, float((seed >> 16) & 0x3ff), UNIT_RAW);
+        }
+        packet.primary = n & 1;
+
+        std::vector<float> expected(NUM_INPUTS, -99);
+        referenceDispatch(rx, NUM_INPUTS, packet, expected);
+        for(uint8_t i=0; i<NUM_INPUTS; i++) values[i] = -99;
+        rx.incomingControlPacket(addr, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0, packet);
+        // memcmp, because the out-of-range axis yields NaN through getAxis() on both paths
+        if(memcmp(values.data(), expected.data(), NUM_INPUTS*sizeof(float)) != 0) same = false;
+
+        // Mixes change at runtime, eg. when reconfigured from the remote. The plan has to follow.
+        if(n == 1000) rx.setMix(0, AxisMix(4 + SECONDARY_ADD, INTERP_LIN_CENTERED_INV));
+    }
+    check(same, "dispatch plan delivers the same values to the same inputs as the input scan");
+
+    measure("MReceiver::incomingControlPacket(), 32 inputs, primary", 1000000, [&]() {
+        packet.primary = true;
+        rx.incomingControlPacket(addr, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0, packet);
+        doNotOptimize(values[0]);
+    });
+    measure("MReceiver::incomingControlPacket(), 32 inputs, secondary", 1000000, [&]() {
+        packet.primary = false;
+        rx.incomingControlPacket(addr, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0, packet);
+        doNotOptimize(values[0]);
+    });
+    std::vector<float> scratch(NUM_INPUTS);
+    measure("input scan reference, 32 inputs, primary", 1000000, [&]() {
+        packet.primary = true;
+        referenceDispatch(rx, NUM_INPUTS, packet, scratch);
+        doNotOptimize(scratch[0]);
+    });
+}
+
+BBR_BENCH(batchMixer) {
+    static const uint8_t NUM_INPUTS = 32;
+    static const size_t NUM_PACKETS = 100000;
+
+    // Same kind of droid as receiverDispatch, minus the out-of-range axis (MReceiver yields NaN for it).
+    MReceiver rx;
+    std::vector<float> values(NUM_INPUTS, 0);
+    for(uint8_t i=0; i<NUM_INPUTS; i++) {
+        rx.addInput(std::string("in") + std::to_string(i), values[i]);
+    }
+    for(uint8_t i=0; i<NUM_INPUTS-3; i++) {
+        AxisID a = (i*7) % MControlPacket::NUM_AXES;
+        if(i % 3 == 1) a += SECONDARY_ADD;
+        if(i % 5 == 0) {
+            AxisID b = (a + 1) % MControlPacket::NUM_AXES + (a >= SECONDARY_ADD ? SECONDARY_ADD : 0);
+            rx.setMix(i, AxisMix(a, INTERP_LIN_CENTERED, b, {-100, 20, 0, 80, 100}, i % 2 ? MIX_ADD : MIX_MULT));
+        } else if(i % 7 == 3) {
+            rx.setMix(i, AxisMix(AXIS_INVALID, INTERP_ZERO, a, INTERP_LIN_POSITIVE_INV));
+        } else {
+            rx.setMix(i, AxisMix(a, i % 2 ? INTERP_LIN_CENTERED : Interpolator{30, -50, 0, 10, 100}));
+        }
+    }
+    rx.setMix(NUM_INPUTS-3, AxisMix(3, INTERP_LIN_CENTERED, 4 + SECONDARY_ADD, INTERP_LIN_CENTERED, MIX_ADD));
+    rx.setMix(NUM_INPUTS-1, AxisMix(AXIS_INVALID, INTERP_LIN_CENTERED));
+
+    std::vector<MControlPacket> packets(NUM_PACKETS);
+    uint32_t seed = 777;
+    for(size_t n=0; n<NUM_PACKETS; n++) {
+        memset(&packets[n], 0, sizeof(MControlPacket));
+        for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+            seed = seed*1103515245 + 12345;
+            packets[n].setAxis(i, float((seed >> 16) & 0x3ff), UNIT_RAW);
+        }
+        packets[n].primary = (seed >> 28) != 0; // mostly primary, like a real remote pair
+    }
+
+    MBatchMixer mixer;
+    mixer.setMixes(rx);
+    check(mixer.numInputs() == NUM_INPUTS, "batch mixer covers all inputs up to the last mix");
+    std::vector<float> out(NUM_PACKETS * mixer.numInputs());
+    mixer.evaluate(packets.data(), NUM_PACKETS, out.data());
+
+    NodeAddr addr;
+    float maxErr = 0;
+    for(size_t n=0; n<5000; n++) {
+        rx.incomingControlPacket(addr, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0, packets[n]);
+        for(uint8_t i=0; i<NUM_INPUTS; i++) maxErr = fmaxf(maxErr, fabsf(values[i] - out[n*NUM_INPUTS + i]));
+    }
+    report("max deviation from MReceiver (x1e6)", maxErr * 1e6, "");
+    check(maxErr < 2e-3, "batch mixer matches MReceiver");
+
+    // Both paths through the float reference, so only rounding differs.
+    MixManager floatOnly;
+    for(uint8_t i=0; i<rx.numMixes(); i++) floatOnly.setMix(rx.inputForMixIndex(i), rx.mixAtIndex(i));
+    mixer.setMixes(floatOnly);
+    mixer.evaluate(packets.data(), 1, out.data());
+    maxErr = 0;
+    for(uint8_t i=0; i<NUM_INPUTS; i++) {
+        const AxisMix& mix = floatOnly.mixForInput(i);
+        if(!floatOnly.hasMixForInput(i)) continue;
+        bool primaryOnly = (mix.axis1 < SECONDARY_ADD || mix.axis1 == AXIS_INVALID) && (mix.axis2 < SECONDARY_ADD || mix.axis2 == AXIS_INVALID);
+        if(packets[0].primary != primaryOnly) continue;
+        AxisID a1 = mix.axis1 == AXIS_INVALID ? AXIS_INVALID : mix.axis1 % SECONDARY_ADD;
+        AxisID a2 = mix.axis2 == AXIS_INVALID ? AXIS_INVALID : mix.axis2 % SECONDARY_ADD;
+        float ref = mix.compute(packets[0].getAxis(a1, UNIT_UNITY), 0, 1, packets[0].getAxis(a2, UNIT_UNITY), 0, 1);
+        maxErr = fmaxf(maxErr, fabsf(ref - out[i]));
+    }
+    check(maxErr < 1e-5, "batch mixer matches AxisMix::compute()");
+
+    mixer.setMixes(rx);
+    double ns = measure("MBatchMixer::evaluate(), 32 inputs, 100k packets", 20, [&]() {
+        mixer.evaluate(packets.data(), NUM_PACKETS, out.data());
+        doNotOptimize(out[0]);
+    }) / NUM_PACKETS;
+    report("  per packet", ns, "ns");
+    report("  throughput", 1000.0 / ns, "M packets/s");
+}
+
+static constexpr Interpolator INTERP_EXPO = {-100, -20, 0, 20, 100};
+static constexpr Interpolator INTERP_ODD = {30, -50, 0, 10, 100};
+
+BBR_BENCH(staticReceiver) {
+    float v[8];
+    MStaticReceiver<StaticMix<0, INTERP_LIN_CENTERED>,
+                    StaticMix<1, INTERP_EXPO>,
+                    StaticMix<5, INTERP_LIN_POSITIVE_INV>,
+                    StaticMix<10, INTERP_ODD>,
+                    StaticMix<2 + SECONDARY_ADD, INTERP_LIN_CENTERED>,
+                    StaticMix<3, INTERP_LIN_CENTERED, 4, INTERP_EXPO, MIX_ADD>,
+                    StaticMix<AXIS_INVALID, INTERP_ZERO, 12, INTERP_LIN_POSITIVE>,
+                    StaticMix<6, INTERP_LIN_POSITIVE, 7, INTERP_LIN_CENTERED_INV, MIX_MULT>>
+        srx({"a", "b", "c", "d", "e", "f", "g", "h"}, {&v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]});
+
+    float w[8];
+    MReceiver rx;
+    for(uint8_t i=0; i<8; i++) {
+        rx.addInput(srx.inputName(i), w[i]);
+        rx.setMix(i, srx.mixForInput(i));
+    }
+    check(srx.numInputs() == 8 && srx.numMixes() == 8, "static receiver reports its inputs and mixes");
+    check(srx.mixForInput(5).axis2 == 4 && srx.mixForInput(5).mixType == MIX_ADD, "static receiver reports mix details");
+    check(srx.setMix(0, AxisMix(1)) == false, "static receiver mixes are read-only");
+    check(srx.addInput("x", v[0]) == INPUT_INVALID, "static receiver inputs are fixed");
+
+    MControlPacket packet;
+    memset(&packet, 0, sizeof(packet));
+    NodeAddr addr;
+    uint32_t seed = 99;
+    bool same = true;
+    for(int n=0; n<20000; n++) {
+        for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+            seed = seed*1103515245 + 12345;
+            packet.setAxis(i, float((seed >> 16) & 0x3ff), UNIT_RAW);
+        }
+        packet.primary = (n % 3) != 0;
+        for(uint8_t i=0; i<8; i++) v[i] = w[i] = -99;
+        srx.incomingControlPacket(addr, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0, packet);
+        rx.incomingControlPacket(addr, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0, packet);
+        if(memcmp(v, w, sizeof(v)) != 0) same = false;
+    }
+    check(same, "static receiver delivers exactly what MReceiver delivers");
+
+    // Aggregate frames feed every input, the frame buffer is ignored
+    float frame[8];
+    srx.setFrameBuffer(frame, 8);
+    MControlPair pair;
+    memset(&pair, 0, sizeof(pair));
+    for(int n=0; n<20000; n++) {
+        for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+            seed = seed*1103515245 + 12345;
+            pair.primary.setAxis(i, float((seed >> 16) & 0x3ff), UNIT_RAW);
+            pair.secondary.setAxis(i, float((seed >> 6) & 0x3ff), UNIT_RAW);
+        }
+        for(uint8_t i=0; i<8; i++) v[i] = w[i] = -99;
+        srx.incomingControlPair(addr, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0, pair);
+        rx.incomingControlPair(addr, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0, pair);
+        if(memcmp(v, w, sizeof(v)) != 0) same = false;
+    }
+    check(same, "static receiver delivers aggregate frames exactly as MReceiver does");
+
+    packet.primary = true;
+    measure("MStaticReceiver::incomingControlPacket(), 8 inputs", 10000000, [&]() {
+        srx.incomingControlPacket(addr, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0, packet);
+        doNotOptimize(v[0]);
+    });
+    measure("MReceiver::incomingControlPacket(), same 8 inputs", 10000000, [&]() {
+        rx.incomingControlPacket(addr, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0, packet);
+        doNotOptimize(w[0]);
+    });
+}
+
+BBR_BENCH(changeOnlyInputs) {
+    MReceiver rx;
+    unsigned allCalls = 0, changeCalls = 0, deadbandCalls = 0;
+    float last = 0;
+    rx.addInput("all", [&](float v) { allCalls++; });
+    rx.addInput("change", [&](float v) { changeCalls++; }, true);
+    rx.addInput("deadband", [&](float v) { deadbandCalls++; last = v; }, true, 0.02f);
+    for(uint8_t i=0; i<3; i++) rx.setMix(i, AxisMix(0, INTERP_LIN_CENTERED));
+
+    MControlPacket packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.primary = true;
+    NodeAddr addr;
+    auto send = [&](uint16_t raw) {
+        packet.setAxis(0, raw, UNIT_RAW);
+        rx.incomingControlPacket(addr, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0, packet);
+    };
+
+    send(600); send(600); send(600);
+    check(allCalls == 3 && changeCalls == 1 && deadbandCalls == 1, "repeated values are delivered once to change-only inputs");
+    send(601);
+    check(changeCalls == 2 && deadbandCalls == 1, "small changes are held back by the deadband only");
+    send(620);
+    check(deadbandCalls == 2, "changes beyond the deadband are delivered");
+    send(1018);
+    check(deadbandCalls == 3, "changes beyond the deadband are delivered");
+    send(1023);
+    check(deadbandCalls == 4 && last == 1.0f, "reaching full deflection is delivered despite the deadband");
+    rx.forgetDeliveredValues();
+    send(1023);
+    check(changeCalls == 6 && deadbandCalls == 5, "forgetDeliveredValues() makes the next value go through");
+
+    // A stick held still with +-1 LSB of noise, then moved slowly, at 100Hz for 10 seconds
+    allCalls = changeCalls = deadbandCalls = 0;
+    uint32_t seed = 5;
+    for(int n=0; n<1000; n++) {
+        seed = seed*1103515245 + 12345;
+        int noise = int((seed >> 16) % 3) - 1;
+        int pos = n < 500 ? 512 : 512 + (n-500);
+        send(uint16_t(pos + noise));
+    }
+    report("callbacks, every packet", allCalls, "");
+    report("callbacks, change only", changeCalls, "");
+    report("callbacks, change only with 0.02 deadband", deadbandCalls, "");
+    check(deadbandCalls < allCalls / 5, "deadband removes most callbacks for a noisy stick");
+}
+
+BBR_BENCH(frameDelivery) {
+    static const uint8_t NUM_INPUTS = 32;
+
+    // Same mixes twice: one receiver with a callback per input, one delivering frames
+    MReceiver cbRx, frameRx;
+    std::vector<float> values(NUM_INPUTS, 0);
+    float frame[NUM_INPUTS] = {0};
+    InputMask lastMask;
+    lastMask.clear();
+    unsigned frames = 0;
+    for(uint8_t i=0; i<NUM_INPUTS; i++) {
+        std::string name = std::string("in") + std::to_string(i);
+        cbRx.addInput(name, values[i]);
+        frameRx.addInput(name);
+        AxisID a = (i*7) % MControlPacket::NUM_AXES;
+        if(i % 4 == 1) a += SECONDARY_ADD;
+        AxisMix mix(a, i % 2 ? INTERP_LIN_CENTERED : INTERP_LIN_POSITIVE);
+        cbRx.setMix(i, mix);
+        frameRx.setMix(i, mix);
+    }
+    frameRx.setFrameBuffer(frame, NUM_INPUTS, [&](const NodeAddr&, uint8_t, const float* f, const InputMask& mask) {
+        frames++;
+        lastMask = mask;
+    });
+
+    MControlPacket packet;
+    memset(&packet, 0, sizeof(packet));
+    NodeAddr addr;
+    uint32_t seed = 31337;
+    bool same = true, masksRight = true;
+    for(int n=0; n<1000; n++) {
+        for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+            seed = seed*1103515245 + 12345;
+            packet.setAxis(i, float((seed >> 16) & 0x3ff), UNIT_RAW);
+        }
+        packet.primary = (n % 4) != 0;
+        cbRx.incomingControlPacket(addr, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0, packet);
+        frameRx.incomingControlPacket(addr, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0, packet);
+        if(memcmp(values.data(), frame, sizeof(frame)) != 0) same = false;
+        for(uint8_t i=0; i<NUM_INPUTS; i++) {
+            if(lastMask.test(i) != (packet.primary == (i % 4 != 1))) masksRight = false;
+        }
+    }
+    check(frames == 1000, "one frame callback per packet");
+    check(same, "frame buffer holds the same values as the per-input callbacks");
+    check(masksRight, "frame mask marks exactly the inputs the packet updated");
+
+    packet.primary = true;
+    measure("MReceiver::incomingControlPacket(), 32 inputs, callbacks", 1000000, [&]() {
+        cbRx.incomingControlPacket(addr, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0, packet);
+        doNotOptimize(values[0]);
+    });
+    measure("MReceiver::incomingControlPacket(), 32 inputs, frame", 1000000, [&]() {
+        frameRx.incomingControlPacket(addr, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0, packet);
+        doNotOptimize(frame[0]);
+    });
+}
+
+BBR_BENCH(callbackOverhead) {
+    float target = 0;
+    std::function<void(float)> stdFn = [&target](float v) { target = v; };
+    Callback<void(float)> cb = [&target](float v) { target = v; };
+    cb(0.5f);
+    check(target == 0.5f, "Callback calls through to the lambda");
+    Callback<void(float)> copy = cb;
+    cb = nullptr;
+    copy(0.25f);
+    check(target == 0.25f && cb == nullptr && copy != nullptr, "Callback copies and resets");
+    cb(1.0f); // empty, does nothing
+    check(target == 0.25f, "empty Callback does nothing");
+
+    float v = 0;
+    measure("std::function<void(float)>, call", 100000000, [&]() {
+        v += 1.0f;
+        stdFn(v);
+        clobberMemory();
+    });
+    measure("Callback<void(float)>, call", 100000000, [&]() {
+        v += 1.0f;
+        copy(v);
+        clobberMemory();
+    });
+
+    // Setting a callback whose lambda captures three references: std::function allocates (libstdc++ stores
+    // 16 bytes inline), Callback doesn't.
+    float a = 0, b = 0, c = 0;
+    measure("std::function<void(float)>, construct + destroy, 3 captures", 10000000, [&]() {
+        std::function<void(float)> f = [&a, &b, &c](float x) { a = x; b = x; c = x; };
+        doNotOptimize(f);
+    });
+    measure("Callback<void(float)>, construct + destroy, 3 captures", 10000000, [&]() {
+        Callback<void(float)> f = [&a, &b, &c](float x) { a = x; b = x; c = x; };
+        doNotOptimize(f);
+    });
+}
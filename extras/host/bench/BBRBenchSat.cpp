@@ -0,0 +1,158 @@
+#include "BBRBench.h"
+#include "MCS/Sat/BBRMSatProtocol.h"
+
+using namespace bb;
+using namespace bb::rmt;
+using namespace bb::bench;
+
+// A control packet with some axes set, as it goes on the wire.
+static uint8_t controlWire(uint8_t* wire, uint8_t seqnum, float value,
+                           MPacket::PacketSource source = MPacket::PACKET_SOURCE_LEFT_REMOTE, bool primary = true) {
+    MPacket packet(MPacket::PACKET_TYPE_CONTROL, source, seqnum);
+    memset(&packet.payload, 0, sizeof(packet.payload));
+    packet.payload.control.primary = primary;
+    packet.payload.control.setAxis(0, value);
+    packet.payload.control.setAxis(1, -value);
+    packet.crc = packet.calculateCRC();
+    return packet.toWire(wire);
+}
+
+BBR_BENCH(satFraming) {
+    // Round trip of random wire bytes of every length, zeros included, in both framings.
+    bool roundTrip = true;
+    uint32_t seed = 1;
+    for(int n=0; n<20000; n++) {
+        uint8_t wire[MAX_FRAMED_LENGTH], frame[MAX_FRAME_LENGTH];
+        uint8_t len = 1 + n % MAX_FRAMED_LENGTH;
+        for(uint8_t i=0; i<len; i++) {
+            seed = seed * 1103515245 + 12345;
+            wire[i] = (seed >> 16) % 3 == 0 ? 0 : seed >> 24;
+        }
+        MFraming framing = (n & 1) ? FRAMING_HEX : FRAMING_BINARY;
+        uint8_t flen = encodeFrame(wire, len, framing, frame);
+        if(framing == FRAMING_BINARY && (flen != len + 2 || memchr(frame, 0, flen-1) != nullptr)) roundTrip = false;
+
+        MFrameDecoder dec;
+        unsigned int complete = 0;
+        for(uint8_t i=0; i<flen; i++) {
+            MFrameDecoder::Result r = dec.feed(frame[i]);
+            if(r == MFrameDecoder::FRAME_ERROR) roundTrip = false;
+            if(r == MFrameDecoder::FRAME_COMPLETE) complete++;
+        }
+        if(complete != 1 || dec.length() != len || memcmp(dec.data(), wire, len) != 0 || dec.framing() != framing) {
+            roundTrip = false;
+        }
+    }
+    check(roundTrip, "COBS and hex frames decode to the original bytes, COBS frames have no 0 inside");
+
+    // The longest frame without a 0 has the largest code byte, which must not be taken for a hex frame
+    {
+        uint8_t wire[MAX_FRAMED_LENGTH + 1], frame[MAX_FRAME_LENGTH];
+        memset(wire, 0x5b, sizeof(wire));
+        uint8_t flen = encodeFrame(wire, MAX_FRAMED_LENGTH, FRAMING_BINARY, frame);
+        MFrameDecoder dec;
+        unsigned int complete = 0;
+        for(uint8_t i=0; i<flen; i++) if(dec.feed(frame[i]) == MFrameDecoder::FRAME_COMPLETE) complete++;
+        check(complete == 1 && dec.length() == MAX_FRAMED_LENGTH && dec.framing() == FRAMING_BINARY,
+              "COBS frames of the longest length decode as COBS");
+        check(encodeFrame(wire, MAX_FRAMED_LENGTH + 1, FRAMING_BINARY, frame) == 0, "longer frames are refused");
+        MSatProtocol sat;
+        check(sat.maxWireLength() <= MAX_FRAMED_LENGTH, "the satellite link doesn't send longer frames");
+    }
+
+    // Sender and satellite on a simulated serial line: garbage, then frames switching between framings.
+    HardwareSerial line, satPort;
+    MSatProtocol sender, sat;
+    sender.init(&line);
+    sat.init(&satPort);
+    float speed = 0;
+    unsigned int updates = 0;
+    Receiver* rx = sat.createReceiver();
+    InputID speedInput = rx->addInput(INPUT_NAME_SPEED, [&](float v) { speed = v; updates++; });
+    rx->setMix(speedInput, AxisMix(0, INTERP_LIN_CENTERED));
+
+    const uint8_t garbage[] = {'x', 0x42, ']', 0x17, 0xff};
+    satPort.inject(garbage, sizeof(garbage));
+    const unsigned int numPackets = 100;
+    for(unsigned int i=0; i<numPackets; i++) {
+        sender.setFraming((i/10) % 2 ? FRAMING_HEX : FRAMING_BINARY);
+        if(i % 10 == 0) line.write(uint8_t(0)); // switching back to binary after hex: resync on a 0
+        MPacket packet(MPacket::PACKET_TYPE_CONTROL, MPacket::PACKET_SOURCE_LEFT_REMOTE, 0);
+        memset(&packet.payload, 0, sizeof(packet.payload));
+        packet.payload.control.primary = true;
+        packet.payload.control.setAxis(0, (i%2) ? 0.5 : -0.5);
+        sender.sendPacket(NodeAddr(), packet);
+    }
+    satPort.inject(line.txBuffer().data(), line.txBuffer().size());
+    sat.step();
+    check(updates == numPackets && fabs(speed - 0.5) < 0.01, "every packet arrives, whatever the framing");
+    check(sat.stats().crcErrors == 0 && sat.stats().sizeErrors == 0, "no bad packets from the garbage");
+
+    // Primary and secondary transmitter on the same line, each with its own sequence numbers. The primary goes
+    // on where the sender above left off.
+    float turn = 0;
+    unsigned int turnUpdates = 0;
+    InputID turnInput = rx->addInput(INPUT_NAME_TURN_RATE, [&](float v) { turn = v; turnUpdates++; });
+    rx->setMix(turnInput, AxisMix(SECONDARY_ADD, INTERP_LIN_CENTERED));
+    sat.resetStats();
+    updates = 0;
+    std::vector<uint8_t> lines(1, 0); // back to binary after hex
+    for(unsigned int i=0; i<numPackets; i++) {
+        uint8_t wire[sizeof(MPacket)], frame[MAX_FRAME_LENGTH];
+        uint8_t len = controlWire(wire, (numPackets + i) % 8, 0.5, MPacket::PACKET_SOURCE_LEFT_REMOTE, true);
+        uint8_t flen = encodeFrame(wire, len, FRAMING_BINARY, frame);
+        lines.insert(lines.end(), frame, frame + flen);
+        len = controlWire(wire, (i + 5) % 8, 0.25, MPacket::PACKET_SOURCE_RIGHT_REMOTE, false);
+        flen = encodeFrame(wire, len, FRAMING_BINARY, frame);
+        lines.insert(lines.end(), frame, frame + flen);
+    }
+    satPort.inject(lines.data(), lines.size());
+    sat.step();
+    check(updates == numPackets && turnUpdates == numPackets, "both transmitters' packets arrive over one link");
+    check(sat.stats().duplicates == 0 && sat.stats().reordered == 0 && sat.stats().packetsLost == 0,
+          "the two sequence number streams are tracked apart");
+
+    // Cost per received control packet, hex string as before vs. COBS decoder
+    uint8_t wire[sizeof(MPacket)], hex[MAX_FRAME_LENGTH], cobs[MAX_FRAME_LENGTH];
+    uint8_t wlen = controlWire(wire, 3, 0.3);
+    uint8_t hexLen = encodeFrame(wire, wlen, FRAMING_HEX, hex);
+    uint8_t cobsLen = encodeFrame(wire, wlen, FRAMING_BINARY, cobs);
+    report("bytes on the line per control packet, hex", hexLen, "bytes");
+    report("bytes on the line per control packet, COBS", cobsLen, "bytes");
+
+    std::string str;
+    MPacket packet;
+    bool ok = true;
+    measure("receive control packet, hex via std::string + deserializePacket()", 100000, [&]() {
+        for(uint8_t i=0; i<hexLen; i++) {
+            char b = hex[i];
+            str = str + b;
+            if(b == ']') {
+                if(!deserializePacket(packet, str)) ok = false;
+                str = "";
+            }
+        }
+        doNotOptimize(packet);
+    });
+    MFrameDecoder dec;
+    unsigned long frames = 0;
+    measure("receive control packet, COBS via MFrameDecoder + MPacketView", 100000, [&]() {
+        for(uint8_t i=0; i<cobsLen; i++) {
+            if(dec.feed(cobs[i]) == MFrameDecoder::FRAME_COMPLETE) {
+                MPacketView view(dec.data(), dec.length());
+                if(view.valid()) frames++;
+            }
+        }
+        clobberMemory();
+    });
+    check(ok && frames > 0, "both paths decode the packet");
+    measure("receive control packet, hex via MFrameDecoder + MPacketView", 100000, [&]() {
+        for(uint8_t i=0; i<hexLen; i++) {
+            if(dec.feed(hex[i]) == MFrameDecoder::FRAME_COMPLETE) {
+                MPacketView view(dec.data(), dec.length());
+                if(view.valid()) frames++;
+            }
+        }
+        clobberMemory();
+    });
+}
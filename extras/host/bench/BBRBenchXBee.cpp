@@ -0,0 +1,76 @@
+#include "BBRBench.h"
+#include "MCS/XBee/BBRMXBProtocol.h"
+
+using namespace bb;
+using namespace bb::rmt;
+using namespace bb::bench;
+
+// Exposes the protected API frame send / receive path on an in-memory serial port.
+class XBBench: public MXBProtocol {
+public:
+    XBBench(HardwareSerial* uart) {
+        uart_ = uart;
+        apiMode_ = true;
+    }
+
+    bool sendFrame(const uint8_t* data, uint16_t length) {
+        APIFrame frame(data, length);
+        return send(frame);
+    }
+
+    bool receiveFrame(uint8_t* data, uint16_t& length) {
+        APIFrame frame;
+        if(receive(frame) == false) return false;
+        memcpy(data, frame.data(), frame.length());
+        length = frame.length();
+        return true;
+    }
+};
+
+BBR_BENCH(xbeeAPIFrame) {
+    HardwareSerial uart;
+    XBBench xb(&uart);
+
+    // Worst case for escaping: every byte is one of the escaped characters.
+    uint8_t plain[29], escaped[29];
+    for(unsigned int i=0; i<sizeof(plain); i++) plain[i] = uint8_t(0x20 + i);
+    for(unsigned int i=0; i<sizeof(escaped); i++) escaped[i] = (i%2) ? 0x7d : 0x11;
+
+    uint8_t buf[64];
+    uint16_t len = 0;
+    xb.sendFrame(escaped, sizeof(escaped));
+    check(uart.txBuffer().size() == 1 + 2 + 2*sizeof(escaped) + 1, "all special bytes get escaped");
+    uart.inject(uart.txBuffer().data(), uart.txBuffer().size());
+    uart.txBuffer().clear();
+    check(xb.receiveFrame(buf, len) && len == sizeof(escaped) && memcmp(buf, escaped, len) == 0, 
+          "escaped frame round trip");
+
+    // Line noise in front of a frame, and a frame with a broken checksum.
+    xb.resetStats();
+    const uint8_t noise[] = {0x00, 0x42, 0xff};
+    uart.inject(noise, sizeof(noise));
+    xb.sendFrame(plain, sizeof(plain));
+    uart.txBuffer().back() ^= 0x01;
+    uart.inject(uart.txBuffer().data(), uart.txBuffer().size());
+    uart.txBuffer().clear();
+    check(xb.receiveFrame(buf, len) == false, "frame with broken checksum is rejected");
+    check(xb.stats().garbageBytes == sizeof(noise) && xb.stats().framingErrors == 1, 
+          "garbage bytes and checksum error are counted");
+
+    measure("APIFrame send, 29 bytes, no escapes", 1000000, [&]() {
+        xb.sendFrame(plain, sizeof(plain));
+        uart.txBuffer().clear();
+    });
+    measure("APIFrame send, 29 bytes, all escaped", 1000000, [&]() {
+        xb.sendFrame(escaped, sizeof(escaped));
+        uart.txBuffer().clear();
+    });
+
+    xb.sendFrame(escaped, sizeof(escaped));
+    std::vector<uint8_t> wire = uart.txBuffer();
+    uart.txBuffer().clear();
+    measure("APIFrame receive, 29 bytes, all escaped", 1000000, [&]() {
+        uart.inject(wire.data(), wire.size());
+        doNotOptimize(xb.receiveFrame(buf, len));
+    });
+}
@@ -0,0 +1,117 @@
+#if !defined(BBR_HOST_ARDUINO_H)
+#define BBR_HOST_ARDUINO_H
+
+// Minimal host (Linux / macOS) stand-in for the Arduino core. Provides just enough of the
+// Arduino API -- timing functions, `String`, `HardwareSerial`, `Serial` and `Serial1` -- for
+// the platform-independent parts of BBRemotes to compile and run natively. Not a general
+// purpose Arduino emulation.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <deque>
+#include <vector>
+#include <functional>
+
+#define HEX 16
+#define DEC 10
+
+#if !defined(constrain)
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#endif
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+//! Arduino-compatible string class, backed by `std::string`.
+class String {
+public:
+    String() {}
+    String(const char* str): str_(str != nullptr ? str : "") {}
+    String(const std::string& str): str_(str) {}
+    String(char c): str_(1, c) {}
+    String(int value, unsigned char base = DEC);
+    String(unsigned int value, unsigned char base = DEC);
+    String(long value, unsigned char base = DEC);
+    String(unsigned long value, unsigned char base = DEC);
+
+    const char* c_str() const { return str_.c_str(); }
+    unsigned int length() const { return str_.length(); }
+    char operator[](unsigned int index) const { return index < str_.length() ? str_[index] : 0; }
+
+    void trim();
+    bool equals(const String& other) const { return str_ == other.str_; }
+
+    String& operator+=(const String& other) { str_ += other.str_; return *this; }
+    String& operator+=(const char* other) { str_ += other; return *this; }
+    String& operator+=(char c) { str_ += c; return *this; }
+
+    friend String operator+(const String& a, const String& b) { return String(a.str_ + b.str_); }
+    friend String operator+(const String& a, const char* b) { return String(a.str_ + b); }
+    friend bool operator==(const String& a, const String& b) { return a.str_ == b.str_; }
+    friend bool operator==(const String& a, const char* b) { return a.str_ == b; }
+    friend bool operator!=(const String& a, const String& b) { return a.str_ != b.str_; }
+    friend bool operator!=(const String& a, const char* b) { return a.str_ != b; }
+
+protected:
+    std::string str_;
+};
+
+/**
+ * In-memory serial port.
+ * 
+ * Bytes written by the library are collected in `txBuffer()` (or echoed to stdout for the console port),
+ * bytes to be read by the library are queued with `inject()`.
+ */
+class HardwareSerial {
+public:
+    HardwareSerial(bool console = false): console_(console) {}
+
+    void begin(unsigned long baud) { baud_ = baud; }
+    void end() {}
+    operator bool() const { return true; }
+
+    int available() { return rxBuffer_.size(); }
+    int read();
+    int peek() { return rxBuffer_.size() ? rxBuffer_.front() : -1; }
+
+    size_t write(uint8_t byte);
+    size_t write(const char* str);
+    size_t write(const uint8_t* buf, size_t len);
+
+    size_t print(const char* str) { return write(str); }
+    size_t print(const String& str) { return write(str.c_str()); }
+    size_t print(char c) { return write(uint8_t(c)); }
+    size_t print(int value) { return print(String(value)); }
+    size_t print(unsigned int value) { return print(String(value)); }
+    size_t print(long value) { return print(String(value)); }
+    size_t print(unsigned long value) { return print(String(value)); }
+    template<typename T> size_t println(const T& value) { size_t n = print(value); return n + write("\r\n"); }
+    size_t println() { return write("\r\n"); }
+
+    //! Queue bytes to be returned by subsequent `read()` calls.
+    void inject(const uint8_t* buf, size_t len) { rxBuffer_.insert(rxBuffer_.end(), buf, buf+len); }
+    //! Bytes written so far (not used for the console port).
+    std::vector<uint8_t>& txBuffer() { return txBuffer_; }
+    unsigned long baud() const { return baud_; }
+    //! Suppress console output, eg. to keep library chatter out of benchmark results.
+    void setMuted(bool muted) { muted_ = muted; }
+
+protected:
+    bool console_;
+    bool muted_ = false;
+    unsigned long baud_ = 0;
+    std::deque<uint8_t> rxBuffer_;
+    std::vector<uint8_t> txBuffer_;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif // BBR_HOST_ARDUINO_H
@@ -0,0 +1,101 @@
+#include <Arduino.h>
+#include <chrono>
+#include <thread>
+
+#include "BBRHostHAL.h"
+
+HardwareSerial Serial(true);
+HardwareSerial Serial1;
+
+static const std::chrono::steady_clock::time_point startTime_ = std::chrono::steady_clock::now();
+static bool virtualTime_ = false;
+static unsigned long long virtualUS_ = 0;
+
+static unsigned long long realMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime_).count();
+}
+
+void bb::hal::setVirtualTime(bool on) {
+    if(on && !virtualTime_) virtualUS_ = realMicros();
+    virtualTime_ = on;
+}
+
+bool bb::hal::isVirtualTime() {
+    return virtualTime_;
+}
+
+void bb::hal::advanceMicros(unsigned long us) {
+    if(virtualTime_) virtualUS_ += us;
+}
+
+unsigned long micros() {
+    return (unsigned long)(virtualTime_ ? virtualUS_ : realMicros());
+}
+
+unsigned long millis() {
+    return (unsigned long)((virtualTime_ ? virtualUS_ : realMicros()) / 1000);
+}
+
+void delay(unsigned long ms) {
+    if(virtualTime_) virtualUS_ += (unsigned long long)ms * 1000;
+    else std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us) {
+    if(virtualTime_) virtualUS_ += us;
+    else std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+static std::string toBase(unsigned long value, unsigned char base, bool negative) {
+    if(base < 2 || base > 16) base = DEC;
+    char buf[sizeof(unsigned long)*8+2];
+    char *p = buf + sizeof(buf) - 1;
+    *p = 0;
+    do {
+        *--p = "0123456789abcdef"[value % base];
+        value /= base;
+    } while(value != 0);
+    if(negative) *--p = '-';
+    return p;
+}
+
+String::String(int value, unsigned char base): String(long(value), base) {}
+String::String(unsigned int value, unsigned char base): String((unsigned long)value, base) {}
+String::String(unsigned long value, unsigned char base): str_(toBase(value, base, false)) {}
+String::String(long value, unsigned char base) {
+    if(base == DEC && value < 0) str_ = toBase((unsigned long)(-value), base, true);
+    else str_ = toBase((unsigned long)value, base, false);
+}
+
+void String::trim() {
+    size_t first = str_.find_first_not_of(" \t\r\n");
+    if(first == std::string::npos) {
+        str_.clear();
+        return;
+    }
+    size_t last = str_.find_last_not_of(" \t\r\n");
+    str_ = str_.substr(first, last-first+1);
+}
+
+int HardwareSerial::read() {
+    if(rxBuffer_.size() == 0) return -1;
+    uint8_t byte = rxBuffer_.front();
+    rxBuffer_.pop_front();
+    return byte;
+}
+
+size_t HardwareSerial::write(uint8_t byte) {
+    if(console_) { if(!muted_) fputc(byte, stdout); }
+    else txBuffer_.push_back(byte);
+    return 1;
+}
+
+size_t HardwareSerial::write(const char* str) {
+    return write((const uint8_t*)str, strlen(str));
+}
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t len) {
+    if(console_) { if(!muted_) fwrite(buf, 1, len, stdout); }
+    else txBuffer_.insert(txBuffer_.end(), buf, buf+len);
+    return len;
+}
@@ -0,0 +1,25 @@
+#if !defined(BBRHOSTHAL_H)
+#define BBRHOSTHAL_H
+
+namespace bb {
+namespace hal {
+
+/**
+ * Virtual time for the host build.
+ * 
+ * By default `millis()` / `micros()` follow the host's steady clock and `delay()` sleeps. With
+ * virtual time enabled, the clock only moves when `advanceMicros()` or `delay()` / `delayMicroseconds()`
+ * are called, and never sleeps -- so simulated links run faster than real time and deterministically.
+ */
+
+//! Switch virtual time on or off. Switching on starts the virtual clock at the current real time.
+void setVirtualTime(bool on);
+//! Returns true if virtual time is active.
+bool isVirtualTime();
+//! Advance the virtual clock. No effect if virtual time is off.
+void advanceMicros(unsigned long us);
+
+}; // hal
+}; // bb
+
+#endif // BBRHOSTHAL_H
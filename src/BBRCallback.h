@@ -0,0 +1,122 @@
+#if !defined(BBRCALLBACK_H)
+#define BBRCALLBACK_H
+
+#include <stddef.h>
+#include <string.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+//! Bytes of inline storage per callback. Lambdas with larger captures don't compile; capture by reference instead.
+#if !defined(BBR_CALLBACK_STORAGE)
+#define BBR_CALLBACK_STORAGE (4*sizeof(void*))
+#endif
+
+namespace bb {
+namespace rmt {
+
+template<typename Signature> class Callback;
+
+/**
+ * Non-allocating replacement for `std::function`, used for all callbacks in the library.
+ *
+ * Holds a function pointer or any callable (lambda, functor) of up to `BBR_CALLBACK_STORAGE` bytes in inline
+ * storage, so setting or copying a callback never touches the heap -- on AVR and SAMD, `std::function` allocates
+ * for almost every lambda. A call is one indirect call through a trampoline. Like `std::function`, it can be
+ * compared to and assigned `nullptr`; calling an empty callback does nothing and returns a default value.
+ */
+template<typename R, typename... Args>
+class Callback<R(Args...)> {
+public:
+    Callback(): invoke_(nullptr), manage_(nullptr) {}
+    Callback(std::nullptr_t): invoke_(nullptr), manage_(nullptr) {}
+
+    template<typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Callback>::value>::type>
+    Callback(F&& f): invoke_(nullptr), manage_(nullptr) {
+        assign(std::forward<F>(f));
+    }
+
+    Callback(const Callback& other): invoke_(nullptr), manage_(nullptr) { copyFrom(other); }
+    Callback& operator=(const Callback& other) {
+        if(this != &other) {
+            reset();
+            copyFrom(other);
+        }
+        return *this;
+    }
+    Callback& operator=(std::nullptr_t) { reset(); return *this; }
+    ~Callback() { reset(); }
+
+    R operator()(Args... args) const {
+        if(invoke_ == nullptr) return R();
+        return invoke_(storage_, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const { return invoke_ != nullptr; }
+    bool operator==(std::nullptr_t) const { return invoke_ == nullptr; }
+    bool operator!=(std::nullptr_t) const { return invoke_ != nullptr; }
+
+protected:
+    enum Op { OP_COPY, OP_DESTROY };
+    typedef R (*Invoker)(const void*, Args...);
+    typedef void (*Manager)(Op, void*, const void*);
+
+    template<typename F> static R invoke(const void* storage, Args... args) {
+        return (*static_cast<F*>(const_cast<void*>(storage)))(std::forward<Args>(args)...);
+    }
+    template<typename F> static void manage(Op op, void* dst, const void* src) {
+        if(op == OP_COPY) new(dst) F(*static_cast<const F*>(src));
+        else static_cast<F*>(dst)->~F();
+    }
+
+    template<typename F> void assign(F&& f) {
+        typedef typename std::decay<F>::type Fn;
+        static_assert(sizeof(Fn) <= BBR_CALLBACK_STORAGE, "Callable too large for Callback storage - capture less or by reference");
+        static_assert(alignof(Fn) <= alignof(Storage), "Callable alignment not supported by Callback");
+        if(isNull(f)) return;
+        new(storage_) Fn(std::forward<F>(f));
+        invoke_ = &invoke<Fn>;
+        // Trivial callables (function pointers, lambdas capturing pointers and references) are copied with memcpy
+        manage_ = (std::is_trivially_copyable<Fn>::value && std::is_trivially_destructible<Fn>::value) ? nullptr : &manage<Fn>;
+    }
+
+    // Only function pointers and std::function-like objects can be empty. Functions and lambdas (which convert to
+    // a function pointer that is never null) aren't compared, that would warn under -Wall.
+    template<typename F> struct MayBeNull: std::integral_constant<bool, std::is_pointer<F>::value ||
+        (std::is_class<F>::value && !std::is_convertible<F, R(*)(Args...)>::value)> {};
+
+    template<typename F> static bool isNull(const F& f) { return isNullImpl(f, MayBeNull<F>(), 0); }
+    template<typename F> static auto isNullImpl(const F& f, std::true_type, int) -> decltype(f == nullptr) { return f == nullptr; }
+    template<typename F> static bool isNullImpl(const F&, std::true_type, long) { return false; }
+    template<typename F> static bool isNullImpl(const F&, std::false_type, int) { return false; }
+
+    void copyFrom(const Callback& other) {
+        if(other.invoke_ == nullptr) return;
+        if(other.manage_ != nullptr) other.manage_(OP_COPY, storage_, other.storage_);
+        else memcpy(storage_, other.storage_, sizeof(storage_));
+        invoke_ = other.invoke_;
+        manage_ = other.manage_;
+    }
+
+    void reset() {
+        if(manage_ != nullptr) manage_(OP_DESTROY, storage_, nullptr);
+        invoke_ = nullptr;
+        manage_ = nullptr;
+    }
+
+    union Storage {
+        void* p;
+        void (*fp)();
+        long long ll;
+        double d;
+    };
+
+    Invoker invoke_;
+    Manager manage_;
+    alignas(Storage) unsigned char storage_[BBR_CALLBACK_STORAGE];
+};
+
+}; // rmt
+}; // bb
+
+#endif // BBRCALLBACK_H
@@ -0,0 +1,38 @@
+#include "BBRCompiledMix.h"
+
+using namespace bb;
+using namespace bb::rmt;
+
+static int32_t percentToQ16(int8_t percent) {
+    // round to nearest, away from zero
+    int32_t v = int32_t(percent) * 65536;
+    return (v >= 0) ? (v + 50) / 100 : (v - 50) / 100;
+}
+
+void CompiledInterpolator::compile(const Interpolator& interp, uint8_t bitDepth) {
+    base[0] = percentToQ16(interp.i0);
+    base[1] = percentToQ16(interp.i25);
+    base[2] = percentToQ16(interp.i50);
+    base[3] = percentToQ16(interp.i75);
+    base[4] = percentToQ16(interp.i100);
+
+    if(bitDepth == 0 || bitDepth > 16) {
+        scale = 0;
+        return;
+    }
+    uint32_t maxval = (uint32_t(1) << bitDepth) - 1;
+    // Round up, so that the maximum raw value reaches the end of the curve exactly.
+    scale = ((uint32_t(4) << SEGMENT_SHIFT) + maxval - 1) / maxval;
+}
+
+bool CompiledMix::compile(const AxisMix& mix, uint8_t bitDepth1, uint8_t bitDepth2) {
+    axis1 = mix.axis1;
+    axis2 = mix.axis2;
+    mixType = mix.mixType;
+    interp1.compile(mix.interp1, bitDepth1);
+    interp2.compile(mix.interp2, bitDepth2);
+
+    if(axis1 != AXIS_INVALID && interp1.scale == 0) return false;
+    if(axis2 != AXIS_INVALID && interp2.scale == 0) return false;
+    return true;
+}
@@ -0,0 +1,81 @@
+#if !defined(BBRCOMPILEDMIX_H)
+#define BBRCOMPILEDMIX_H
+
+#include "BBRTypes.h"
+
+namespace bb {
+namespace rmt {
+
+/**
+ * Fixed point form of an `Interpolator` for one axis bit depth.
+ *
+ * `AxisMix::compute()` works on floats and needs divisions and a four way branch per axis, which is slow
+ * on FPU-less receivers (SAMD21, AVR). A compiled interpolator takes the raw on-the-wire axis value
+ * instead: one integer multiply yields both the curve segment and the position within it, and the result
+ * is one more multiply-add. Values are Q16 fixed point (65536 == 1.0).
+ *
+ * We don't use a full table indexed by raw value -- that would be 2kB per 10 bit axis and input, more RAM
+ * than an AVR has in total.
+ */
+struct CompiledInterpolator {
+    static const uint8_t SEGMENT_SHIFT = 24; //!< raw * scale has the segment index in bits 24 and up.
+    static const uint8_t OFFSET_BITS = 12;   //!< Resolution of the position within a segment.
+
+    uint32_t scale;   //!< 4 * 2^24 / (2^bitDepth - 1) rounded up, or 0 for an axis that isn't used.
+    int32_t base[5];  //!< Curve values at 0, 25, 50, 75 and 100%, Q16.
+
+    //! Compile `interp` for an axis of the given bit depth (1..16).
+    void compile(const Interpolator& interp, uint8_t bitDepth);
+
+    //! Evaluate for the given raw axis value. Returns Q16.
+    inline int32_t evaluate(uint32_t raw) const {
+        uint32_t t = raw * scale;
+        uint32_t seg = t >> SEGMENT_SHIFT;
+        int32_t off = (t >> (SEGMENT_SHIFT - OFFSET_BITS)) & ((1 << OFFSET_BITS) - 1);
+        if(seg >= 4) { // the very top of the curve, or rounding just above it
+            seg = 3;
+            off = 1 << OFFSET_BITS;
+        }
+        return base[seg] + (((base[seg+1] - base[seg]) * off) >> OFFSET_BITS);
+    }
+};
+
+//! Fixed point form of an `AxisMix`, built by `MixManager::setMix()`. See `CompiledInterpolator`.
+struct CompiledMix {
+    CompiledInterpolator interp1, interp2;
+    AxisID axis1, axis2;
+    MixType mixType;
+
+    //! Compile `mix` for the given axis bit depths. Returns false if a used axis has bit depth 0 or > 16.
+    bool compile(const AxisMix& mix, uint8_t bitDepth1, uint8_t bitDepth2);
+
+    //! Same semantics as `AxisMix::compute()`, but on raw axis values. Returns Q16.
+    inline int32_t computeQ16(uint32_t raw1, uint32_t raw2) const {
+        if(axis1 == AXIS_INVALID) {
+            if(axis2 == AXIS_INVALID) return 0;
+            return interp2.evaluate(raw2);
+        }
+        int32_t b1 = interp1.evaluate(raw1);
+        if(axis2 == AXIS_INVALID) return b1;
+
+        switch(mixType) {
+        case MIX_ADD:
+            return b1 + interp2.evaluate(raw2);
+        case MIX_MULT:
+            return int32_t((int64_t(b1) * interp2.evaluate(raw2)) >> 16);
+        case MIX_NONE:
+        default:
+            return b1;
+        }
+    }
+
+    //! Same semantics as `AxisMix::compute()`, but on raw axis values.
+    inline float compute(uint32_t raw1, uint32_t raw2) const {
+        return float(computeQ16(raw1, raw2)) * (1.0f / 65536.0f);
+    }
+};
+
+}; // rmt
+}; // bb
+
+#endif // BBRCOMPILEDMIX_H
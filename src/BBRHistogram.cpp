@@ -0,0 +1,56 @@
+#include "BBRHistogram.h"
+#include "BBRUtils.h"
+
+using namespace bb;
+using namespace bb::rmt;
+
+static inline uint8_t bucketForValue(uint32_t value) {
+    if(value == 0) return 0;
+    uint8_t b = 32 - __builtin_clz(value);
+    if(b >= Histogram::NUM_BUCKETS) b = Histogram::NUM_BUCKETS-1;
+    return b;
+}
+
+void Histogram::reset() {
+    memset(buckets_, 0, sizeof(buckets_));
+    count_ = 0;
+    min_ = 0xffffffff;
+    max_ = 0;
+    sum_ = 0;
+}
+
+void Histogram::add(uint32_t value) {
+    buckets_[bucketForValue(value)]++;
+    count_++;
+    sum_ += value;
+    if(value < min_) min_ = value;
+    if(value > max_) max_ = value;
+}
+
+uint32_t Histogram::percentile(uint8_t pct) const {
+    if(count_ == 0) return 0;
+    if(pct > 100) pct = 100;
+
+    // Rank of the sample we're looking for, rounded up so that p100 is the last sample.
+    uint32_t rank = uint32_t((uint64_t(count_) * pct + 99) / 100);
+    if(rank == 0) rank = 1;
+
+    uint32_t seen = 0;
+    for(uint8_t b=0; b<NUM_BUCKETS; b++) {
+        seen += buckets_[b];
+        if(seen >= rank) {
+            uint32_t upper = b == 0 ? 0 : (b >= 32 ? 0xffffffff : uint32_t((uint64_t(1) << b) - 1));
+            return upper < max_ ? upper : max_;
+        }
+    }
+    return max_;
+}
+
+void Histogram::printInfo(const char* label, const char* unit) const {
+    if(count_ == 0) {
+        bb::rmt::printf("%s: no samples\n", label);
+        return;
+    }
+    bb::rmt::printf("%s: n=%u p50<=%u%s p99<=%u%s max=%u%s mean=%u%s\n", label,
+                    count_, percentile(50), unit, percentile(99), unit, max_, unit, mean(), unit);
+}
@@ -0,0 +1,51 @@
+#if !defined(BBRHISTOGRAM_H)
+#define BBRHISTOGRAM_H
+
+#include <Arduino.h>
+
+namespace bb {
+namespace rmt {
+
+//! Fixed-memory histogram with power-of-two buckets.
+/**
+ * Bucket 0 counts the value 0, bucket n counts values in [2^(n-1) .. 2^n - 1]. Percentiles are therefore
+ * only accurate to within a factor of two; they are reported as the upper edge of the bucket they fall into,
+ * clamped to the largest value seen. Count, min, max and mean are exact.
+ */
+class Histogram {
+public:
+    static const uint8_t NUM_BUCKETS = 32;
+
+    Histogram() { reset(); }
+
+    //! Clear all samples.
+    void reset();
+    //! Add a sample.
+    void add(uint32_t value);
+
+    //! Number of samples added since the last `reset()`.
+    uint32_t count() const { return count_; }
+    //! Smallest sample, or 0 if there are none.
+    uint32_t min() const { return count_ == 0 ? 0 : min_; }
+    //! Largest sample, or 0 if there are none.
+    uint32_t max() const { return max_; }
+    //! Arithmetic mean of all samples, or 0 if there are none.
+    uint32_t mean() const { return count_ == 0 ? 0 : uint32_t(sum_ / count_); }
+    //! Return the upper bound of the given percentile (0..100), see above.
+    uint32_t percentile(uint8_t pct) const;
+    //! Return the number of samples in the given bucket.
+    uint32_t bucket(uint8_t b) const { return b < NUM_BUCKETS ? buckets_[b] : 0; }
+
+    //! Print a one-line summary (count, p50, p99, max, mean) prefixed with `label`.
+    void printInfo(const char* label, const char* unit = "us") const;
+
+protected:
+    uint32_t buckets_[NUM_BUCKETS];
+    uint32_t count_, min_, max_;
+    uint64_t sum_;
+};
+
+}; // rmt
+}; // bb
+
+#endif // BBRHISTOGRAM_H
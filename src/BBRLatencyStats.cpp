@@ -0,0 +1,106 @@
+#include "BBRLatencyStats.h"
+#include "BBRUtils.h"
+
+#if defined(BBR_LATENCY_STATS)
+
+using namespace bb;
+using namespace bb::rmt;
+
+// Transmitted packets we may still see come in. The seqnum is only 3 bits wide, so 8 entries is all
+// that can be told apart anyway; entries older than MAX_MATCH_AGE_US are never matched.
+static const uint8_t NUM_PENDING = 8;
+static const unsigned long MAX_MATCH_AGE_US = 1000000;
+
+struct PendingPacket {
+    bool valid;
+    bool hasSetUS;
+    uint8_t source, seqnum;
+    unsigned long txUS, setUS;
+};
+
+static Histogram histograms_[LatencyStats::NUM_STAGES];
+static PendingPacket pending_[NUM_PENDING];
+static uint8_t pendingHead_ = 0;
+
+static bool inPacket_ = false;
+static bool inPacketHasSetUS_ = false;
+static unsigned long inPacketRxUS_ = 0;
+static unsigned long inPacketSetUS_ = 0;
+
+void LatencyStats::record(Stage stage, uint32_t us) {
+    if(stage >= NUM_STAGES) return;
+    histograms_[stage].add(us);
+}
+
+void LatencyStats::transmitted(uint8_t source, uint8_t seqnum, unsigned long txUS, bool hasSetUS, unsigned long setUS) {
+    PendingPacket& p = pending_[pendingHead_];
+    p.valid = true;
+    p.hasSetUS = hasSetUS;
+    p.source = source;
+    p.seqnum = seqnum;
+    p.txUS = txUS;
+    p.setUS = setUS;
+    pendingHead_ = (pendingHead_ + 1) % NUM_PENDING;
+}
+
+void LatencyStats::received(uint8_t source, uint8_t seqnum) {
+    unsigned long now = micros();
+    inPacket_ = true;
+    inPacketRxUS_ = now;
+    inPacketHasSetUS_ = false;
+
+    // Newest first, so a wrapped seqnum matches the latest packet that carried it.
+    for(uint8_t i=1; i<=NUM_PENDING; i++) {
+        PendingPacket& p = pending_[(pendingHead_ + NUM_PENDING - i) % NUM_PENDING];
+        if(!p.valid || p.source != source || p.seqnum != seqnum) continue;
+        p.valid = false;
+        if(now - p.txUS > MAX_MATCH_AGE_US) break;
+
+        histograms_[TRANSMIT_TO_RECEIVE].add(now - p.txUS);
+        inPacketHasSetUS_ = p.hasSetUS;
+        inPacketSetUS_ = p.setUS;
+        break;
+    }
+}
+
+void LatencyStats::callbackFired() {
+    if(!inPacket_) return;
+    unsigned long now = micros();
+    histograms_[RECEIVE_TO_CALLBACK].add(now - inPacketRxUS_);
+    if(inPacketHasSetUS_) histograms_[SET_TO_CALLBACK].add(now - inPacketSetUS_);
+}
+
+void LatencyStats::packetDone() {
+    inPacket_ = false;
+}
+
+const Histogram& LatencyStats::histogram(Stage stage) {
+    if(stage >= NUM_STAGES) stage = SET_TO_CALLBACK;
+    return histograms_[stage];
+}
+
+const char* LatencyStats::stageName(Stage stage) {
+    switch(stage) {
+    case SET_TO_TRANSMIT:     return "set->transmit";
+    case TRANSMIT_TO_RECEIVE: return "transmit->receive";
+    case RECEIVE_TO_CALLBACK: return "receive->callback";
+    case SET_TO_CALLBACK:     return "set->callback";
+    default:                  return "invalid";
+    }
+}
+
+void LatencyStats::reset() {
+    for(uint8_t i=0; i<NUM_STAGES; i++) histograms_[i].reset();
+    for(uint8_t i=0; i<NUM_PENDING; i++) pending_[i].valid = false;
+    inPacket_ = false;
+}
+
+void LatencyStats::printInfo() {
+    bb::rmt::printf("Latency stats:\n");
+    for(uint8_t i=0; i<NUM_STAGES; i++) {
+        std::string label = std::string("\t") + stageName(Stage(i));
+        histograms_[i].printInfo(label.c_str());
+    }
+}
+
+#endif // BBR_LATENCY_STATS
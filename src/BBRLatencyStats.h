@@ -0,0 +1,65 @@
+#if !defined(BBRLATENCYSTATS_H)
+#define BBRLATENCYSTATS_H
+
+#include "BBRHistogram.h"
+
+/**
+ * Stick-to-actuator latency instrumentation.
+ *
+ * Compiled in only if `BBR_LATENCY_STATS` is defined (eg. `build_flags = -DBBR_LATENCY_STATS` in platformio.ini).
+ * Without it, none of the hooks cost anything and this header declares nothing.
+ *
+ * The control path is stamped with `micros()` at four points:
+ *
+ * 1. The first `Transmitter::setRawAxisValue()` (and thus `setAxisValue()`) after the previous transmit.
+ * 2. `MTransmitter::transmit()` handing the packet to the protocol.
+ * 3. `MProtocol::incomingPacket()` seeing the packet.
+ * 4. `MReceiver` calling each input callback.
+ *
+ * Transmit and receive stamps are matched by packet source and seqnum. This only makes sense if both ends
+ * share a clock, ie. in the loopback protocol or with transmitter and receiver on the same MCU; on separate
+ * devices, the TRANSMIT_TO_RECEIVE and SET_TO_CALLBACK stages simply stay empty.
+ */
+
+#if defined(BBR_LATENCY_STATS)
+
+namespace bb {
+namespace rmt {
+
+class LatencyStats {
+public:
+    enum Stage {
+        SET_TO_TRANSMIT     = 0, //!< Axis set -> `transmit()`.
+        TRANSMIT_TO_RECEIVE = 1, //!< `transmit()` -> `incomingPacket()`. Needs a shared clock.
+        RECEIVE_TO_CALLBACK = 2, //!< `incomingPacket()` -> input callback.
+        SET_TO_CALLBACK     = 3, //!< Axis set -> input callback. Needs a shared clock.
+        NUM_STAGES          = 4
+    };
+
+    //! Record a sample for the given stage directly.
+    static void record(Stage stage, uint32_t us);
+    //! Called by the transmitter for each packet it hands to the protocol.
+    static void transmitted(uint8_t source, uint8_t seqnum, unsigned long txUS, bool hasSetUS, unsigned long setUS);
+    //! Called by the protocol when a control packet comes in.
+    static void received(uint8_t source, uint8_t seqnum);
+    //! Called by the receiver right before an input callback fires.
+    static void callbackFired();
+    //! Called by the receiver after all callbacks for the current packet have fired.
+    static void packetDone();
+
+    //! Return the histogram for the given stage.
+    static const Histogram& histogram(Stage stage);
+    //! Return a human readable name for the given stage.
+    static const char* stageName(Stage stage);
+    //! Clear all histograms and pending stamps.
+    static void reset();
+    //! Print p50/p99/max for all stages.
+    static void printInfo();
+};
+
+}; // rmt
+}; // bb
+
+#endif // BBR_LATENCY_STATS
+
+#endif // BBRLATENCYSTATS_H
@@ -0,0 +1,276 @@
+#include "BBRLog.h"
+
+using namespace bb;
+using namespace bb::rmt;
+
+// Compare-and-swap on 32 bit words, needed by the lock-free ring. Without it, reserving and taking out a slot
+// disables interrupts for a moment.
+#if defined(__GCC_ATOMIC_INT_LOCK_FREE) && __GCC_ATOMIC_INT_LOCK_FREE == 2 && __SIZEOF_INT__ == 4
+#define BBRLOG_LOCKFREE 1
+#endif
+
+bool Log::deferred_ = false;
+Log::Message* Log::ring_ = nullptr;
+uint32_t Log::mask_ = 0;
+uint32_t Log::enqueuePos_ = 0;
+uint32_t Log::dequeuePos_ = 0;
+uint32_t Log::dropped_ = 0;
+static uint32_t reportedDropped = 0;
+
+bool Log::setDeferred(bool onoff, uint16_t numMessages) {
+    if(onoff && ring_ == nullptr) {
+        uint32_t n = 2;
+        while(n < numMessages && n < 0x8000) n <<= 1;
+        ring_ = new Message[n];
+        if(ring_ == nullptr) return false;
+        for(uint32_t i=0; i<n; i++) ring_[i].sequence = i;
+        mask_ = n - 1;
+        enqueuePos_ = dequeuePos_ = 0;
+    }
+    if(!onoff && deferred_) {
+        deferred_ = false;
+        flush();
+    }
+    deferred_ = onoff;
+    return true;
+}
+
+// Bounded multi-producer queue after D. Vyukov: slot i is free for ring position p when its sequence is p, and
+// holds a complete message for p when its sequence is p+1.
+Log::Message* Log::reserve(uint32_t& pos) {
+    if(ring_ == nullptr) return nullptr;
+#if defined(BBRLOG_LOCKFREE)
+    pos = __atomic_load_n(&enqueuePos_, __ATOMIC_RELAXED);
+    while(true) {
+        Message* m = &ring_[pos & mask_];
+        int32_t diff = int32_t(__atomic_load_n(&m->sequence, __ATOMIC_ACQUIRE) - pos);
+        if(diff == 0) {
+            if(__atomic_compare_exchange_n(&enqueuePos_, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                return m;
+            }
+        } else if(diff < 0) {
+            __atomic_add_fetch(&dropped_, 1, __ATOMIC_RELAXED);
+            return nullptr;
+        } else {
+            pos = __atomic_load_n(&enqueuePos_, __ATOMIC_RELAXED);
+        }
+    }
+#else
+    Message* m = nullptr;
+    noInterrupts();
+    pos = enqueuePos_;
+    if(ring_[pos & mask_].sequence == pos) {
+        m = &ring_[pos & mask_];
+        enqueuePos_ = pos + 1;
+    } else {
+        dropped_++;
+    }
+    interrupts();
+    return m;
+#endif
+}
+
+bool Log::pop(char* buf, size_t size, Level* level) {
+    if(ring_ == nullptr) return false;
+    Message* m;
+    uint32_t pos;
+#if defined(BBRLOG_LOCKFREE)
+    pos = __atomic_load_n(&dequeuePos_, __ATOMIC_RELAXED);
+    while(true) {
+        m = &ring_[pos & mask_];
+        int32_t diff = int32_t(__atomic_load_n(&m->sequence, __ATOMIC_ACQUIRE) - (pos + 1));
+        if(diff == 0) {
+            if(__atomic_compare_exchange_n(&dequeuePos_, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if(diff < 0) {
+            return false;
+        } else {
+            pos = __atomic_load_n(&dequeuePos_, __ATOMIC_RELAXED);
+        }
+    }
+#else
+    noInterrupts();
+    pos = dequeuePos_;
+    m = &ring_[pos & mask_];
+    bool ready = m->sequence == pos + 1;
+    if(ready) dequeuePos_ = pos + 1;
+    interrupts();
+    if(!ready) return false;
+#endif
+
+    if(level != nullptr) *level = Level(m->level);
+    format(*m, buf, size);
+#if defined(BBRLOG_LOCKFREE)
+    __atomic_store_n(&m->sequence, pos + mask_ + 1, __ATOMIC_RELEASE);
+#else
+    noInterrupts();
+    m->sequence = pos + mask_ + 1;
+    interrupts();
+#endif
+    return true;
+}
+
+unsigned int Log::flush(unsigned int maxMessages) {
+    char buf[LINE_LENGTH];
+    unsigned int n = 0;
+    while((maxMessages == 0 || n < maxMessages) && pop(buf, sizeof(buf))) {
+        printfFinal(buf);
+        n++;
+    }
+    uint32_t d = dropped();
+    if(d != reportedDropped) {
+        bb::rmt::printf("(%lu log messages dropped)\n", (unsigned long)(d - reportedDropped));
+        reportedDropped = d;
+    }
+    return n;
+}
+
+void Log::put(Message& m, const char* s) {
+    m.types[m.nargs] = ARG_STRING;
+    if(s == nullptr) s = "(null)";
+    if(m.stringsUsed >= STRING_SPACE) {
+        m.values[m.nargs].s = STRING_SPACE - 1; // terminator of the last string
+        return;
+    }
+    m.values[m.nargs].s = m.stringsUsed;
+    char* dst = m.strings + m.stringsUsed;
+    size_t room = STRING_SPACE - m.stringsUsed - 1;
+    size_t len = strnlen(s, room);
+    memcpy(dst, s, len);
+    dst[len] = '\0';
+    m.stringsUsed += len + 1;
+}
+
+// Integer argument converted the way printf would have read it off the va_list, per length modifier.
+template<typename T> static T signedArg(T v, const char* length) {
+    if(!strcmp(length, "hh")) return (signed char)v;
+    if(!strcmp(length, "h")) return (short)v;
+    if(!strcmp(length, "l") || !strcmp(length, "z") || !strcmp(length, "t")) return (long)v;
+    if(!strcmp(length, "ll") || !strcmp(length, "j")) return v;
+    return (int)v;
+}
+
+template<typename T> static T unsignedArg(T v, const char* length) {
+    if(!strcmp(length, "hh")) return (unsigned char)v;
+    if(!strcmp(length, "h")) return (unsigned short)v;
+    if(!strcmp(length, "l") || !strcmp(length, "z") || !strcmp(length, "t")) return (unsigned long)v;
+    if(!strcmp(length, "ll") || !strcmp(length, "j")) return v;
+    return (unsigned int)v;
+}
+
+size_t Log::format(const Message& m, char* buf, size_t size) {
+    if(size == 0) return 0;
+    size_t out = 0;
+    uint8_t arg = 0;
+    const char* f = m.format;
+
+    // Integer argument of any width, for '*' and conversions that don't take it as is
+    auto integer = [](uint8_t type, const Message::Value& v) -> long long {
+        switch(type) {
+        case ARG_INT:   return v.i;
+        case ARG_UINT:  return (long long)v.u;
+        case ARG_LLONG: return v.ll;
+        default:        return (long long)v.ull;
+        }
+    };
+    auto isInteger = [](uint8_t type) {
+        return type == ARG_INT || type == ARG_UINT || type == ARG_LLONG || type == ARG_ULLONG;
+    };
+
+    // Appends snprintf output, cut off at the end of buf
+    auto advance = [&](int n) {
+        if(n < 0) return;
+        out += n;
+        if(out > size - 1) out = size - 1;
+    };
+
+    while(*f != '\0' && out < size - 1) {
+        if(*f != '%') {
+            buf[out++] = *f++;
+            continue;
+        }
+
+        // Rebuild the conversion spec with '*' resolved and the length modifier taken out
+        char spec[48], length[3] = "";
+        size_t sl = 0;
+        spec[sl++] = *f++;
+        while(*f != '\0' && strchr("-+ #0", *f) && sl < 8) spec[sl++] = *f++;
+        for(int part=0; part<2; part++) {
+            if(part == 1) {
+                if(*f != '.') break;
+                spec[sl++] = *f++;
+            }
+            if(*f == '*') {
+                f++;
+                long long v = 0;
+                if(arg < m.nargs && isInteger(m.types[arg])) v = integer(m.types[arg], m.values[arg]);
+                arg++;
+                sl += snprintf(spec + sl, sizeof(spec) - sl, "%d", (int)v);
+            } else {
+                while(*f >= '0' && *f <= '9' && sl < 16) spec[sl++] = *f++;
+            }
+        }
+        for(int i=0; i<2 && *f != '\0' && strchr("hljztL", *f); i++) {
+            if(i == 1 && *f != f[-1]) break; // only hh and ll are two characters
+            length[i] = *f++;
+            length[i+1] = '\0';
+        }
+        char conv = *f;
+        if(conv == '\0') break;
+        f++;
+
+        if(conv == '%') {
+            buf[out++] = '%';
+            continue;
+        }
+
+        bool have = arg < m.nargs;
+        uint8_t type = have ? m.types[arg] : 0;
+        const Message::Value* v = have ? &m.values[arg] : nullptr;
+        arg++;
+        char* dst = buf + out;
+        size_t room = size - out;
+
+        bool wide = type == ARG_LLONG || type == ARG_ULLONG;
+        if(strchr("di", conv) && have && isInteger(type) && !wide) {
+            strcpy(spec + sl, "ld");
+            spec[sl+1] = conv;
+            long val = type == ARG_INT ? v->i : (long)v->u;
+            advance(snprintf(dst, room, spec, signedArg(val, length)));
+        } else if(strchr("di", conv) && have && wide) {
+            strcpy(spec + sl, "lld");
+            spec[sl+2] = conv;
+            advance(snprintf(dst, room, spec, signedArg(integer(type, *v), length)));
+        } else if(strchr("uoxX", conv) && have && isInteger(type) && !wide) {
+            strcpy(spec + sl, "ld");
+            spec[sl+1] = conv;
+            unsigned long val = type == ARG_UINT ? v->u : (unsigned long)v->i;
+            advance(snprintf(dst, room, spec, unsignedArg(val, length)));
+        } else if(strchr("uoxX", conv) && have && wide) {
+            strcpy(spec + sl, "lld");
+            spec[sl+2] = conv;
+            unsigned long long val = type == ARG_ULLONG ? v->ull : (unsigned long long)v->ll;
+            advance(snprintf(dst, room, spec, unsignedArg(val, length)));
+        } else if(conv == 'c' && have && isInteger(type)) {
+            spec[sl] = 'c'; spec[sl+1] = '\0';
+            advance(snprintf(dst, room, spec, (int)integer(type, *v)));
+        } else if(strchr("fFeEgGaA", conv) && have && (type == ARG_DOUBLE || isInteger(type))) {
+            spec[sl] = conv; spec[sl+1] = '\0';
+            double val = type == ARG_DOUBLE ? v->d : type == ARG_ULLONG ? (double)v->ull :
+                         type == ARG_UINT ? (double)v->u : (double)integer(type, *v);
+            advance(snprintf(dst, room, spec, val));
+        } else if(conv == 's' && have && type == ARG_STRING) {
+            spec[sl] = 's'; spec[sl+1] = '\0';
+            advance(snprintf(dst, room, spec, m.strings + v->s));
+        } else if(conv == 'p' && have && type == ARG_POINTER) {
+            spec[sl] = 'p'; spec[sl+1] = '\0';
+            advance(snprintf(dst, room, spec, v->p));
+        } else {
+            buf[out++] = '?'; // missing argument, or one printf couldn't have taken either
+        }
+    }
+
+    buf[out] = '\0';
+    return out;
+}
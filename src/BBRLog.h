@@ -0,0 +1,171 @@
+#if !defined(BBRLOG_H)
+#define BBRLOG_H
+
+#include <Arduino.h>
+#include <type_traits>
+#include "BBRUtils.h"
+
+/**
+ * Log levels for `BBR_LOG_LEVEL`. Messages of a level above it are compiled out: no code, no format string in
+ * flash, and the arguments aren't evaluated. Define `BBR_LOG_LEVEL` for the whole build (eg. `-DBBR_LOG_LEVEL=1`
+ * in `build_flags`); it defaults to `BBR_LOG_LEVEL_INFO`.
+ */
+#define BBR_LOG_LEVEL_NONE  0
+#define BBR_LOG_LEVEL_ERROR 1
+#define BBR_LOG_LEVEL_WARN  2
+#define BBR_LOG_LEVEL_INFO  3
+#define BBR_LOG_LEVEL_DEBUG 4
+
+#if !defined(BBR_LOG_LEVEL)
+#define BBR_LOG_LEVEL BBR_LOG_LEVEL_INFO
+#endif
+
+// The dead printf-style call keeps the compiler's format checking
+#define BBR_LOG_AT(level, ...) do { \
+    if(false) bb::rmt::Log::checkFormat(__VA_ARGS__); \
+    bb::rmt::Log::log(level, __VA_ARGS__); \
+} while(0)
+
+#if BBR_LOG_LEVEL >= BBR_LOG_LEVEL_ERROR
+#define BBR_LOGE(...) BBR_LOG_AT(bb::rmt::Log::LEVEL_ERROR, __VA_ARGS__)
+#else
+#define BBR_LOGE(...) do {} while(0)
+#endif
+#if BBR_LOG_LEVEL >= BBR_LOG_LEVEL_WARN
+#define BBR_LOGW(...) BBR_LOG_AT(bb::rmt::Log::LEVEL_WARN, __VA_ARGS__)
+#else
+#define BBR_LOGW(...) do {} while(0)
+#endif
+#if BBR_LOG_LEVEL >= BBR_LOG_LEVEL_INFO
+#define BBR_LOGI(...) BBR_LOG_AT(bb::rmt::Log::LEVEL_INFO, __VA_ARGS__)
+#else
+#define BBR_LOGI(...) do {} while(0)
+#endif
+#if BBR_LOG_LEVEL >= BBR_LOG_LEVEL_DEBUG
+#define BBR_LOGD(...) BBR_LOG_AT(bb::rmt::Log::LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define BBR_LOGD(...) do {} while(0)
+#endif
+
+namespace bb {
+namespace rmt {
+
+/**
+ * Library logging, used through the `BBR_LOGE()` .. `BBR_LOGD()` macros with printf-style arguments.
+ *
+ * Messages are printed right away by default, like `bb::rmt::printf()`. After `setDeferred(true)` they go into a
+ * ring buffer instead, unformatted: the format string pointer, the raw argument values, and copies of string
+ * arguments (cut off if they don't fit). `flush()` formats and prints them later, eg. from the sketch's idle time,
+ * so a slow serial port doesn't hold up packet processing. Storing a message takes no lock and never blocks: any
+ * thread or task may log, and when the buffer is full the message is dropped and counted. Where the CPU has no
+ * compare-and-swap (eg. Cortex-M0+), storing briefly disables interrupts instead.
+ *
+ * Format strings must be string literals or otherwise live forever. `%n` isn't supported.
+ */
+class Log {
+public:
+    enum Level {
+        LEVEL_ERROR = BBR_LOG_LEVEL_ERROR,
+        LEVEL_WARN  = BBR_LOG_LEVEL_WARN,
+        LEVEL_INFO  = BBR_LOG_LEVEL_INFO,
+        LEVEL_DEBUG = BBR_LOG_LEVEL_DEBUG
+    };
+
+    static const uint8_t MAX_ARGS = 6;       //!< More arguments are printed as "?"
+    static const uint8_t STRING_SPACE = 48;  //!< Room for string arguments per message, terminators included
+    static const uint16_t LINE_LENGTH = 256; //!< Longer messages are cut off when printed
+
+    /**
+     * Store messages and print them from `flush()`, or print them right away (the default). The buffer holds
+     * `numMessages` (rounded up to a power of 2) and is allocated on the first call. Call from setup, before
+     * anything logs.
+     */
+    static bool setDeferred(bool onoff, uint16_t numMessages = 32);
+    static bool deferred() { return deferred_; }
+
+    //! Print up to `maxMessages` stored messages (all if 0), oldest first. Returns the number printed.
+    static unsigned int flush(unsigned int maxMessages = 0);
+    //! Format the oldest stored message into `buf` and remove it. False if there is none.
+    static bool pop(char* buf, size_t size, Level* level = nullptr);
+    //! Messages dropped because the buffer was full.
+    static uint32_t dropped() { return __atomic_load_n(&dropped_, __ATOMIC_RELAXED); }
+
+    template<typename... Args> static void log(Level level, const char* format, Args... args) {
+        if(!deferred_) {
+            bb::rmt::printf(format, args...);
+            return;
+        }
+        uint32_t pos;
+        Message* m = reserve(pos);
+        if(m == nullptr) return;
+        m->format = format;
+        m->level = level;
+        m->nargs = 0;
+        m->stringsUsed = 0;
+        store(*m, args...);
+        commit(m, pos);
+    }
+
+    __attribute__((format(printf, 1, 2))) static void checkFormat(const char*, ...) {}
+
+protected:
+    // Integers are stored as long, and printed with %ld, unless they are wider: newlib-nano can't print long long
+    enum ArgType { ARG_INT, ARG_UINT, ARG_LLONG, ARG_ULLONG, ARG_DOUBLE, ARG_POINTER, ARG_STRING };
+
+    struct Message {
+        uint32_t sequence; // ring position this slot is ready for, see reserve()
+        const char* format;
+        uint8_t level, nargs, stringsUsed;
+        uint8_t types[MAX_ARGS];
+        union Value {
+            long i;
+            unsigned long u;
+            long long ll;
+            unsigned long long ull;
+            double d;
+            const void* p;
+            uint8_t s; // offset into strings
+        } values[MAX_ARGS];
+        char strings[STRING_SPACE];
+    };
+
+    static Message* reserve(uint32_t& pos);
+    static void commit(Message* m, uint32_t pos) { __atomic_store_n(&m->sequence, pos + 1, __ATOMIC_RELEASE); }
+    static size_t format(const Message& m, char* buf, size_t size);
+
+    static void store(Message&) {}
+    template<typename T, typename... Rest> static void store(Message& m, T first, Rest... rest) {
+        if(m.nargs < MAX_ARGS) {
+            put(m, first);
+            m.nargs++;
+        }
+        store(m, rest...);
+    }
+
+    template<typename T> static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    put(Message& m, T v) {
+        if(sizeof(T) > sizeof(long)) { m.types[m.nargs] = ARG_LLONG; m.values[m.nargs].ll = v; }
+        else { m.types[m.nargs] = ARG_INT; m.values[m.nargs].i = long(v); }
+    }
+    template<typename T> static typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+    put(Message& m, T v) {
+        if(sizeof(T) > sizeof(long)) { m.types[m.nargs] = ARG_ULLONG; m.values[m.nargs].ull = v; }
+        else { m.types[m.nargs] = ARG_UINT; m.values[m.nargs].u = (unsigned long)v; }
+    }
+    template<typename T> static typename std::enable_if<std::is_enum<T>::value>::type
+    put(Message& m, T v) { m.types[m.nargs] = ARG_INT; m.values[m.nargs].i = long(v); }
+    template<typename T> static typename std::enable_if<std::is_floating_point<T>::value>::type
+    put(Message& m, T v) { m.types[m.nargs] = ARG_DOUBLE; m.values[m.nargs].d = v; }
+    template<typename T> static void put(Message& m, const T* p) { m.types[m.nargs] = ARG_POINTER; m.values[m.nargs].p = p; }
+    static void put(Message& m, const char* s);
+    static void put(Message& m, char* s) { put(m, (const char*)s); }
+
+    static bool deferred_;
+    static Message* ring_;
+    static uint32_t mask_, enqueuePos_, dequeuePos_, dropped_;
+};
+
+}; // rmt
+}; // bb
+
+#endif // BBRLOG_H
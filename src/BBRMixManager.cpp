@@ -1,6 +1,7 @@
 #include "BBRMixManager.h"
 #include "BBRTypes.h"
 #include "BBRUtils.h"
+#include <string.h>
 
 using namespace bb;
 using namespace bb::rmt;
@@ -8,43 +9,79 @@ using namespace bb::rmt;
 static AxisMix InvalidMix;
 const MixManager MixManager::InvalidManager;
 
-uint8_t MixManager::numMixes() const { 
-    return mixes_.size(); 
+// Shared by all managers, so that a version number identifies one set of mixes even across copies.
+static uint32_t nextVersion_ = 1;
+
+MixManager::MixManager() {
+    memset(present_, 0, sizeof(present_));
+    memset(compiled_, 0, sizeof(compiled_));
+    version_ = nextVersion_++;
+}
+
+void MixManager::bumpVersion() {
+    version_ = nextVersion_++;
 }
 
-const std::map<InputID,AxisMix>& MixManager::mixes() {
-    return mixes_;
+uint8_t MixManager::numMixes() const { 
+    return mixInputs_.size(); 
 }
 
 const AxisMix& MixManager::mixForInput(InputID input) const { 
-    for(auto& mix: mixes_) {
-        if(mix.first == input) return mix.second;
-    }
-    return InvalidMix;
+    if(!testBit(present_, input)) return InvalidMix;
+    return mixes_[indexForInput(input)];
+}
+
+const AxisMix& MixManager::mixAtIndex(uint8_t index) const {
+    if(index >= mixes_.size()) return InvalidMix;
+    return mixes_[index];
 }
 
 bool MixManager::setMix(InputID input, const AxisMix& mix) { 
     if(input == INPUT_INVALID) return false;
-    mixes_[input] = mix;
+
+    uint8_t index = indexForInput(input);
+    if(!testBit(present_, input)) {
+        mixInputs_.insert(mixInputs_.begin() + index, input);
+        mixes_.insert(mixes_.begin() + index, mix);
+        compiledMixes_.insert(compiledMixes_.begin() + index, CompiledMix());
+        present_[input >> 5] |= uint32_t(1) << (input & 31);
+    } else {
+        mixes_[index] = mix;
+    }
+
+    if(compiledMixes_[index].compile(mix, bitDepthForAxis(mix.axis1), bitDepthForAxis(mix.axis2))) {
+        compiled_[input >> 5] |= uint32_t(1) << (input & 31);
+    } else {
+        compiled_[input >> 5] &= ~(uint32_t(1) << (input & 31));
+    }
+
+    bumpVersion();
     return true;
 }
 
 void MixManager::clearMixes() { 
+    memset(present_, 0, sizeof(present_));
+    memset(compiled_, 0, sizeof(compiled_));
+    mixInputs_.clear();
     mixes_.clear(); 
+    compiledMixes_.clear();
+    bumpVersion();
+}
+
+const CompiledMix* MixManager::compiledMixForInput(InputID input) const {
+    if(!testBit(compiled_, input)) return nullptr;
+    return &compiledMixes_[indexForInput(input)];
 }
 
 bool MixManager::hasMixForInput(InputID input) const {
-    for(auto& mix: mixes_) {
-        if(mix.first == input) return true;
-    }
-    return false;
+    return testBit(present_, input);
 }
 
 void MixManager::printDescription() const {
     bb::rmt::printf("%d mixes\n", mixes_.size());
-    for(auto& mix: mixes_) {
-        bb::rmt::printf("Input %d: ", mix.first);
-        const AxisMix& m = mix.second;
+    for(uint8_t i=0; i<mixes_.size(); i++) {
+        bb::rmt::printf("Input %d: ", mixInputs_[i]);
+        const AxisMix& m = mixes_[i];
         if(m.axis1 == AXIS_INVALID) bb::rmt::printf("\tAxis 1: INVALID\n");
         else {
             bb::rmt::printf("\tAxis 1: %d ", m.axis1);
@@ -2,28 +2,66 @@
 #define BBRAXISINPUTMANAGER_H
 
 #include "BBRTypes.h"
-#include <map>
+#include "BBRCompiledMix.h"
+#include <vector>
 
 namespace bb {
 namespace rmt {
 
 /**
  * Mix Manager class -- handles mixes and computes values.
+ *
+ * Mixes are stored densely: a bitmap tells which inputs have a mix, and the mixes themselves are packed in
+ * input order, so looking one up is a rank computation over the bitmap instead of a search. Every change bumps
+ * `version()`, so users can cache anything derived from the mixes and rebuild only when the version changes.
  */
 class MixManager {
 public:
     static const MixManager InvalidManager;
 
+    MixManager();
+
     virtual uint8_t numMixes() const;
-    const std::map<InputID,AxisMix>& mixes();
     virtual bool hasMixForInput(InputID input) const;
-    virtual const AxisMix& mixForInput(uint8_t index) const;
+    virtual const AxisMix& mixForInput(InputID input) const;
     virtual bool setMix(InputID input, const AxisMix& mix);
     virtual void clearMixes();
     virtual void printDescription() const;
 
+    //! Input of the `index`th mix, in ascending input order (0 <= index < numMixes()).
+    InputID inputForMixIndex(uint8_t index) const { return index < mixInputs_.size() ? mixInputs_[index] : INPUT_INVALID; }
+    //! The `index`th mix, in ascending input order (0 <= index < numMixes()).
+    const AxisMix& mixAtIndex(uint8_t index) const;
+
+    //! Changes whenever a mix is set or the mixes are cleared. Never the same for two different sets of mixes.
+    uint32_t version() const { return version_; }
+
+    //! Return the fixed point form of the mix for the given input, or nullptr if it could not be compiled.
+    virtual const CompiledMix* compiledMixForInput(InputID input) const;
+    //! Return the bit depth of the given on-the-wire axis. 0 (the default) means unknown, and mixes won't be compiled.
+    virtual uint8_t bitDepthForAxis(AxisID axis) const { return 0; }
+
 protected:
-    std::map<InputID,AxisMix> mixes_;
+    static const uint8_t BITMAP_WORDS = 256/32;
+
+    //! Index into the packed arrays for the given input. Only meaningful if the input has a mix.
+    inline uint8_t indexForInput(InputID input) const {
+        uint8_t word = input >> 5;
+        uint8_t rank = 0;
+        for(uint8_t i=0; i<word; i++) rank += __builtin_popcount(present_[i]);
+        return rank + __builtin_popcount(present_[word] & ((uint32_t(1) << (input & 31)) - 1));
+    }
+    inline bool testBit(const uint32_t* bitmap, InputID input) const {
+        return (bitmap[input >> 5] >> (input & 31)) & 1;
+    }
+    void bumpVersion();
+
+    uint32_t present_[BITMAP_WORDS];   //!< One bit per input that has a mix.
+    uint32_t compiled_[BITMAP_WORDS];  //!< One bit per input whose mix could be compiled.
+    std::vector<InputID> mixInputs_;   //!< Inputs that have a mix, ascending.
+    std::vector<AxisMix> mixes_;       //!< Parallel to mixInputs_.
+    std::vector<CompiledMix> compiledMixes_; //!< Parallel to mixInputs_, valid where compiled_ is set.
+    uint32_t version_;
 };
 
 }; // rmt
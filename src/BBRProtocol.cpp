@@ -19,6 +19,12 @@ void Protocol::setTransmitFrequencyHz(uint8_t transmitFrequencyHz) {
 }
 
 Protocol::Protocol(): commTimeoutWD_(nullptr), telemReceivedCB_(nullptr), commTimeoutWDCalled_(false) {
+    commTimeoutSeconds_ = 0;
+    lastCommHappenedMS_ = millis();
+    usLastTransmit_ = micros();
+    builderId_ = stationId_ = stationDetail_ = 0;
+    seqnum_ = 0;
+    memset(&stats_, 0, sizeof(stats_));
 }
 
 Protocol::~Protocol() {
@@ -57,11 +63,12 @@ bool Protocol::serialize(StorageBlock& block) {
     }
     
     int mixmapping = 0;
-    for(auto pair1: mixManagers_) {
-        for(auto pair2: pair1.second.mixes()) {
+    for(auto& pair1: mixManagers_) {
+        const MixManager& mgr = pair1.second;
+        for(uint8_t i=0; i<mgr.numMixes(); i++) {
             block.mapping[mixmapping].addr = pair1.first;
-            block.mapping[mixmapping].input = pair2.first;
-            block.mapping[mixmapping].mix = pair2.second;
+            block.mapping[mixmapping].input = mgr.inputForMixIndex(i);
+            block.mapping[mixmapping].mix = mgr.mixAtIndex(i);
             mixmapping++;
             if(mixmapping >= StorageBlock::MAX_NUM_MAPPINGS) {
                 printf("Warning: Can only store %d mix mappings due to memory limitation\n", 
@@ -166,6 +173,7 @@ bool Protocol::rePairWithConnected(bool receivers, bool transmitters, bool confi
 
     
 bool Protocol::step() {
+    BBR_PROFILE_STEP();
     //if(protocolType() == DROIDDEPOT_BLE) ::rmt::printf("step() in %c\n", protocolType());
 
     float secondsSinceLastComm = float(WRAPPEDDIFF(millis(), lastCommHappenedMS_, ULONG_MAX)) / 1000.0f;
@@ -173,19 +181,24 @@ bool Protocol::step() {
         if(commTimeoutWD_ != nullptr && commTimeoutWDCalled_ == false) {
             commTimeoutWD_(this, secondsSinceLastComm);
             commTimeoutWDCalled_ = true;
+            commTimedOut();
         }
     } else {
         commTimeoutWDCalled_ = false;
     }
 
     bool retval = true;
-    if(WRAPPEDDIFF(micros(), usLastTransmit_, ULONG_MAX) > transmitUSGap_) {
-        if(transmitter_ != nullptr) {
-            //if(protocolType() == DROIDDEPOT_BLE) bb::rmt::printf("transmitting in %c\n", protocolType());
-            if(transmitter_->transmit() == false) retval = false;
-            usLastTransmit_ = micros();
-        } 
-    } 
+    if(transmitter_ != nullptr && transmitter_->transmitDue(WRAPPEDDIFF(micros(), usLastTransmit_, ULONG_MAX), transmitUSGap_)) {
+        //if(protocolType() == DROIDDEPOT_BLE) bb::rmt::printf("transmitting in %c\n", protocolType());
+#if defined(BBR_STEP_PROFILER)
+        // Jitter is only meaningful for a fixed transmit rate
+        if(transmitter_->transmitPolicy() == Transmitter::TRANSMIT_PERIODIC) stepProfiler_.transmitStarted(transmitUSGap_);
+#endif
+        BBR_PROFILE_PHASE(PHASE_TRANSMIT);
+        if(transmitter_->transmit() == false) retval = false;
+        transmitter_->transmitted();
+        usLastTransmit_ = micros();
+    }
 
     return retval;
 }
@@ -205,7 +218,7 @@ bool Protocol::sendTelemetry(const NodeAddr& configuratorAddr, const Telemetry&
     return false;
 }
 
-void Protocol::setTelemetryReceivedCB(std::function<void(Protocol*, const NodeAddr&, uint8_t, const Telemetry&)> cb) {
+void Protocol::setTelemetryReceivedCB(Callback<void(Protocol*, const NodeAddr&, uint8_t, const Telemetry&)> cb) {
     telemReceivedCB_ = cb;
 }
 
@@ -276,11 +289,11 @@ bool Protocol::sendMixes() {
     return true;
 }
 
-void Protocol::addDestroyCB(std::function<void(Protocol*)> fn) {
+void Protocol::addDestroyCB(Callback<void(Protocol*)> fn) {
     destroyCBs_.push_back(fn);
 }
 
-void Protocol::setPairingCallback(std::function<void(Protocol*,const NodeDescription&)> fn) {
+void Protocol::setPairingCallback(Callback<void(Protocol*,const NodeDescription&)> fn) {
     pairingCB_ = fn;
 }
 
@@ -318,13 +331,107 @@ void Protocol::printInfo() {;
     bb::rmt::printf("This protocol has %d inputs and %d mix managers.\n", inputs_.size(), mixManagers_.size());
     bb::rmt::printf("This protocol has %d registered destroy callbacks.\n", destroyCBs_.size());
     bb::rmt::printf("This protocol is stored as \"%s\".\n", storageName_.c_str());
+    printStats();
+#if defined(BBR_STEP_PROFILER)
+    stepProfiler_.printInfo();
+#endif
+#if defined(BBR_LATENCY_STATS)
+    LatencyStats::printInfo();
+#endif
 }
 
-void Protocol::setCommTimeoutWatchdog(float seconds, std::function<void(Protocol*,float)> commTimeoutWD) {
+NodeStats Protocol::nodeStats(const NodeAddr& addr) {
+    auto it = nodeStats_.find(addr);
+    if(it == nodeStats_.end()) {
+        NodeStats empty;
+        memset(&empty, 0, sizeof(empty));
+        return empty;
+    }
+    return it->second;
+}
+
+void Protocol::resetStats() {
+    uint32_t queueDepth = stats_.queueDepth; // this is a level, not a count
+    memset(&stats_, 0, sizeof(stats_));
+    stats_.queueDepth = stats_.queueHighWater = queueDepth;
+    nodeStats_.clear();
+}
+
+void Protocol::countSent(const NodeAddr& addr, bool success) {
+    if(success) stats_.packetsSent++;
+    else stats_.sendErrors++;
+
+    if(!isPaired(addr)) return;
+    NodeStats& ns = nodeStats_[addr]; // value-initialized on first use
+    if(success) ns.packetsSent++;
+    else ns.sendErrors++;
+}
+
+void Protocol::countReceived(const NodeAddr& addr, uint8_t type) {
+    stats_.packetsReceived++;
+    if(type < sizeof(stats_.packetsByType)/sizeof(stats_.packetsByType[0])) stats_.packetsByType[type]++;
+
+    if(!isPaired(addr)) return;
+    NodeStats& ns = nodeStats_[addr];
+    ns.packetsReceived++;
+    ns.lastReceivedMS = millis();
+}
+
+void Protocol::countSequence(const NodeAddr& addr, SequenceTracker::Result result, const SequenceTracker::Loss& loss) {
+    stats_.packetsLost += loss.lost;
+    if(result == SequenceTracker::SEQ_DUPLICATE) stats_.duplicates++;
+    else if(result == SequenceTracker::SEQ_LATE) stats_.reordered++;
+
+    if(!isPaired(addr)) return;
+    NodeStats& ns = nodeStats_[addr];
+    ns.packetsSequenced++;
+    ns.packetsLost += loss.lost;
+    ns.lossBursts += loss.bursts;
+    if(loss.longestBurst > ns.maxLossBurst) ns.maxLossBurst = loss.longestBurst;
+    if(result == SequenceTracker::SEQ_DUPLICATE) ns.duplicates++;
+    else if(result == SequenceTracker::SEQ_LATE) ns.reordered++;
+}
+
+void Protocol::countRecovered(const NodeAddr& addr) {
+    stats_.packetsRecovered++;
+    if(!isPaired(addr)) return;
+    nodeStats_[addr].packetsRecovered++;
+}
+
+void Protocol::printStats() {
+    ProtocolStats s = stats();
+    bb::rmt::printf("Stats: %lu sent, %lu send errors, %lu delivery failures\n", 
+        (unsigned long)s.packetsSent, (unsigned long)s.sendErrors, (unsigned long)s.deliveryFailures);
+    bb::rmt::printf("\t%lu received (%lu/%lu/%lu/%lu by type), %lu dropped\n", (unsigned long)s.packetsReceived, 
+        (unsigned long)s.packetsByType[0], (unsigned long)s.packetsByType[1], 
+        (unsigned long)s.packetsByType[2], (unsigned long)s.packetsByType[3], (unsigned long)s.packetsDropped);
+    bb::rmt::printf("\t%lu CRC errors, %lu size errors, %lu framing errors, %lu garbage bytes\n",
+        (unsigned long)s.crcErrors, (unsigned long)s.sizeErrors, (unsigned long)s.framingErrors, (unsigned long)s.garbageBytes);
+    bb::rmt::printf("\tQueue depth %lu, high water %lu\n", (unsigned long)s.queueDepth, (unsigned long)s.queueHighWater);
+    bb::rmt::printf("\t%lu lost, %lu recovered, %lu duplicates, %lu reordered\n", (unsigned long)s.packetsLost, 
+        (unsigned long)s.packetsRecovered, (unsigned long)s.duplicates, (unsigned long)s.reordered);
+    for(auto& nd: pairedNodes_) {
+        NodeStats ns = nodeStats(nd.addr);
+        bb::rmt::printf("\t%s: %lu sent, %lu send errors, %lu received, last %lums ago\n", nd.addr.toString().c_str(),
+            (unsigned long)ns.packetsSent, (unsigned long)ns.sendErrors, (unsigned long)ns.packetsReceived,
+            ns.packetsReceived ? (unsigned long)(millis() - ns.lastReceivedMS) : 0UL);
+        if(ns.packetsSequenced == 0) continue;
+        bb::rmt::printf("\t\t%.1f%% lost, %lu lost in %lu bursts (max %u), %lu recovered, %lu duplicates, %lu reordered\n",
+            100.0f * ns.lossRate(), (unsigned long)ns.packetsLost, (unsigned long)ns.lossBursts, (unsigned)ns.maxLossBurst, 
+            (unsigned long)ns.packetsRecovered, (unsigned long)ns.duplicates, (unsigned long)ns.reordered);
+    }
+}
+
+void Protocol::setCommTimeoutWatchdog(float seconds, Callback<void(Protocol*,float)> commTimeoutWD) {
     commTimeoutWD_ = commTimeoutWD;
     commTimeoutSeconds_ = seconds;
 }
 
+void Protocol::commTimedOut() {
+    // The watchdog probably stopped things, so bring every input up to date once comms come back
+    if(receiver_ != nullptr) receiver_->forgetDeliveredValues();
+}
+
 void Protocol::commHappened() {
     lastCommHappenedMS_ = millis();
 }
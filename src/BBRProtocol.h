@@ -4,11 +4,14 @@
 #include <sys/types.h>
 #include <string>
 #include <vector>
+#include <map>
 
 #include "BBRTransmitter.h"
 #include "BBRReceiver.h"
 #include "BBRMixManager.h"
 #include "BBRTypes.h"
+#include "BBRStepProfiler.h"
+#include "BBRSequenceTracker.h"
 
 namespace bb {
 namespace rmt {
@@ -185,20 +188,44 @@ public:
      */
     virtual bool sendTelemetry(const Telemetry& telem);
     virtual bool sendTelemetry(const NodeAddr& configuratorAddr, const Telemetry& telem);
-    virtual void setTelemetryReceivedCB(std::function<void(Protocol*, const NodeAddr&, uint8_t seqnum, const Telemetry&)>);
+    virtual void setTelemetryReceivedCB(Callback<void(Protocol*, const NodeAddr&, uint8_t seqnum, const Telemetry&)>);
     virtual void telemetryReceived(const NodeAddr& source, uint8_t seqnum, const Telemetry& telem);
     /**
      * @}
      */
 
     //! Register a watchdog to be called if communication has timed out.
-    virtual void setCommTimeoutWatchdog(float seconds, std::function<void(Protocol*,float)> commTimeoutWD);
+    virtual void setCommTimeoutWatchdog(float seconds, Callback<void(Protocol*,float)> commTimeoutWD);
 
     //! Register a callback this protocol will call as it's being destroyed.
-    virtual void addDestroyCB(std::function<void(Protocol*)> fn);
+    virtual void addDestroyCB(Callback<void(Protocol*)> fn);
 
     //! Register a callback this protocol will call when a node gets paired.
-    virtual void setPairingCallback(std::function<void(Protocol*,const NodeDescription&)> fn);
+    virtual void setPairingCallback(Callback<void(Protocol*,const NodeDescription&)> fn);
+
+    /**
+     * @defgroup statistics Runtime statistics
+     * @{
+     * 
+     * Every protocol keeps a block of counters (see `ProtocolStats`) on link health and throughput, and a smaller
+     * one per paired node. Both are cheap enough to always be on.
+     */
+    //! Return a snapshot of the protocol's counters.
+    virtual ProtocolStats stats() { return stats_; }
+    //! Return a snapshot of the counters for the given paired node. All zero if nothing has been exchanged with it.
+    virtual NodeStats nodeStats(const NodeAddr& addr);
+    //! Zero all counters.
+    virtual void resetStats();
+    //! Print all counters.
+    virtual void printStats();
+    /**
+     * @}
+     */
+
+#if defined(BBR_STEP_PROFILER)
+    //! Return the `step()` profiler. Only available if compiled with `BBR_STEP_PROFILER`.
+    StepProfiler& stepProfiler() { return stepProfiler_; }
+#endif
 
     //! Print protocol info.
     virtual void printInfo();
@@ -216,6 +243,17 @@ public:
 protected:
     virtual bool connect(const NodeAddr& addr) { return false; }
     virtual void commHappened();
+    //! Called once when the comm timeout watchdog fires, after the watchdog callback.
+    virtual void commTimedOut();
+
+    //! Count a packet sent to `addr`. Call from the subclass's send function, from `step()` context only.
+    void countSent(const NodeAddr& addr, bool success);
+    //! Count a valid packet of protocol specific type `type` received from `addr`. `step()` context only.
+    void countReceived(const NodeAddr& addr, uint8_t type);
+    //! Count the outcome of a `SequenceTracker::track()` call for a packet from `addr`. `step()` context only.
+    void countSequence(const NodeAddr& addr, SequenceTracker::Result result, const SequenceTracker::Loss& loss);
+    //! Count a lost packet from `addr` whose content was recovered by forward error correction. `step()` context only.
+    void countRecovered(const NodeAddr& addr);
 
     std::vector<NodeDescription> discoveredNodes_;
     std::vector<NodeDescription> pairedNodes_;
@@ -226,11 +264,11 @@ protected:
 
     std::map<NodeAddr,std::vector<std::string>> inputs_;
     std::map<NodeAddr,MixManager> mixManagers_;
-    std::vector<std::function<void(Protocol*)>> destroyCBs_;
-    std::function<void(Protocol*,const NodeDescription&)> pairingCB_;
+    std::vector<Callback<void(Protocol*)>> destroyCBs_;
+    Callback<void(Protocol*,const NodeDescription&)> pairingCB_;
 
-    std::function<void(Protocol*,float)> commTimeoutWD_;
-    std::function<void(Protocol*, const NodeAddr&, uint8_t seqnum, const Telemetry&)> telemReceivedCB_;
+    Callback<void(Protocol*,float)> commTimeoutWD_;
+    Callback<void(Protocol*, const NodeAddr&, uint8_t seqnum, const Telemetry&)> telemReceivedCB_;
     float commTimeoutSeconds_;
     unsigned long lastCommHappenedMS_;
     unsigned long usLastTransmit_;
@@ -240,6 +278,13 @@ protected:
     uint8_t builderId_, stationId_, stationDetail_;
 
     uint8_t seqnum_;
+
+    ProtocolStats stats_;
+    std::map<NodeAddr,NodeStats> nodeStats_; // only ever touched from step() context
+
+#if defined(BBR_STEP_PROFILER)
+    StepProfiler stepProfiler_;
+#endif
 };
 
 };
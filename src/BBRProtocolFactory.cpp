@@ -11,18 +11,18 @@ using namespace rmt;
 bool dummyReadFn(ProtocolStorage& storage) { return false; }
 bool dummyWriteFn(const ProtocolStorage& storage) { return false; }
 
-static std::function<bool(ProtocolStorage&)> readFn_ = dummyReadFn;
-static std::function<bool(const ProtocolStorage&)> writeFn_ = dummyWriteFn;
-static std::vector<std::function<void(Protocol*)>> newProtoCBs_;
+static Callback<bool(ProtocolStorage&)> readFn_ = dummyReadFn;
+static Callback<bool(const ProtocolStorage&)> writeFn_ = dummyWriteFn;
+static std::vector<Callback<bool(Protocol*)>> newProtoCBs_;
 static ProtocolStorage storage_;
 static bool needsRead_ = true;
 static std::map<ProtocolType, Protocol*> protocols_;
 
-void ProtocolFactory::setMemoryReadFunction(std::function<bool(ProtocolStorage&)> readFn) {
+void ProtocolFactory::setMemoryReadFunction(Callback<bool(ProtocolStorage&)> readFn) {
     readFn_ = readFn;
 }
 
-void ProtocolFactory::setMemoryWriteFunction(std::function<bool(const ProtocolStorage&)> writeFn) {
+void ProtocolFactory::setMemoryWriteFunction(Callback<bool(const ProtocolStorage&)> writeFn) {
     writeFn_ = writeFn;
 }
 
@@ -63,6 +63,11 @@ Protocol* ProtocolFactory::getOrCreateProtocol(ProtocolType type) {
 #endif
         break;
         
+    case MONACO_LOOPBACK:
+        printf("Error creating Protocol: MONACO_LOOPBACK needs a medium, create it directly\n");
+        return nullptr;
+        break;
+
     case SPEKTRUM_DSSS:
         printf("Error creating Protocol: SPEKTRUM_DSSS protocol not yet implemented\n");
         return nullptr;
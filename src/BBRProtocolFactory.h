@@ -29,10 +29,10 @@ public:
 
     static void printStorage();
 
-    static void setMemoryReadFunction(std::function<bool(ProtocolStorage&)> readFn);
-    static void setMemoryWriteFunction(std::function<bool(const ProtocolStorage&)> writeFn);
+    static void setMemoryReadFunction(Callback<bool(ProtocolStorage&)> readFn);
+    static void setMemoryWriteFunction(Callback<bool(const ProtocolStorage&)> writeFn);
 
-    static void addNewProtocolCB(std::function<bool(Protocol*)> newProtoFn);
+    static void addNewProtocolCB(Callback<bool(Protocol*)> newProtoFn);
 };
 
 }; // rmt
@@ -9,18 +9,38 @@ uint8_t Receiver::numInputs(){
     return inputs_.size();
 }
 
-InputID Receiver::addInput(const std::string& name, std::function<void(float)> callback) {
+InputID Receiver::addInput(const std::string& name, Callback<void(float)> callback, bool changeOnly, float deadband) {
     if(inputWithName(name) != INPUT_INVALID) return false;
 
     Input input;
     input.name = name;
     input.callback = callback;
+    input.changeOnly = changeOnly;
+    input.delivered = false;
+    input.deadband = deadband < 0 ? 0 : deadband;
+    input.lastValue = 0;
     inputs_.push_back(input);
     return inputs_.size()-1;
 }
 
-InputID Receiver::addInput(const std::string& name, float& var) {
-    return addInput(name, [&var](float v) { var = v; });
+InputID Receiver::addInput(const std::string& name, float& var, bool changeOnly, float deadband) {
+    return addInput(name, [&var](float v) { var = v; }, changeOnly, deadband);
+}
+
+InputID Receiver::addInput(const std::string& name, bool changeOnly, float deadband) {
+    return addInput(name, Callback<void(float)>(nullptr), changeOnly, deadband);
+}
+
+void Receiver::setFrameBuffer(float* frame, uint8_t size, 
+                              Callback<void(const NodeAddr&, uint8_t, const float*, const InputMask&)> cb) {
+    frame_ = frame;
+    frameSize_ = (frame != nullptr) ? size : 0;
+    frameCB_ = cb;
+    frameMask_.clear();
+}
+
+void Receiver::forgetDeliveredValues() {
+    for(auto& input: inputs_) input.delivered = false;
 }
 
 const std::string& Receiver::inputName(InputID input)
@@ -3,7 +3,7 @@
 
 #include <string>
 #include <vector>
-#include <functional>
+#include "BBRCallback.h"
 
 #include "BBRTypes.h"
 #include "BBRMixManager.h"
@@ -28,38 +28,91 @@ public:
      * 
      * Inputs are identified by the `InputID` data type, which is just an `uint8_t`. The value of 255, or `INPUT_INVALID`,
      * is reserved for error handling or cases in which no input ID is given.
+     * 
+     * By default, an input is set on every packet that concerns it. An input added with `changeOnly` is only set if
+     * its value moved by more than `deadband` from the last value delivered to it -- useful if the callback talks to
+     * a servo or motor controller over a bus. Moving to exactly 0, -1 or 1 is always delivered, so a stick returning
+     * to center doesn't leave the input stuck at a value inside the deadband.
      * */
     
     //! Add an input, directly setting a float. Returns input id if OK, INPUT_INVALID if an input for the given name / id exists.
-    virtual InputID addInput(const std::string& name, float& variable);
+    virtual InputID addInput(const std::string& name, float& variable, bool changeOnly = false, float deadband = 0);
     //! Add an input, calling a callback. Returns input id if OK, INPUT_INVALID if an input for the given name / id exists.
-    virtual InputID addInput(const std::string& name, std::function<void(float)> callback);
+    virtual InputID addInput(const std::string& name, Callback<void(float)> callback, bool changeOnly = false, float deadband = 0);
+    //! Add an input that is only delivered through the frame buffer (see `setFrameBuffer()`).
+    virtual InputID addInput(const std::string& name, bool changeOnly = false, float deadband = 0);
     //! Returns the name for the given ID.
     virtual const std::string& inputName(InputID input);
     //! Returns the ID for the given name, or INPUT_INVALID .
     virtual InputID inputWithName(const std::string& name);
     //! Returns the number of inputs.
     virtual uint8_t numInputs();
+    //! Make the next value for every input be delivered, even for change-only inputs. Called on comm timeout.
+    virtual void forgetDeliveredValues();
+
+    /**
+     * Deliver inputs in bulk instead of one callback per input. Inputs with an ID below `size` are written to
+     * `frame[ID]` instead of calling their callbacks, and after each packet `cb` is called once with the frame and
+     * a mask of the inputs that were written (subject to change-only / deadband rules). Inputs at `size` and above
+     * keep using their callbacks. Pass `nullptr` to go back to callbacks only.
+     */
+    virtual void setFrameBuffer(float* frame, uint8_t size, 
+                                Callback<void(const NodeAddr&, uint8_t, const float*, const InputMask&)> cb = nullptr);
 
     /**
      * @}
      */
 
     //! Set a callback to be called when all data has been processed by the framework (all floats set / callbacks called).
-    virtual void setDataFinishedCallback(std::function<void(const NodeAddr&, uint8_t)> cb) { dataFinishedCB_ = cb; }
+    virtual void setDataFinishedCallback(Callback<void(const NodeAddr&, uint8_t)> cb) { dataFinishedCB_ = cb; }
 
     //! Set a callback to be called with raw data as soon as it has been received (before being processed by the framework).
-    virtual void setDataReceivedCallback(std::function<void(const NodeAddr&, uint8_t, const void*, uint8_t)> cb) { dataReceivedCB_ = cb; }
+    virtual void setDataReceivedCallback(Callback<void(const NodeAddr&, uint8_t, const void*, uint8_t)> cb) { dataReceivedCB_ = cb; }
 
 protected:
     struct Input {
         std::string name;
-        std::function<void(float)> callback;
+        Callback<void(float)> callback;
+        bool changeOnly;
+        bool delivered;  // lastValue is valid
+        float deadband;
+        float lastValue;
     };
 
+    //! Pass `value` to the input's frame slot or callback, unless the input is change-only and the value didn't change enough.
+    inline bool deliver(InputID id, float value) {
+        Input& input = inputs_[id];
+        if(input.changeOnly && input.delivered) {
+            float diff = value > input.lastValue ? value - input.lastValue : input.lastValue - value;
+            bool toRest = value != input.lastValue && (value == 0.0f || value == 1.0f || value == -1.0f);
+            if(diff <= input.deadband && !toRest) return false;
+        }
+        input.delivered = true;
+        input.lastValue = value;
+        if(id < frameSize_) {
+            frame_[id] = value;
+            frameMask_.set(id);
+        } else if(input.callback != nullptr) {
+            input.callback(value);
+        }
+        return true;
+    }
+    //! Call before delivering a packet's inputs.
+    inline void beginFrame() { 
+        if(frame_ != nullptr) frameMask_.clear(); 
+    }
+    //! Call after delivering a packet's inputs.
+    inline void finishFrame(const NodeAddr& addr, uint8_t seqnum) {
+        if(frame_ != nullptr && frameCB_ != nullptr) frameCB_(addr, seqnum, frame_, frameMask_);
+    }
+
     std::vector<Input> inputs_;
-    std::function<void(const NodeAddr&, uint8_t, const void*, uint8_t)> dataReceivedCB_ = nullptr;
-    std::function<void(const NodeAddr&,uint8_t)> dataFinishedCB_ = nullptr;
+    float* frame_ = nullptr;
+    uint8_t frameSize_ = 0;
+    InputMask frameMask_;
+    Callback<void(const NodeAddr&, uint8_t, const float*, const InputMask&)> frameCB_ = nullptr;
+    Callback<void(const NodeAddr&, uint8_t, const void*, uint8_t)> dataReceivedCB_ = nullptr;
+    Callback<void(const NodeAddr&,uint8_t)> dataFinishedCB_ = nullptr;
 };
 
 };
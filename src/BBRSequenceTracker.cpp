@@ -0,0 +1,50 @@
+#include "BBRSequenceTracker.h"
+
+using namespace bb;
+using namespace bb::rmt;
+
+void SequenceTracker::setBits(uint8_t bits) {
+    if(bits < 2) bits = 2;
+    if(bits > 16) bits = 16;
+    bits_ = bits;
+    mask_ = uint16_t((1UL << bits) - 1);
+    window_ = (mask_ + 1) / 4;
+    if(window_ > 15) window_ = 15; // longer reordering doesn't happen on our links; keeps loss reports timely
+    reset();
+}
+
+SequenceTracker::Result SequenceTracker::track(uint16_t seq, Loss& loss) {
+    seq &= mask_;
+    loss.lost = loss.bursts = loss.longestBurst = 0;
+    if(!have_) {
+        have_ = true;
+        last_ = seq;
+        seen_ = 0xffffffff; // nothing before the first packet counts as lost
+        run_ = 0;
+        return SEQ_NEW;
+    }
+
+    uint16_t ahead = (seq - last_) & mask_;
+    uint16_t behind = (last_ - seq) & mask_;
+    if(ahead != 0 && behind > window_) {
+        // Move the window one number at a time -- bit window_ is the one falling out next
+        for(uint16_t i=0; i<ahead; i++) {
+            if(((seen_ >> window_) & 1) == 0) {
+                loss.lost++;
+                run_++;
+            } else if(run_ > 0) {
+                loss.bursts++;
+                if(run_ > loss.longestBurst) loss.longestBurst = run_;
+                run_ = 0;
+            }
+            seen_ <<= 1;
+        }
+        seen_ |= 1;
+        last_ = seq;
+        return SEQ_NEW;
+    }
+
+    if((seen_ >> behind) & 1) return SEQ_DUPLICATE;
+    seen_ |= 1UL << behind;
+    return SEQ_LATE;
+}
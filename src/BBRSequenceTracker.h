@@ -0,0 +1,67 @@
+#if !defined(BBRSEQUENCETRACKER_H)
+#define BBRSEQUENCETRACKER_H
+
+#include <Arduino.h>
+
+namespace bb {
+namespace rmt {
+
+//! Receiver-side tracking of one sender's wrapping sequence numbers.
+/**
+ * Fed the sequence number of every packet from one sender, in arrival order, and classifies each packet as new,
+ * duplicate or late (arrived after a packet sent later). Fixed memory: the last accepted number and a 32 bit map
+ * of the numbers received right before it.
+ *
+ * A number that falls out of the reorder window (`reorderWindow()` numbers behind the newest) without having
+ * been received is lost. So losses are reported that many packets late, but exactly: a packet that arrives late
+ * but within the window never counts as lost, and runs of lost packets (bursts) are reported when they end.
+ *
+ * Sequence numbers are `bits` wide and wrap. A number up to `reorderWindow()` behind the last accepted one counts
+ * as late or duplicate, anything else as new, so gaps of up to 2^bits - reorderWindow() - 2 lost packets are
+ * measured correctly. Larger gaps look like reordering: up to reorderWindow() + 1 good packets are taken as late or
+ * duplicate until the sender's numbers are ahead again, and the gap isn't counted. The same goes for a sender that
+ * restarted, until `reset()`. With 3 bit numbers (Monaco's `seqnum`) that
+ * happens after a burst of 5 or more lost packets, with 7 bits only after 112.
+ */
+class SequenceTracker {
+public:
+    enum Result {
+        SEQ_NEW,       //!< In order, possibly after a gap -- use it
+        SEQ_DUPLICATE, //!< Received before
+        SEQ_LATE       //!< Older than a packet already accepted
+    };
+
+    //! Losses found by one `track()` call.
+    struct Loss {
+        uint16_t lost;         //!< Numbers that fell out of the reorder window without being received
+        uint16_t bursts;       //!< Runs of lost numbers that ended
+        uint16_t longestBurst; //!< Longest of these runs
+    };
+
+    SequenceTracker(uint8_t bits = 3) { setBits(bits); }
+
+    //! Width of the sequence numbers, 2..16 bits. Resets the tracker.
+    void setBits(uint8_t bits);
+    uint8_t bits() const { return bits_; }
+    //! How far behind the last accepted number a packet is taken to be late rather than new.
+    uint16_t reorderWindow() const { return window_; }
+
+    //! Forget the sender's position, eg. after it restarted. The next packet is new without a gap.
+    void reset() { have_ = false; }
+
+    //! Classify the packet with sequence number `seq`, and report the losses this uncovers in `loss`.
+    Result track(uint16_t seq, Loss& loss);
+
+protected:
+    uint16_t mask_, window_;
+    uint16_t last_;
+    uint16_t run_;  // lost numbers since the last received one that fell out of the window
+    uint32_t seen_; // bit n set: last_ - n was received
+    uint8_t bits_;
+    bool have_;
+};
+
+}; // rmt
+}; // bb
+
+#endif // BBRSEQUENCETRACKER_H
@@ -0,0 +1,88 @@
+#if !defined(BBRSTATICMIX_H)
+#define BBRSTATICMIX_H
+
+#include "BBRTypes.h"
+
+namespace bb {
+namespace rmt {
+
+/**
+ * Compile-time form of an `Interpolator`, for a fixed on-the-wire bit depth.
+ *
+ * Same arithmetic as `CompiledInterpolator`, but scale and curve points are template constants, so `evaluate()`
+ * compiles to a multiply, two shifts, a select and a multiply-add, without any memory access for a linear curve.
+ * Results are identical to `CompiledInterpolator`'s.
+ */
+template<const Interpolator& IP, uint8_t BITS>
+struct StaticInterp {
+    static_assert(BITS > 0 && BITS <= 16, "Bit depth must be 1..16");
+
+    static const uint8_t SEGMENT_SHIFT = 24;
+    static const uint8_t OFFSET_BITS = 12;
+    static const uint32_t MAXVAL = (uint32_t(1) << BITS) - 1;
+    static const uint32_t SCALE = ((uint32_t(4) << SEGMENT_SHIFT) + MAXVAL - 1) / MAXVAL;
+
+    static constexpr int32_t q16(int8_t percent) {
+        return percent >= 0 ? (int32_t(percent) * 65536 + 50) / 100 : (int32_t(percent) * 65536 - 50) / 100;
+    }
+    static constexpr int32_t base(uint32_t seg) {
+        return seg == 0 ? q16(IP.i0) : seg == 1 ? q16(IP.i25) : seg == 2 ? q16(IP.i50) : seg == 3 ? q16(IP.i75) : q16(IP.i100);
+    }
+    static constexpr bool linear() {
+        return base(1) - base(0) == base(2) - base(1) && base(2) - base(1) == base(3) - base(2) && 
+               base(3) - base(2) == base(4) - base(3);
+    }
+
+    //! Evaluate for the given raw axis value. Returns Q16.
+    static inline int32_t evaluate(uint32_t raw) {
+        uint32_t t = raw * SCALE;
+        uint32_t seg = t >> SEGMENT_SHIFT;
+        int32_t off = (t >> (SEGMENT_SHIFT - OFFSET_BITS)) & ((1 << OFFSET_BITS) - 1);
+        if(seg >= 4) {
+            seg = 3;
+            off = 1 << OFFSET_BITS;
+        }
+        if(linear()) { // no table needed
+            return base(0) + int32_t(seg) * (base(1) - base(0)) + (((base(1) - base(0)) * off) >> OFFSET_BITS);
+        }
+        static const int32_t bases[5] = {base(0), base(1), base(2), base(3), base(4)};
+        return bases[seg] + (((bases[seg+1] - bases[seg]) * off) >> OFFSET_BITS);
+    }
+};
+
+/**
+ * Compile-time form of an `AxisMix`, eg. `StaticMix<0, INTERP_LIN_CENTERED>` or
+ * `StaticMix<0, INTERP_LIN_CENTERED, 1, INTERP_LIN_POSITIVE, MIX_MULT>`.
+ *
+ * Used by receivers whose mixes are fixed in firmware (see `MStaticReceiver`). The protocol supplies the bit
+ * depths of the axes; `axisMix()` returns the equivalent runtime mix for reporting.
+ */
+template<AxisID AXIS1, const Interpolator& IP1,
+         AxisID AXIS2 = AXIS_INVALID, const Interpolator& IP2 = INTERP_ZERO, MixType MIX = MIX_NONE>
+struct StaticMix {
+    static const AxisID axis1 = AXIS1;
+    static const AxisID axis2 = AXIS2;
+    static const MixType mixType = MIX;
+
+    //! The same mix as an `AxisMix`.
+    static AxisMix axisMix() { return AxisMix(AXIS1, IP1, AXIS2, IP2, MIX); }
+
+    //! Same semantics as `AxisMix::compute()`, on raw axis values of the given bit depths. Returns Q16.
+    //! An unused axis may have bit depth 0.
+    template<uint8_t BITS1, uint8_t BITS2>
+    static inline int32_t computeQ16(uint32_t raw1, uint32_t raw2) {
+        typedef StaticInterp<IP1, AXIS1 == AXIS_INVALID ? 1 : BITS1> Interp1;
+        typedef StaticInterp<IP2, AXIS2 == AXIS_INVALID ? 1 : BITS2> Interp2;
+
+        if(AXIS1 == AXIS_INVALID && AXIS2 == AXIS_INVALID) return 0;
+        if(AXIS1 == AXIS_INVALID) return Interp2::evaluate(raw2);
+        if(AXIS2 == AXIS_INVALID || MIX == MIX_NONE) return Interp1::evaluate(raw1);
+        if(MIX == MIX_ADD) return Interp1::evaluate(raw1) + Interp2::evaluate(raw2);
+        return int32_t((int64_t(Interp1::evaluate(raw1)) * Interp2::evaluate(raw2)) >> 16);
+    }
+};
+
+}; // rmt
+}; // bb
+
+#endif // BBRSTATICMIX_H
@@ -0,0 +1,117 @@
+#include "BBRStepProfiler.h"
+#include "BBRUtils.h"
+
+#if defined(BBR_STEP_PROFILER)
+
+using namespace bb;
+using namespace bb::rmt;
+
+StepProfiler::StepProfiler() {
+    reset();
+}
+
+void StepProfiler::reset() {
+    step_.reset();
+    jitter_.reset();
+    for(uint8_t i=0; i<NUM_PHASES; i++) {
+        phases_[i].reset();
+        phaseUS_[i] = 0;
+    }
+    stepDepth_ = 0;
+    phaseDepth_ = 0;
+    overflow_ = 0;
+    haveTransmit_ = false;
+    lastTransmitUS_ = 0;
+    busyUS_ = 0;
+    resetUS_ = micros();
+}
+
+void StepProfiler::beginStep() {
+    if(stepDepth_++ > 0) return;
+
+    unsigned long now = micros();
+    stepStartUS_ = now;
+    for(uint8_t i=0; i<NUM_PHASES; i++) phaseUS_[i] = 0;
+    phaseStack_[0] = PHASE_HOUSEKEEPING; // whatever isn't claimed by a phase
+    phaseDepth_ = 1;
+    overflow_ = 0;
+    phaseStartUS_ = now;
+}
+
+void StepProfiler::endStep() {
+    if(stepDepth_ == 0) return;
+    if(--stepDepth_ > 0) return;
+
+    unsigned long now = micros();
+    closePhase(now);
+    phaseDepth_ = 0;
+
+    uint32_t total = now - stepStartUS_;
+    step_.add(total);
+    for(uint8_t i=0; i<NUM_PHASES; i++) phases_[i].add(phaseUS_[i]);
+    busyUS_ += total;
+}
+
+void StepProfiler::closePhase(unsigned long now) {
+    if(phaseDepth_ == 0) return;
+    phaseUS_[phaseStack_[phaseDepth_-1]] += now - phaseStartUS_;
+    phaseStartUS_ = now;
+}
+
+void StepProfiler::beginPhase(Phase phase) {
+    if(stepDepth_ == 0) return;
+    if(phaseDepth_ >= MAX_PHASE_DEPTH) {
+        overflow_++; // keep charging the current phase
+        return;
+    }
+    closePhase(micros());
+    phaseStack_[phaseDepth_++] = phase;
+}
+
+void StepProfiler::endPhase() {
+    if(stepDepth_ == 0) return;
+    if(overflow_ > 0) {
+        overflow_--;
+        return;
+    }
+    closePhase(micros());
+    if(phaseDepth_ > 1) phaseDepth_--;
+}
+
+void StepProfiler::transmitStarted(unsigned long nominalGapUS) {
+    unsigned long now = micros();
+    if(haveTransmit_) {
+        unsigned long period = now - lastTransmitUS_;
+        jitter_.add(period > nominalGapUS ? period - nominalGapUS : nominalGapUS - period);
+    }
+    lastTransmitUS_ = now;
+    haveTransmit_ = true;
+}
+
+float StepProfiler::busyPercent() const {
+    unsigned long wall = micros() - resetUS_;
+    if(wall == 0) return 0;
+    return float(double(busyUS_) * 100.0 / double(wall));
+}
+
+const char* StepProfiler::phaseName(Phase phase) {
+    switch(phase) {
+    case PHASE_RECEIVE:      return "receive";
+    case PHASE_DISPATCH:     return "dispatch";
+    case PHASE_TRANSMIT:     return "transmit";
+    case PHASE_HOUSEKEEPING: return "housekeeping";
+    default:                 return "invalid";
+    }
+}
+
+void StepProfiler::printInfo() const {
+    bb::rmt::printf("Step profile (%.1f%% of wall time in step()):\n", busyPercent());
+    step_.printInfo("\tstep()");
+    for(uint8_t i=0; i<NUM_PHASES; i++) {
+        std::string label = std::string("\t  ") + phaseName(Phase(i));
+        phases_[i].printInfo(label.c_str());
+    }
+    jitter_.printInfo("\ttransmit jitter");
+}
+
+#endif // BBR_STEP_PROFILER
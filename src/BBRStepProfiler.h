@@ -0,0 +1,121 @@
+#if !defined(BBRSTEPPROFILER_H)
+#define BBRSTEPPROFILER_H
+
+#include "BBRHistogram.h"
+
+/**
+ * Wall time profiler for `Protocol::step()`.
+ *
+ * Compiled in only if `BBR_STEP_PROFILER` is defined (eg. `build_flags = -DBBR_STEP_PROFILER` in platformio.ini).
+ * Every protocol then owns a `StepProfiler` that records, per outermost `step()` call, the total duration and
+ * the time spent in each phase:
+ *
+ * - RECEIVE: reading from the radio / serial / packet queue, framing and CRC checks.
+ * - DISPATCH: `incomingPacket()` and everything it calls, including receiver callbacks.
+ * - TRANSMIT: `Transmitter::transmit()`.
+ * - HOUSEKEEPING: everything else (pairing mode, temp peers, watchdog, comealive...).
+ *
+ * Phases are exclusive: entering DISPATCH from within RECEIVE pauses RECEIVE until DISPATCH is left. Nested
+ * `step()` calls (eg. from `waitForPacket()`) are counted as part of the outer call. Additionally, the profiler
+ * records how far apart transmits actually are relative to `Protocol::setTransmitFrequencyHz()`.
+ *
+ * Call sites use the `BBR_PROFILE_STEP()` and `BBR_PROFILE_PHASE()` macros, which expand to nothing without
+ * `BBR_STEP_PROFILER`.
+ */
+
+#if defined(BBR_STEP_PROFILER)
+
+namespace bb {
+namespace rmt {
+
+class StepProfiler {
+public:
+    enum Phase {
+        PHASE_RECEIVE      = 0,
+        PHASE_DISPATCH     = 1,
+        PHASE_TRANSMIT     = 2,
+        PHASE_HOUSEKEEPING = 3,
+        NUM_PHASES         = 4
+    };
+
+    StepProfiler();
+
+    //! Called on entering `step()`. Only the outermost call is measured.
+    void beginStep();
+    //! Called on leaving `step()`.
+    void endStep();
+    //! Switch to the given phase until `endPhase()` is called.
+    void beginPhase(Phase phase);
+    //! Return to the phase that was active before the matching `beginPhase()`.
+    void endPhase();
+    //! Called right before a transmit, with the nominal gap between transmits.
+    void transmitStarted(unsigned long nominalGapUS);
+
+    //! Duration of whole `step()` calls.
+    const Histogram& stepHistogram() const { return step_; }
+    //! Time spent in the given phase per `step()` call.
+    const Histogram& phaseHistogram(Phase phase) const { return phases_[phase < NUM_PHASES ? phase : PHASE_HOUSEKEEPING]; }
+    //! Absolute deviation of the transmit period from the nominal one.
+    const Histogram& transmitJitterHistogram() const { return jitter_; }
+    //! Percentage of wall time spent inside `step()` since the last `reset()`.
+    float busyPercent() const;
+
+    static const char* phaseName(Phase phase);
+
+    void reset();
+    void printInfo() const;
+
+    //! RAII helper for `BBR_PROFILE_STEP()`.
+    class StepScope {
+    public:
+        StepScope(StepProfiler& p): p_(p) { p_.beginStep(); }
+        ~StepScope() { p_.endStep(); }
+    protected:
+        StepProfiler& p_;
+    };
+
+    //! RAII helper for `BBR_PROFILE_PHASE()`.
+    class PhaseScope {
+    public:
+        PhaseScope(StepProfiler& p, Phase phase): p_(p) { p_.beginPhase(phase); }
+        ~PhaseScope() { p_.endPhase(); }
+    protected:
+        StepProfiler& p_;
+    };
+
+protected:
+    void closePhase(unsigned long now);
+
+    static const uint8_t MAX_PHASE_DEPTH = 4;
+
+    Histogram step_, phases_[NUM_PHASES], jitter_;
+
+    uint8_t stepDepth_;
+    unsigned long stepStartUS_;
+    uint32_t phaseUS_[NUM_PHASES];
+
+    Phase phaseStack_[MAX_PHASE_DEPTH];
+    uint8_t phaseDepth_, overflow_;
+    unsigned long phaseStartUS_;
+
+    bool haveTransmit_;
+    unsigned long lastTransmitUS_;
+
+    unsigned long resetUS_;
+    uint64_t busyUS_;
+};
+
+}; // rmt
+}; // bb
+
+#define BBR_PROFILE_STEP() bb::rmt::StepProfiler::StepScope bbrStepScope_(stepProfiler_)
+#define BBR_PROFILE_PHASE(phase) bb::rmt::StepProfiler::PhaseScope bbrPhaseScope_(stepProfiler_, bb::rmt::StepProfiler::phase)
+
+#else // BBR_STEP_PROFILER
+
+#define BBR_PROFILE_STEP()
+#define BBR_PROFILE_PHASE(phase)
+
+#endif // BBR_STEP_PROFILER
+
+#endif // BBRSTEPPROFILER_H
@@ -111,9 +111,40 @@ bool Transmitter::setRawAxisValue(AxisID axis, uint32_t value) {
     if(value > maxval) value = maxval;
     //Serial.printf("setRawAxisValue: %d\n", value);
     axes_[axis].value = value;
+    if(policy_ == TRANSMIT_ON_CHANGE && !changePending_) {
+        uint32_t sent = axis < sentValues_.size() ? sentValues_[axis] : 0;
+        uint32_t diff = value > sent ? value - sent : sent - value;
+        if(diff > changeThreshold_ * maxval) changePending_ = true;
+    }
+#if defined(BBR_LATENCY_STATS)
+    if(!latencySetPending_) {
+        latencySetUS_ = micros();
+        latencySetPending_ = true;
+    }
+#endif
     return true;
 }
 
+void Transmitter::setTransmitOnChange(float threshold, float keepaliveSeconds, float minGapSeconds) {
+    policy_ = TRANSMIT_ON_CHANGE;
+    changeThreshold_ = threshold;
+    keepaliveUS_ = keepaliveSeconds * 1e6;
+    minGapUS_ = minGapSeconds * 1e6;
+    changePending_ = true; // send the current state right away
+}
+
+bool Transmitter::transmitDue(unsigned long usSinceLastTransmit, unsigned long periodicGapUS) {
+    if(policy_ == TRANSMIT_PERIODIC) return usSinceLastTransmit > periodicGapUS;
+    if(usSinceLastTransmit > keepaliveUS_) return true;
+    return changePending_ && usSinceLastTransmit >= minGapUS_;
+}
+
+void Transmitter::transmitted() {
+    sentValues_.resize(axes_.size());
+    for(unsigned int i=0; i<axes_.size(); i++) sentValues_[i] = axes_[i].value;
+    changePending_ = false;
+}
+
 uint32_t Transmitter::rawAxisValue(AxisID axis) {
     if(axis >= axes_.size()) return 0;
     return axes_[axis].value;
@@ -7,6 +7,7 @@
 #include "BBRTypes.h"
 #include "BBRUtils.h"
 #include "BBRProtocol.h"
+#include "BBRLatencyStats.h"
 
 namespace bb {
 namespace rmt {
@@ -127,9 +128,46 @@ public:
      * @}
      */
 
+    /** \defgroup transmit_policy Transmit policy
+     * @{
+     * 
+     * By default, `Protocol::step()` calls `transmit()` at the fixed rate set by `Protocol::setTransmitFrequencyHz()`.
+     * 
+     * With send-on-change, it transmits as soon as an axis has moved by more than `threshold` (a fraction of the
+     * axis's full range, 0 meaning any change) since the last transmit, but not more often than every
+     * `minGapSeconds`. If nothing moves, it still transmits every `keepaliveSeconds`, which must be well below the
+     * receivers' `setCommTimeoutWatchdog()` time. This gives lower latency for stick movements and a lot less
+     * traffic while the sticks are still.
+     */
+    enum TransmitPolicy {
+        TRANSMIT_PERIODIC,
+        TRANSMIT_ON_CHANGE
+    };
+    virtual void setTransmitPeriodic() { policy_ = TRANSMIT_PERIODIC; }
+    virtual void setTransmitOnChange(float threshold = 0.01, float keepaliveSeconds = 0.1, float minGapSeconds = 0.002);
+    TransmitPolicy transmitPolicy() { return policy_; }
+
+    //! Whether `Protocol::step()` should transmit now. `periodicGapUS` is the gap for `TRANSMIT_PERIODIC`.
+    virtual bool transmitDue(unsigned long usSinceLastTransmit, unsigned long periodicGapUS);
+    //! Called by `Protocol::step()` after each transmit, to remember what was sent.
+    virtual void transmitted();
+    /**
+     * @}
+     */
+
 protected:
     std::vector<Axis> axes_;
     bool primary_;
+
+    TransmitPolicy policy_ = TRANSMIT_PERIODIC;
+    float changeThreshold_ = 0;
+    unsigned long keepaliveUS_ = 0, minGapUS_ = 0;
+    bool changePending_ = false;
+    std::vector<uint32_t> sentValues_; //!< Axis values as of the last transmit, for TRANSMIT_ON_CHANGE
+#if defined(BBR_LATENCY_STATS)
+    bool latencySetPending_ = false;   //!< An axis has been set since the last transmit.
+    unsigned long latencySetUS_ = 0;   //!< When that happened.
+#endif
 };
 
 template <typename P> class TransmitterBase: public Transmitter {
@@ -1,4 +1,5 @@
 #include "BBRTypes.h"
+#include <inttypes.h>
 
 using namespace bb;
 using namespace bb::rmt;
@@ -121,7 +122,7 @@ void NodeAddr::fromString(const std::string& str) {
         fromMACAddress(m);
     } else if(str.length() == 17 && str[8] == ':' && str[2] != ':') {
         uint32_t hi, lo;
-        sscanf(str.c_str(), "%lx:%lx", &hi, &lo);
+        sscanf(str.c_str(), "%" SCNx32 ":%" SCNx32, &hi, &lo);
         fromXBeeAddress(hi, lo);
     } else {
         for(int i=0; i<8; i++) byte[i] = 0;
@@ -133,7 +134,7 @@ std::string NodeAddr::toString() const {
     if(byte[6] == 0 && byte[7] == 0) {
         sprintf(buf, "%02x:%02x:%02x:%02x:%02x:%02x", byte[0], byte[1], byte[2], byte[3], byte[4], byte[5]);
     } else {
-        sprintf(buf, "%lx:%lx", addrHi(), addrLo());
+        sprintf(buf, "%" PRIx32 ":%" PRIx32, addrHi(), addrLo());
     }
     return buf;
 }
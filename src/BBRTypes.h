@@ -37,6 +37,7 @@ enum ProtocolType {
     MONACO_BLE        = 'B',
     MONACO_UDP        = 'U',
     MONACO_SAT        = 's',
+    MONACO_LOOPBACK   = 'L',
     SPHERO_BLE        = 'S',
     DROIDDEPOT_BLE    = 'D',
     SPEKTRUM_DSSS     = 'd',
@@ -48,6 +49,16 @@ typedef uint8_t InputID;
 //! Invalid input ID definition.
 static const InputID INPUT_INVALID = 255;
 
+//! One bit per input ID.
+struct InputMask {
+    uint32_t bits[8];
+
+    void clear() { for(uint8_t i=0; i<8; i++) bits[i] = 0; }
+    void set(InputID input) { bits[input >> 5] |= uint32_t(1) << (input & 31); }
+    bool test(InputID input) const { return (bits[input >> 5] >> (input & 31)) & 1; }
+    bool any() const { for(uint8_t i=0; i<8; i++) if(bits[i] != 0) return true; return false; }
+};
+
 //! Typedef for axis IDs. Valid axis IDs go from 0 to 126.
 typedef uint8_t AxisID;
 //! Invalid axis ID definition.
@@ -189,6 +200,54 @@ struct Telemetry {
     float posX, posY;                    // Unit: meters -- leave 0 if not applicable
 };
 
+//! Runtime counters kept by every protocol, see `Protocol::stats()`.
+/**
+ * Every counter is a 32 bit word written from exactly one context -- either the radio driver's callback
+ * or the context calling `step()` -- so updating them needs no locking. A snapshot is consistent per
+ * counter, not across counters.
+ */
+struct ProtocolStats {
+    uint32_t packetsSent;      //!< Packets handed to the radio successfully.
+    uint32_t sendErrors;       //!< Packets the radio refused to send.
+    uint32_t deliveryFailures; //!< Packets the radio reported as not delivered (eg. no ESP-NOW ACK).
+    uint32_t packetsReceived;  //!< Valid packets handed to the protocol layer.
+    uint32_t packetsByType[4]; //!< Valid packets received, by protocol specific packet type (Monaco: control, state, config, pairing).
+    uint32_t packetsDropped;   //!< Valid packets that could not be handled (unknown type, no receiver, ...).
+    uint32_t crcErrors;        //!< Packets discarded because of a bad CRC.
+    uint32_t sizeErrors;       //!< Frames discarded because of a wrong length.
+    uint32_t framingErrors;    //!< Frames discarded because of bad framing, checksum or timeout below the packet layer.
+    uint32_t garbageBytes;     //!< Bytes discarded while looking for the start of a frame.
+    uint32_t queueDepth;       //!< Packets received but not yet handled.
+    uint32_t queueHighWater;   //!< Largest `queueDepth` seen.
+    uint32_t packetsLost;      //!< Packets missing from the senders' sequence numbers, see `NodeStats`.
+    uint32_t duplicates;       //!< Packets received more than once, dropped if the protocol can tell reliably.
+    uint32_t reordered;        //!< Packets that arrived after a later one, dropped if the protocol can tell reliably.
+    uint32_t packetsRecovered; //!< Lost packets whose content was recovered by forward error correction.
+};
+
+//! Per paired node counters, see `Protocol::nodeStats()`.
+struct NodeStats {
+    uint32_t packetsSent;         //!< Packets sent to this node successfully.
+    uint32_t sendErrors;          //!< Packets to this node the radio refused to send.
+    uint32_t packetsReceived;     //!< Valid packets received from this node.
+    unsigned long lastReceivedMS; //!< `millis()` when the last packet came in from this node.
+
+    // Filled in by protocols that track sequence numbers (Monaco: control packets only)
+    uint32_t packetsSequenced;    //!< Packets from this node whose sequence number was tracked, including duplicates.
+    uint32_t packetsLost;         //!< Packets that never arrived, from gaps in the sequence (see `SequenceTracker`).
+    uint32_t duplicates;          //!< Packets received more than once, dropped if the protocol can tell reliably.
+    uint32_t reordered;           //!< Packets that arrived after a later one, dropped if the protocol can tell reliably.
+    uint32_t lossBursts;          //!< Ended runs of consecutive lost packets; `packetsLost / lossBursts` is about the mean run length.
+    uint16_t maxLossBurst;        //!< Longest run of consecutive lost packets.
+    uint32_t packetsRecovered;    //!< Lost packets recovered by forward error correction; still counted in `packetsLost`.
+
+    //! Fraction of this node's sequenced packets that were lost, 0..1.
+    float lossRate() const {
+        uint32_t sent = packetsSequenced - duplicates + packetsLost;
+        return sent == 0 ? 0 : float(packetsLost) / float(sent);
+    }
+};
+
 /**
  * @defgroup storage Typedefs for storing protocol information to non-volatile memory
  * @{
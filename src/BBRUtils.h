@@ -15,11 +15,24 @@ static int printfFinal(const char* str) {
 }
 
 static int vprintf(const char* format, va_list args) {
-    int len = vsnprintf(NULL, 0, format, args) + 1;
-    char *buf = new char[len];
-    vsnprintf(buf, len, format, args);
-    printfFinal(buf);
-    delete[] buf;
+    // Stack buffer for the usual short message; only longer ones allocate
+    char buf[128];
+    va_list args2;
+    va_copy(args2, args); // args is consumed by the first vsnprintf() on some ABIs
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    if(len < 0) {
+        va_end(args2);
+        return len;
+    }
+    if(size_t(len) < sizeof(buf)) {
+        printfFinal(buf);
+    } else {
+        char *big = new char[len+1];
+        vsnprintf(big, len+1, format, args2);
+        printfFinal(big);
+        delete[] big;
+    }
+    va_end(args2);
     return len;
 }
 
@@ -4,6 +4,8 @@
 #include "MCS/ESP/BBRMESPProtocol.h"
 #include "MCS/XBee/BBRMXBProtocol.h"
 #include "MCS/Sat/BBRMSatProtocol.h"
+#include "MCS/Loopback/BBRMLoopbackProtocol.h"
+#include "MCS/BBRMStaticReceiver.h"
 #include "CommercialBLE/DroidDepot/BBRDroidDepotProtocol.h"
 #include "CommercialBLE/Sphero/BBRSpheroProtocol.h"
 
@@ -13,6 +15,8 @@
 #include "BBRTransmitter.h"
 #include "BBRProtocol.h"
 #include "BBRProtocolFactory.h"
+#include "BBRLatencyStats.h"
+#include "BBRStepProfiler.h"
 
 /**
  * @mainpage
@@ -0,0 +1,122 @@
+#include "BBRMBatchMixer.h"
+#include <string.h>
+
+using namespace bb;
+using namespace bb::rmt;
+
+MBatchMixer::MBatchMixer() {
+    numInputs_ = 0;
+    columns_.assign((MControlPacket::NUM_AXES+1) * BLOCK_SIZE, 0.0f); // ZERO_COLUMN stays 0 forever
+    values_.assign(BLOCK_SIZE, 0.0f);
+    primary_.assign(BLOCK_SIZE, 0);
+}
+
+void MBatchMixer::Curve::set(const Interpolator& interp) {
+    float p[5] = {interp.i0/100.0f, interp.i25/100.0f, interp.i50/100.0f, interp.i75/100.0f, interp.i100/100.0f};
+    base = p[0];
+    for(uint8_t i=0; i<4; i++) delta[i] = p[i+1] - p[i];
+}
+
+static uint8_t columnForAxis(AxisID axis) {
+    if(axis == AXIS_INVALID) return MControlPacket::NUM_AXES;
+    if(axis >= SECONDARY_ADD) axis -= SECONDARY_ADD;
+    if(axis >= MControlPacket::NUM_AXES) return MControlPacket::NUM_AXES;
+    return axis;
+}
+
+void MBatchMixer::setMixes(const MixManager& mgr) {
+    entries_.clear();
+    for(uint8_t i=0; i<mgr.numMixes(); i++) {
+        const AxisMix& mix = mgr.mixAtIndex(i);
+        Entry e;
+        e.input = mgr.inputForMixIndex(i);
+        e.column1 = columnForAxis(mix.axis1);
+        e.column2 = columnForAxis(mix.axis2);
+        e.curve1.set(mix.interp1);
+        e.curve2.set(mix.interp2);
+
+        // Same routing as MReceiver
+        bool usesSecondary = (mix.axis1 >= SECONDARY_ADD && mix.axis1 != AXIS_INVALID) ||
+                             (mix.axis2 >= SECONDARY_ADD && mix.axis2 != AXIS_INVALID);
+        bool usesPrimary = mix.axis1 < SECONDARY_ADD || mix.axis2 < SECONDARY_ADD;
+        e.route = (usesSecondary ? 0 : ROUTE_PRIMARY) | (usesPrimary ? 0 : ROUTE_SECONDARY);
+
+        if(mix.axis1 == AXIS_INVALID && mix.axis2 == AXIS_INVALID) e.kind = KIND_ZERO;
+        else if(mix.axis1 == AXIS_INVALID) e.kind = KIND_AXIS2;
+        else if(mix.axis2 == AXIS_INVALID) e.kind = KIND_AXIS1;
+        else if(mix.mixType == MIX_ADD) e.kind = KIND_ADD;
+        else if(mix.mixType == MIX_MULT) e.kind = KIND_MULT;
+        else e.kind = KIND_AXIS1;
+
+        entries_.push_back(e);
+    }
+
+    numInputs_ = mgr.numMixes() > 0 ? mgr.inputForMixIndex(mgr.numMixes()-1) + 1 : 0;
+    state_.assign(numInputs_, 0.0f);
+}
+
+void MBatchMixer::reset() {
+    state_.assign(numInputs_, 0.0f);
+}
+
+void MBatchMixer::evaluate(const MControlPacket* packets, size_t count, float* out) {
+    while(count > 0) {
+        uint16_t n = count < BLOCK_SIZE ? count : BLOCK_SIZE;
+        evaluateBlock(packets, n, out);
+        packets += n;
+        out += size_t(n) * numInputs_;
+        count -= n;
+    }
+}
+
+void MBatchMixer::evaluateBlock(const MControlPacket* packets, uint16_t count, float* out) {
+    float scale[MControlPacket::NUM_AXES];
+    for(uint8_t a=0; a<MControlPacket::NUM_AXES; a++) {
+        scale[a] = 4.0f / float((1 << MControlPacket::bitDepthForAxis(a)) - 1);
+    }
+
+    // Transpose into one column per axis, scaled to 0..4 (the curve segment plus the position within it)
+    uint32_t raw[MControlPacket::NUM_AXES];
+    for(uint16_t k=0; k<count; k++) {
+        packets[k].decodeAll(raw);
+        for(uint8_t a=0; a<MControlPacket::NUM_AXES; a++) columns_[a*BLOCK_SIZE + k] = raw[a] * scale[a];
+        primary_[k] = packets[k].primary ? ROUTE_PRIMARY : ROUTE_SECONDARY;
+    }
+
+    memset(out, 0, sizeof(float) * count * numInputs_);
+
+    float* __restrict v = values_.data();
+    for(const Entry& e: entries_) {
+        const float* __restrict t1 = &columns_[e.column1*BLOCK_SIZE];
+        const float* __restrict t2 = &columns_[e.column2*BLOCK_SIZE];
+        const Curve c1 = e.curve1, c2 = e.curve2; // local copies, so the compiler knows v doesn't alias them
+
+        // Branchless piecewise linear evaluation, one loop per mix kind so each one vectorizes.
+        switch(e.kind) {
+        case KIND_ZERO:
+            for(uint16_t k=0; k<count; k++) v[k] = 0;
+            break;
+        case KIND_AXIS1:
+            for(uint16_t k=0; k<count; k++) v[k] = c1.evaluate(t1[k]);
+            break;
+        case KIND_AXIS2:
+            for(uint16_t k=0; k<count; k++) v[k] = c2.evaluate(t2[k]);
+            break;
+        case KIND_ADD:
+            for(uint16_t k=0; k<count; k++) v[k] = c1.evaluate(t1[k]) + c2.evaluate(t2[k]);
+            break;
+        case KIND_MULT:
+            for(uint16_t k=0; k<count; k++) v[k] = c1.evaluate(t1[k]) * c2.evaluate(t2[k]);
+            break;
+        }
+
+        // Hold the previous value for packets from the other transmitter
+        float s = state_[e.input];
+        float* o = out + e.input;
+        for(uint16_t k=0; k<count; k++) {
+            if(primary_[k] & e.route) s = v[k];
+            o[size_t(k) * numInputs_] = s;
+        }
+        state_[e.input] = s;
+    }
+}
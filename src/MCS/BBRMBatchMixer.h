@@ -0,0 +1,94 @@
+#if !defined(BBRMBATCHMIXER_H)
+#define BBRMBATCHMIXER_H
+
+#include "../BBRMixManager.h"
+#include "BBRMPacket.h"
+#include <vector>
+#include <math.h>
+
+namespace bb {
+namespace rmt {
+
+/**
+ * Evaluates a set of mixes over many control packets at once, eg. to replay recorded traffic against candidate
+ * mix configurations.
+ *
+ * Results are the same as feeding the packets one by one into an `MReceiver` with the same mixes (up to float
+ * rounding): primary packets only update inputs that use no secondary axis, secondary packets only inputs that
+ * use no primary axis, and an input keeps its previous value for packets that aren't meant for it.
+ *
+ * Packets are processed in blocks. Each block is first decoded into one float column per axis; every input
+ * is then evaluated over the whole block with a branchless form of the interpolator, which the compiler can
+ * vectorize (SSE, NEON). This is meant for hosts -- on a microcontroller, use `MReceiver`.
+ */
+class MBatchMixer {
+public:
+    MBatchMixer();
+
+    //! Take over the mixes from `mgr`. Inputs are 0 up to the highest input that has a mix.
+    void setMixes(const MixManager& mgr);
+    //! Number of columns in the output.
+    uint8_t numInputs() const { return numInputs_; }
+
+    /**
+     * Evaluate `count` packets. `out` receives `count` rows of `numInputs()` floats, the values of all inputs
+     * after the respective packet. Inputs without a mix are 0. Mix axes that don't exist on the wire read as 0.
+     * Values carry over between calls until `reset()`.
+     */
+    void evaluate(const MControlPacket* packets, size_t count, float* out);
+    //! Set all inputs back to 0.
+    void reset();
+
+protected:
+    static const uint16_t BLOCK_SIZE = 256;
+    static const uint8_t ZERO_COLUMN = MControlPacket::NUM_AXES;
+
+    enum Kind {
+        KIND_ZERO,  // no valid axis
+        KIND_AXIS1, // only axis 1, or MIX_NONE
+        KIND_AXIS2, // only axis 2
+        KIND_ADD,
+        KIND_MULT
+    };
+
+    enum Route {
+        ROUTE_PRIMARY   = 1,
+        ROUTE_SECONDARY = 2
+    };
+
+    //! Interpolator as `base + sum(delta[k] * clamp(t-k, 0, 1))` for t in 0..4.
+    struct Curve {
+        float base, delta[4];
+        void set(const Interpolator& interp);
+
+        inline float evaluate(float t) const {
+            return base + delta[0]*clamp01(t) + delta[1]*clamp01(t-1) + delta[2]*clamp01(t-2) + delta[3]*clamp01(t-3);
+        }
+        //! Clamp to 0..1 without a compare -- compilers won't turn a float compare into a vector select by default.
+        static inline float clamp01(float x) {
+            return 0.5f * (fabsf(x) - fabsf(x - 1.0f) + 1.0f);
+        }
+    };
+
+    struct Entry {
+        InputID input;
+        uint8_t column1, column2;
+        uint8_t route;
+        Kind kind;
+        Curve curve1, curve2;
+    };
+
+    void evaluateBlock(const MControlPacket* packets, uint16_t count, float* out);
+
+    std::vector<Entry> entries_;
+    uint8_t numInputs_;
+    std::vector<float> state_;
+    std::vector<float> columns_; // (NUM_AXES+1) columns of BLOCK_SIZE values in 0..4
+    std::vector<float> values_;  // one input over one block
+    std::vector<uint8_t> primary_;
+};
+
+}; // rmt
+}; // bb
+
+#endif // BBRMBATCHMIXER_H
@@ -0,0 +1,101 @@
+#include "BBRMFraming.h"
+
+using namespace bb;
+using namespace bb::rmt;
+
+// Largest COBS code byte a frame of ours can start with
+static const uint8_t MAX_COBS_CODE = MAX_FRAMED_LENGTH + 1;
+static_assert(MAX_COBS_CODE < '[', "COBS code bytes must not look like the start of a hex frame");
+static_assert(MAX_FRAMED_LENGTH >= MPacketView::FEC_MAX_LENGTH + MAX_INTEGRITY_TAG_LENGTH &&
+              MAX_FRAMED_LENGTH >= MPacketView::MANIFEST_MIN_MAX_LENGTH + MAX_INTEGRITY_TAG_LENGTH,
+              "Frames must fit every packet type");
+
+uint8_t bb::rmt::encodeFrame(const uint8_t* wire, uint8_t len, MFraming framing, uint8_t* out) {
+    if(len > MAX_FRAMED_LENGTH) return 0;
+
+    if(framing == FRAMING_HEX) {
+        out[0] = '[';
+        hexEncode(wire, len, (char*)out+1);
+        out[2*len+1] = ']';
+        return 2*len+2;
+    }
+
+    // COBS -- frames are shorter than 254 bytes, so there are no 0xff blocks
+    uint8_t codePos = 0, o = 1;
+    for(uint8_t i=0; i<len; i++) {
+        if(wire[i] == 0) {
+            out[codePos] = o - codePos;
+            codePos = o++;
+        } else {
+            out[o++] = wire[i];
+        }
+    }
+    out[codePos] = o - codePos;
+    out[o++] = 0;
+    return o;
+}
+
+MFrameDecoder::Result MFrameDecoder::feed(uint8_t b) {
+    switch(state_) {
+    case STATE_IDLE:
+        if(b == 0) return FRAME_NONE; // empty frame, or a leading delimiter
+        len_ = 0;
+        if(b == '[') {
+            state_ = STATE_HEX;
+            hi_ = -1;
+            return FRAME_NONE;
+        }
+        if(b > MAX_COBS_CODE) return error(b);
+        state_ = STATE_COBS;
+        left_ = b - 1;
+        return FRAME_NONE;
+
+    case STATE_COBS:
+        if(b == 0) {
+            if(left_ != 0) return error(b);
+            state_ = STATE_IDLE;
+            framing_ = FRAMING_BINARY;
+            return FRAME_COMPLETE;
+        }
+        if(left_ == 0) { // end of block -- the next code byte stands for a 0
+            if(len_ >= sizeof(buf_) || b > MAX_COBS_CODE) return error(b);
+            buf_[len_++] = 0;
+            left_ = b - 1;
+            return FRAME_NONE;
+        }
+        if(len_ >= sizeof(buf_)) return error(b);
+        buf_[len_++] = b;
+        left_--;
+        return FRAME_NONE;
+
+    case STATE_HEX: {
+        if(b == ']') {
+            if(hi_ >= 0 || len_ == 0) return error(b);
+            state_ = STATE_SKIP; // whatever comes until the next frame, eg. a line break
+            framing_ = FRAMING_HEX;
+            return FRAME_COMPLETE;
+        }
+        uint8_t n = hexNibble(b);
+        if(n > 0xf) return error(b);
+        if(hi_ < 0) {
+            hi_ = n;
+            return FRAME_NONE;
+        }
+        if(len_ >= sizeof(buf_)) return error(b);
+        buf_[len_++] = (hi_ << 4) | n;
+        hi_ = -1;
+        return FRAME_NONE;
+    }
+
+    case STATE_SKIP:
+    default:
+        if(b == 0) {
+            state_ = STATE_IDLE;
+        } else if(b == '[') {
+            state_ = STATE_HEX;
+            len_ = 0;
+            hi_ = -1;
+        }
+        return FRAME_NONE;
+    }
+}
@@ -0,0 +1,90 @@
+#if !defined(BBRMFRAMING_H)
+#define BBRMFRAMING_H
+
+#include "BBRMIntegrity.h"
+
+namespace bb {
+namespace rmt {
+
+/**
+ * Framing of Monaco packets on byte streams (serial links), see `MFrameDecoder`.
+ *
+ * Binary frames are the packet's wire bytes (including its CRC), COBS encoded and terminated by a 0 byte:
+ * one byte of overhead plus the delimiter. Hex frames are the wire bytes as lowercase hex between '[' and ']',
+ * as `serializePacket()` has always produced them -- twice the size, but readable in a terminal.
+ */
+enum MFraming {
+    FRAMING_BINARY = 0,
+    FRAMING_HEX    = 1
+};
+
+/**
+ * Most wire bytes a frame carries. A COBS frame starts with a code byte of at most one more than that, which has
+ * to stay below '[' for `MFrameDecoder` to tell the framings apart. Less than `MAX_TAGGED_LENGTH`: links with
+ * framing report this as their `MProtocol::maxWireLength()`, so the longest manifest frames are split up.
+ */
+static const uint8_t MAX_FRAMED_LENGTH = 89;
+
+//! Room needed for any encoded frame.
+static const uint8_t MAX_FRAME_LENGTH = 2*MAX_FRAMED_LENGTH + 2;
+
+//! Encode `len` (at most `MAX_FRAMED_LENGTH`) wire bytes into `out`. Returns the frame length, 0 if it's too long.
+uint8_t encodeFrame(const uint8_t* wire, uint8_t len, MFraming framing, uint8_t* out);
+
+/**
+ * Incremental decoder for both framings, fed one byte at a time from a serial port.
+ *
+ * Decodes into a fixed buffer -- no allocation and no parsing pass once the frame is complete. The framing is
+ * detected per frame: a '[' where a frame starts begins a hex frame, anything else a COBS frame (COBS code
+ * bytes are at most `MAX_FRAMED_LENGTH` + 1, which is below '['). So the sender can switch to hex for debugging without
+ * telling the receiver. After garbage or a broken frame, the decoder skips to the next 0 byte or '['.
+ *
+ * A completed frame has the right framing, but its integrity tag, length and CRC still have to be checked, eg. by
+ * `MProtocol::checkIntegrity()` and `MProtocol::incomingPacket(const NodeAddr&, const MPacketView&)`.
+ */
+class MFrameDecoder {
+public:
+    enum Result {
+        FRAME_NONE,     // need more bytes
+        FRAME_COMPLETE, // data() / length() hold a frame, until the next feed()
+        FRAME_ERROR     // broken frame, dropped
+    };
+
+    MFrameDecoder() { reset(); }
+    void reset() { state_ = STATE_IDLE; len_ = 0; }
+
+    Result feed(uint8_t b);
+
+    const uint8_t* data() const { return buf_; }
+    uint8_t length() const { return len_; }
+    //! Framing of the last completed frame.
+    MFraming framing() const { return framing_; }
+
+protected:
+    enum State {
+        STATE_IDLE, // between frames
+        STATE_COBS,
+        STATE_HEX,
+        STATE_SKIP  // resynchronizing, or after a hex frame
+    };
+
+    //! Drop the frame. A 0 byte or '[' is the start of the next one, anything else means skipping ahead.
+    inline Result error(uint8_t b) {
+        state_ = b == 0 ? STATE_IDLE : b == '[' ? STATE_HEX : STATE_SKIP;
+        len_ = 0;
+        hi_ = -1;
+        return FRAME_ERROR;
+    }
+
+    uint8_t buf_[MAX_FRAMED_LENGTH];
+    uint8_t len_;
+    State state_;
+    MFraming framing_ = FRAMING_BINARY;
+    uint8_t left_; // COBS: data bytes left in the current block
+    int8_t hi_;    // hex: pending high nibble, or -1
+};
+
+}; // rmt
+}; // bb
+
+#endif // BBRMFRAMING_H
@@ -0,0 +1,45 @@
+#if !defined(BBRMINTEGRITY_H)
+#define BBRMINTEGRITY_H
+
+#include "BBRMPacketView.h"
+
+namespace bb {
+namespace rmt {
+
+/**
+ * Integrity checks for Monaco frames, on top of the CRC-7 every packet carries.
+ *
+ * The 7 bit CRC lets about one in 128 badly mangled frames through, which adds up with many nodes on one channel.
+ * Nodes that agreed on a stronger check when pairing (see `MProtocol::setIntegrity()`) append a tag to every frame
+ * they send each other, except pairing packets: CRC-16/CCITT-FALSE (2 bytes) or CRC-32C (4 bytes), little endian,
+ * over all wire bytes before it, CRC-7 included. The frame under the tag is unchanged, so once the tag is checked
+ * and stripped, `MPacketView` takes it as before.
+ */
+enum MIntegrity {
+    INTEGRITY_CRC7   = 0, //!< No tag, CRC-7 only
+    INTEGRITY_CRC16  = 1, //!< CRC-16/CCITT-FALSE tag, 2 bytes
+    INTEGRITY_CRC32C = 2  //!< CRC-32C (Castagnoli) tag, 4 bytes
+};
+
+static const uint8_t MAX_INTEGRITY_TAG_LENGTH = 4;
+//! Longest frame on the wire, tag included -- size link buffers for this.
+static const uint8_t MAX_TAGGED_LENGTH = MPacketView::MAX_LENGTH + MAX_INTEGRITY_TAG_LENGTH;
+
+inline uint8_t integrityTagLength(MIntegrity integrity) {
+    return integrity == INTEGRITY_CRC16 ? 2 : integrity == INTEGRITY_CRC32C ? 4 : 0;
+}
+
+//! CRC-16/CCITT-FALSE (poly 0x1021, init 0xffff, not reflected) over `len` bytes. ESP32: ROM routine, elsewhere slice-by-4.
+uint16_t calculateCRC16(const uint8_t* buffer, size_t len);
+//! CRC-32C (poly 0x1edc6f41, reflected, init and xorout 0xffffffff). SSE4.2 instruction where the CPU has it.
+uint32_t calculateCRC32C(const uint8_t* buffer, size_t len);
+
+//! Append the tag to the `len` wire bytes in `wire`, which needs room for the tag. Returns the new length.
+uint8_t appendIntegrityTag(MIntegrity integrity, uint8_t* wire, uint8_t len);
+//! Check the tag at the end of `len` received bytes, and strip it from `len`. False if it doesn't match.
+bool checkIntegrityTag(MIntegrity integrity, const uint8_t* wire, uint8_t& len);
+
+}; // rmt
+}; // bb
+
+#endif // BBRMINTEGRITY_H
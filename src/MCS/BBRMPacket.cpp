@@ -3,53 +3,74 @@
 
 using namespace bb::rmt;
 
+static const char hexDigits[] = "0123456789abcdef";
+
+// Nibble value for every character, 0xff for anything that isn't a hex digit
+static const uint8_t hexNibbles[256] = {
+#define X 0xff
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, X, X, X, X, X, X,
+	X,10,11,12,13,14,15, X, X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X,10,11,12,13,14,15, X, X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X
+#undef X
+};
+
+uint8_t bb::rmt::hexNibble(char c) {
+	return hexNibbles[uint8_t(c)];
+}
+
+void bb::rmt::hexEncode(const uint8_t* in, size_t len, char* out) {
+	while(len--) {
+		*out++ = hexDigits[*in >> 4];
+		*out++ = hexDigits[*in++ & 0xf];
+	}
+}
+
+bool bb::rmt::hexDecode(const char* in, size_t len, uint8_t* out) {
+	uint8_t bad = 0;
+	while(len--) {
+		uint8_t hi = hexNibbles[uint8_t(*in++)], lo = hexNibbles[uint8_t(*in++)];
+		bad |= hi | lo;
+		*out++ = (hi << 4) | lo;
+	}
+	return (bad & 0xf0) == 0;
+}
+
+size_t bb::rmt::serializePacket(const MPacket& packet, char* buf, size_t size) {
+	uint8_t wire[sizeof(MPacket)];
+	uint8_t len = packet.toWire(wire);
+	if(size < 2*size_t(len) + 3) return 0;
+	buf[0] = '[';
+	hexEncode(wire, len, buf+1);
+	buf[2*len+1] = ']';
+	buf[2*len+2] = '\0';
+	return 2*len+2;
+}
+
+bool bb::rmt::deserializePacket(MPacket& packet, const char* str, size_t len) {
+	// Delta packets are shorter than full ones
+	if(len % 2 != 0 || len < 2*2+2 || len > 2*sizeof(packet)+2) return false;
+	if(str[0] != '[' || str[len-1] != ']') return false;
+
+	uint8_t wire[sizeof(MPacket)];
+	size_t wlen = (len-2)/2;
+	if(!hexDecode(str+1, wlen, wire)) return false;
+	if(!packet.fromWire(wire, wlen)) return false;
+	return packet.calculateCRC() == packet.crc;
+}
+
 std::string bb::rmt::serializePacket(const MPacket& packet) {
-    char buf[3];
-    memset(buf, 0, 3);
-    std::string retval = "[";
-    for(unsigned int i=0; i<sizeof(packet); i++) {
-        sprintf(buf, "%02x", ((uint8_t*)(&packet))[i]);
-        retval += buf;
-    }
-    retval += "]";
-    Serial.print("Serialized Packet: "); Serial.println(retval.c_str());
-    return retval;
+	char buf[MAX_SERIALIZED_LENGTH+1];
+	size_t len = serializePacket(packet, buf, sizeof(buf));
+	return std::string(buf, len);
 }
 
 bool bb::rmt::deserializePacket(MPacket &packet, const std::string& str) {
-    if(str.size() != 2*sizeof(packet)+2) {
-        Serial.print("Error deserializing packet: Wrong size string - expected ");
-        Serial.print(sizeof(packet));
-        Serial.print(" characters, got ");
-        Serial.println(str.size());
-        return false;
-    }
-    if(str.rfind('[', 0) != 0) {
-        Serial.println("Error deserializing packet: Packet doesn't start with '['\n");
-        return false;
-    }
-    if(str.rfind(']', str.size()-1) != str.size()-1) {
-        Serial.println("Error deserializing packet: Packet doesn't end with ']'\n");
-        return false;
-    }
-    uint8_t* p = ((uint8_t*)&packet);
-    const char* s = str.c_str()+1;
-    //bb::rmt::printf("%s -- ", str.c_str());
-    for(unsigned int i=0; i<sizeof(packet); i++) {
-        int a;
-        sscanf(s, "%02x", &a);
-        *p = (uint8_t)a;
-        s += 2;
-        p += 1;
-    }
-    //bb::rmt::printf("%s\n", serializePacket(packet).c_str());
-
-    uint8_t crc = packet.calculateCRC();
-    if(crc != packet.crc) {
-        Serial.println("Error deserializing packet: Wrong CRC\n");
-        return false;
-    }
-    return true;
+	return deserializePacket(packet, str.c_str(), str.size());
 }
 
 static const uint8_t crc7Table[256] = {
@@ -87,7 +108,7 @@ static const uint8_t crc7Table[256] = {
 	0x8c, 0x9e, 0xa8, 0xba, 0xc4, 0xd6, 0xe0, 0xf2
 };
 
-static uint8_t calcCRC7(const uint8_t *buffer, size_t len) {
+uint8_t bb::rmt::calculateCRC7(const uint8_t *buffer, size_t len) {
 	uint8_t crc = 0;
 	while(len--) {
 		crc = crc7Table[crc ^ *buffer++];
@@ -96,5 +117,63 @@ static uint8_t calcCRC7(const uint8_t *buffer, size_t len) {
 }
 
 uint8_t MPacket::calculateCRC() const {
-	return calcCRC7((const uint8_t*)this, sizeof(MPacket)-1);
+	return calculateCRC7((const uint8_t*)this, wireLength()-1);
+}
+
+// Bit stream helpers for the delta values -- same bit order as the MControlPacket bitfields.
+static void putBits(uint8_t* buf, uint16_t pos, uint8_t bits, uint32_t value) {
+	while(bits > 0) {
+		uint8_t n = 8 - (pos & 7);
+		if(n > bits) n = bits;
+		buf[pos >> 3] |= (value & ((1 << n) - 1)) << (pos & 7);
+		value >>= n;
+		pos += n;
+		bits -= n;
+	}
+}
+
+static uint32_t getBits(const uint8_t* buf, uint16_t pos, uint8_t bits) {
+	uint32_t value = 0;
+	uint8_t done = 0;
+	while(done < bits) {
+		uint8_t n = 8 - (pos & 7);
+		if(n > bits - done) n = bits - done;
+		value |= uint32_t((buf[pos >> 3] >> (pos & 7)) & ((1 << n) - 1)) << done;
+		pos += n;
+		done += n;
+	}
+	return value;
+}
+
+bool MControlDelta::encode(uint8_t keyframeID, const uint32_t key[MControlPacket::NUM_AXES], 
+                           const uint32_t raw[MControlPacket::NUM_AXES], bool isPrimary) {
+	uint32_t ch = 0;
+	for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+		if((raw[i] & MCONTROL_AXIS_FIELDS[i].mask) != (key[i] & MCONTROL_AXIS_FIELDS[i].mask)) ch |= uint32_t(1) << i;
+	}
+	if(valueBytes(ch) > MAX_VALUE_BYTES) return false;
+
+	keyframe = keyframeID;
+	changed = ch;
+	seqExt = 0;
+	primary = isPrimary;
+	memset(values, 0, sizeof(values));
+	uint16_t pos = 0;
+	for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+		if((ch & (uint32_t(1) << i)) == 0) continue;
+		putBits(values, pos, MControlPacket::bitDepthForAxis(i), raw[i] & MCONTROL_AXIS_FIELDS[i].mask);
+		pos += MControlPacket::bitDepthForAxis(i);
+	}
+	return true;
+}
+
+void MControlDelta::apply(uint32_t raw[MControlPacket::NUM_AXES]) const {
+	uint32_t ch = changed;
+	if(valueBytes(ch) > MAX_VALUE_BYTES) return;
+	uint16_t pos = 0;
+	for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+		if((ch & (uint32_t(1) << i)) == 0) continue;
+		raw[i] = getBits(values, pos, MControlPacket::bitDepthForAxis(i));
+		pos += MControlPacket::bitDepthForAxis(i);
+	}
 }
\ No newline at end of file
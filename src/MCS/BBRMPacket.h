@@ -3,6 +3,7 @@
 
 #include "../BBRTypes.h"
 #include "../BBRUtils.h"
+#include <string.h>
 
 //
 // REALTIME PROTOCOL
@@ -62,8 +63,14 @@ struct __attribute__ ((packed)) MPairingPacket {
 		MaxlenString name;           // byte 6..15
 	};
 
+	//! Marks `PairingReply::capabilities` and `integrity` as valid -- older nodes leave those bytes undefined.
+	static const uint32_t CAPABILITIES_MAGIC = 0x4d434150;
+
 	struct __attribute__ ((packed)) PairingReply {
-		PairingReplyResult res: 8;
+		PairingReplyResult res: 8;   // byte 1
+		uint32_t capabilitiesMagic;  // byte 2..5 - CAPABILITIES_MAGIC
+		uint16_t capabilities;       // byte 6..7 - MProtocol::Capability bits of the replying node
+		uint8_t integrity;           // byte 8 - MIntegrity both nodes use from now on, see MProtocol::setIntegrity()
 	};
 
 	union {
@@ -83,6 +90,7 @@ struct __attribute__ ((packed)) MControlPacket {
 	static const uint8_t BITDEPTH2 = 8;
 	static const uint8_t BITDEPTH3 = 5;
 	static const uint8_t BITDEPTH4 = 1;
+	static const uint8_t NUM_AXES = 19;
 
 	// all of the below are filled by Transmitter::transmit()
 	uint16_t axis0 : BITDEPTH1; // bit 0..9
@@ -106,12 +114,40 @@ struct __attribute__ ((packed)) MControlPacket {
 	uint8_t axis18 : BITDEPTH4; // bit 102
 	bool primary    : 1; // bit 103
 
+	//! Offset and width of one axis in the 13 byte payload, see `MCONTROL_AXIS_FIELDS`.
+	struct AxisField {
+		uint8_t byte;  // first byte
+		uint8_t shift; // bit offset within that byte
+		uint16_t mask; // (1<<bitdepth)-1
+	};
+
+	//! Return the bit depth of the given axis, or 0 if there is no such axis.
+	static constexpr uint8_t bitDepthForAxis(uint8_t num) {
+		return num < 5 ? BITDEPTH1 : num < 10 ? BITDEPTH2 : num == 10 ? BITDEPTH3 : num <= 18 ? BITDEPTH4 : 0;
+	}
+	//! Return the bit offset of the given axis in the payload.
+	static constexpr uint8_t bitOffsetForAxis(uint8_t num) {
+		return num == 0 ? 0 : bitOffsetForAxis(num-1) + bitDepthForAxis(num-1);
+	}
+
+	/**
+	 * Pack all axes from `raw` (NUM_AXES values) in one pass. Values are masked to their axis's bit depth; 
+	 * `primary` is left alone. Same layout as the bitfields above, but without a switch per axis.
+	 */
+	inline void encodeAll(const uint32_t raw[NUM_AXES]);
+	//! Unpack all axes into `raw` (NUM_AXES values) in one pass.
+	inline void decodeAll(uint32_t raw[NUM_AXES]) const;
+
+	//! Return the raw value of the given axis, or 0 if there is no such axis.
+	inline uint16_t getRawAxis(uint8_t num) const { return rawAxisFromBytes((const uint8_t*)this, num); }
+	//! Same as `getRawAxis()`, from a payload in a byte buffer.
+	static inline uint16_t rawAxisFromBytes(const uint8_t* b, uint8_t num);
+	//! Set the raw value of the given axis, masked to its bit depth. Does nothing if there is no such axis.
+	inline void setRawAxis(uint8_t num, uint16_t value);
+
 	void setAxis(uint8_t num, float value, Unit unit=UNIT_UNITY_CENTERED) {
-		uint16_t multiplier = 0;
-		if(num < 5) multiplier = (1<<BITDEPTH1)-1;
-		else if(num<10) multiplier = (1<<BITDEPTH2)-1;
-		else if(num==10) multiplier = (1<<BITDEPTH3)-1;
-		else if(num<=18) multiplier = (1<<BITDEPTH4)-1;
+		if(num >= NUM_AXES) return;
+		float multiplier = (1<<bitDepthForAxis(num))-1;
 
 		switch(unit) {
 		case UNIT_DEGREES:
@@ -136,62 +172,12 @@ struct __attribute__ ((packed)) MControlPacket {
 			break;
 		}
 
-		switch(num) {
-		case 0: axis0 = value; break;
-		case 1: axis1 = value; break;
-		case 2: axis2 = value; break;
-		case 3: axis3 = value; break;
-		case 4: axis4 = value; break;
-		case 5: axis5 = value; break;
-		case 6: axis6 = value; break;
-		case 7: axis7 = value; break;
-		case 8: axis8 = value; break;
-		case 9: axis9 = value; break;
-		case 10: axis10 = value; break;
-		case 11: axis11 = value; break;
-		case 12: axis12 = value; break;
-		case 13: axis13 = value; break;
-		case 14: axis14 = value; break;
-		case 15: axis15 = value; break;
-		case 16: axis16 = value; break;
-		case 17: axis17 = value; break;
-		case 18:
-		default:
-			axis18 = value; break;
-		}
+		setRawAxis(num, value);
 	}
 
 	float getAxis(uint8_t num, Unit unit = UNIT_UNITY_CENTERED) const {
-		float multiplier = 0;
-		if(num < 5) multiplier = (1<<BITDEPTH1)-1;
-		else if(num<10) multiplier = (1<<BITDEPTH2)-1;
-		else if(num==10) multiplier = (1<<BITDEPTH3)-1;
-		else if(num<=18) multiplier = (1<<BITDEPTH4)-1;
-
-		float value;
-		switch(num) {
-		case 0: value = axis0; break;
-		case 1: value = axis1; break;
-		case 2: value = axis2; break;
-		case 3: value = axis3; break;
-		case 4: value = axis4; break;
-		case 5: value = axis5; break;
-		case 6: value = axis6; break;
-		case 7: value = axis7; break;
-		case 8: value = axis8; break;
-		case 9: value = axis9; break;
-		case 10: value = axis10; break;
-		case 11: value = axis11; break;
-		case 12: value = axis12; break;
-		case 13: value = axis13; break;
-		case 14: value = axis14; break;
-		case 15: value = axis15; break;
-		case 16: value = axis16; break;
-		case 17: value = axis17; break;
-		case 18: 
-		default:
-			value = axis18; break;
-		}
+		float multiplier = (1<<bitDepthForAxis(num))-1;
+		float value = getRawAxis(num);
 
 		switch(unit) {
 		case UNIT_DEGREES:
@@ -217,6 +203,138 @@ struct __attribute__ ((packed)) MControlPacket {
 	void print() const { for(int i=0; i<19; i++) printf("%d:%.1f ", i, getAxis(i, UNIT_RAW)); printf("\n"); }
 };     // 13 bytes long
 
+#define BBR_MCONTROL_AXIS_FIELD(n) { MControlPacket::bitOffsetForAxis(n) / 8, MControlPacket::bitOffsetForAxis(n) % 8, \
+                                     (1 << MControlPacket::bitDepthForAxis(n)) - 1 }
+//! Where each axis lives in an `MControlPacket`, derived from the bit depths. Every axis spans at most 3 bytes.
+static constexpr MControlPacket::AxisField MCONTROL_AXIS_FIELDS[MControlPacket::NUM_AXES] = {
+	BBR_MCONTROL_AXIS_FIELD(0),  BBR_MCONTROL_AXIS_FIELD(1),  BBR_MCONTROL_AXIS_FIELD(2),  BBR_MCONTROL_AXIS_FIELD(3),
+	BBR_MCONTROL_AXIS_FIELD(4),  BBR_MCONTROL_AXIS_FIELD(5),  BBR_MCONTROL_AXIS_FIELD(6),  BBR_MCONTROL_AXIS_FIELD(7),
+	BBR_MCONTROL_AXIS_FIELD(8),  BBR_MCONTROL_AXIS_FIELD(9),  BBR_MCONTROL_AXIS_FIELD(10), BBR_MCONTROL_AXIS_FIELD(11),
+	BBR_MCONTROL_AXIS_FIELD(12), BBR_MCONTROL_AXIS_FIELD(13), BBR_MCONTROL_AXIS_FIELD(14), BBR_MCONTROL_AXIS_FIELD(15),
+	BBR_MCONTROL_AXIS_FIELD(16), BBR_MCONTROL_AXIS_FIELD(17), BBR_MCONTROL_AXIS_FIELD(18)
+};
+#undef BBR_MCONTROL_AXIS_FIELD
+
+static_assert(sizeof(MControlPacket) == 13, "MControlPacket must be 13 bytes");
+static_assert(MControlPacket::bitOffsetForAxis(MControlPacket::NUM_AXES) == 103, "Axes must end where primary starts");
+
+/**
+ * Unrolled codec for `MCONTROL_AXIS_FIELDS`: axis I and then the rest. Byte indices, shifts and masks are compile
+ * time constants, so each axis becomes two or three byte loads / stores with constant shifts.
+ */
+template<uint8_t I> struct MControlAxisCodec {
+	static constexpr MControlPacket::AxisField F = MCONTROL_AXIS_FIELDS[I];
+	static const uint8_t NBYTES = (F.shift + MControlPacket::bitDepthForAxis(I) + 7) / 8;
+
+	static inline void decode(const uint8_t* b, uint32_t* raw) {
+		uint32_t w = b[F.byte];
+		if(NBYTES > 1) w |= uint32_t(b[F.byte+1]) << 8;
+		if(NBYTES > 2) w |= uint32_t(b[F.byte+2]) << 16;
+		raw[I] = (w >> F.shift) & F.mask;
+		MControlAxisCodec<I+1>::decode(b, raw);
+	}
+	static inline void encode(const uint32_t* raw, uint8_t* b) {
+		uint32_t w = (raw[I] & F.mask) << F.shift;
+		b[F.byte] |= w;
+		if(NBYTES > 1) b[F.byte+1] |= w >> 8;
+		if(NBYTES > 2) b[F.byte+2] |= w >> 16;
+		MControlAxisCodec<I+1>::encode(raw, b);
+	}
+};
+template<> struct MControlAxisCodec<MControlPacket::NUM_AXES> {
+	static inline void decode(const uint8_t*, uint32_t*) {}
+	static inline void encode(const uint32_t*, uint8_t*) {}
+};
+
+inline void MControlPacket::decodeAll(uint32_t raw[NUM_AXES]) const {
+	MControlAxisCodec<0>::decode((const uint8_t*)this, raw);
+}
+
+inline void MControlPacket::encodeAll(const uint32_t raw[NUM_AXES]) {
+	uint8_t b[sizeof(MControlPacket)] = {0};
+	b[12] = ((const uint8_t*)this)[12] & 0x80; // keep primary
+	MControlAxisCodec<0>::encode(raw, b);
+	memcpy(this, b, sizeof(MControlPacket));
+}
+
+inline uint16_t MControlPacket::rawAxisFromBytes(const uint8_t* b, uint8_t num) {
+	if(num >= NUM_AXES) return 0;
+	const AxisField& f = MCONTROL_AXIS_FIELDS[num];
+	uint8_t nbytes = (f.shift + bitDepthForAxis(num) + 7) / 8;
+	uint32_t w = b[f.byte];
+	if(nbytes > 1) w |= uint32_t(b[f.byte+1]) << 8;
+	if(nbytes > 2) w |= uint32_t(b[f.byte+2]) << 16;
+	return (w >> f.shift) & f.mask;
+}
+
+inline void MControlPacket::setRawAxis(uint8_t num, uint16_t value) {
+	if(num >= NUM_AXES) return;
+	const AxisField& f = MCONTROL_AXIS_FIELDS[num];
+	uint8_t nbytes = (f.shift + bitDepthForAxis(num) + 7) / 8;
+	uint8_t* b = (uint8_t*)this;
+	uint32_t w = uint32_t(value & f.mask) << f.shift, m = uint32_t(f.mask) << f.shift;
+	b[f.byte] = (b[f.byte] & ~m) | w;
+	if(nbytes > 1) b[f.byte+1] = (b[f.byte+1] & ~(m >> 8)) | (w >> 8);
+	if(nbytes > 2) b[f.byte+2] = (b[f.byte+2] & ~(m >> 16)) | (w >> 16);
+}
+
+/*
+	Delta control packets
+	- Sent as a control packet with MPacket::extended set, if the transmitter has delta encoding enabled
+	- Carry only the axes that differ from a keyframe -- the last full control packet, numbered by the transmitter
+	  in MControlKeyframe::id. Each delta is relative to the keyframe, not to the previous delta, so a lost
+	  delta costs nothing; a lost keyframe is bounded by the transmitter's keyframe interval.
+	- Values of the changed axes are bit-packed in axis order, with their bit depths, LSB first
+	- On the wire, only the used value bytes are sent: 1 + 4 + valueBytes() + 1 (CRC) bytes
+*/
+
+struct __attribute__ ((packed)) MControlDelta {
+	static const uint8_t MAX_VALUE_BYTES = 12;
+	static const uint8_t HEADER_LENGTH = 4;
+
+	uint8_t keyframe;       // byte 0 - id of the keyframe this is relative to
+	uint32_t changed  : 19; // byte 1..3 bit 0..18 - bitmap of axes that differ from the keyframe
+	uint8_t seqExt    : 4;  // byte 3 bit 19..22 - sequence extension, see MControlKeyframe
+	bool primary      : 1;  // byte 3 bit 23
+	uint8_t values[MAX_VALUE_BYTES];
+
+	//! Number of value bytes needed for the axes in `changed`.
+	static uint8_t valueBytes(uint32_t changed) {
+		uint8_t bits = MControlPacket::BITDEPTH1 * __builtin_popcount(changed & 0x1f) + 
+		               MControlPacket::BITDEPTH2 * __builtin_popcount((changed >> 5) & 0x1f) + 
+		               MControlPacket::BITDEPTH3 * ((changed >> 10) & 0x1) +
+		               MControlPacket::BITDEPTH4 * __builtin_popcount((changed >> 11) & 0xff);
+		return (bits + 7) / 8;
+	}
+
+	/**
+	 * Fill in the axes of `raw` that differ from `key` (both NUM_AXES values). Returns false, leaving the packet
+	 * undefined, if they don't fit into MAX_VALUE_BYTES -- send a keyframe instead.
+	 */
+	bool encode(uint8_t keyframeID, const uint32_t key[MControlPacket::NUM_AXES], 
+	            const uint32_t raw[MControlPacket::NUM_AXES], bool isPrimary);
+	//! Overwrite the changed axes in `raw` (NUM_AXES values, initially the keyframe's).
+	void apply(uint32_t raw[MControlPacket::NUM_AXES]) const;
+};
+
+/**
+ * A full control packet with the keyframe id that delta packets refer to. Bytes 13 and 14 of the payload are otherwise
+ * unused.
+ *
+ * seqExt extends the 3 bit `MPacket::seqnum` to 7 bits: it counts the wraps of the sender's seqnum. All control frames
+ * carry it (here, in `MControlDelta` and in `MAggregatePacket`), set by `MProtocol::finishPacket()`. Older senders
+ * leave these bits undefined, so receivers only use them if told to, see `MProtocol::setExtendedSequence()`.
+ */
+struct __attribute__ ((packed)) MControlKeyframe {
+	MControlPacket control;
+	uint8_t id;
+	uint8_t seqExt   : 4;
+	uint8_t reserved : 4;
+};
+
+static_assert(sizeof(MControlDelta) == MControlDelta::HEADER_LENGTH + MControlDelta::MAX_VALUE_BYTES, 
+              "MControlDelta header layout");
+
 struct __attribute__ ((packed)) MStatePacket {
 	Telemetry::SubsysStatus battStatus 	: 2; // bit 0..1
 	Telemetry::SubsysStatus driveStatus : 2; // bit 2..3
@@ -246,6 +364,7 @@ struct __attribute__ ((packed)) MConfigPacket {
 		CONFIG_GET_INPUT_NAME           = 5, // NamePacket  sender --> receiver
 		CONFIG_GET_MIX                  = 6, // MixPacket   sender --> receiver
 		CONFIG_SET_MIX                  = 7, // MixPacket   sender --> receiver
+		CONFIG_GET_MANIFEST             = 8, // ManifestRequest sender --> receiver, answered with manifest frames
 		CONFIG_FACTORY_RESET            = 63  // L->R - parameter: MAGIC
 	};
 
@@ -274,12 +393,25 @@ struct __attribute__ ((packed)) MConfigPacket {
 		MixType m : 2;
 	};
 
+	/**
+	 * Asks for all inputs and their mixes at once. The receiver answers with manifest frames (see `MPacketView`),
+	 * as many inputs per frame as fit into `maxLength` bytes, followed by the usual reply to this packet with
+	 * `count.count` set to the number of frames. Frames are numbered the same way for the same `maxLength`, so
+	 * lost ones can be asked for again by number.
+	 */
+	struct __attribute__ ((packed)) ManifestRequest {
+		uint8_t maxLength;  // longest frame the sender takes, integrity tag excluded
+		uint8_t firstChunk; // send frames firstChunk..lastChunk
+		uint8_t lastChunk;
+	};
+
 	ConfigType      type  : 6;
 	ConfigReplyType reply : 2;
 	union {
 		CountPacket count;
 		NamePacket name;
 		MixPacket mix;
+		ManifestRequest manifest;
 	} cfgPayload;
 };
 
@@ -328,10 +460,12 @@ struct __attribute__ ((packed)) MPacket {
 	PacketType type             : 2; // set by transmitter / receiver / whoever creates the packet
 	PacketSource source         : 2; // set by MProtocol::sendPacket() or subclass
 	mutable uint8_t seqnum      : 3; // set by MProtocol::sendPacket() or subclass
-	uint8_t reserved            : 1; 
+	uint8_t extended            : 1; // control packets: payload is an MControlDelta. Otherwise 0.
 
 	union {
 		MControlPacket control;
+		MControlKeyframe keyframe;
+		MControlDelta delta;
 		MStatePacket state;
 		MConfigPacket config;
 		MPairingPacket pairing;
@@ -343,10 +477,129 @@ struct __attribute__ ((packed)) MPacket {
 		type = t;
 		source = s;
 		seqnum = seq%8;
-		reserved = 0;
+		extended = 0;
 	}
-	MPacket() { }
+	MPacket() { extended = 0; }
+	//! CRC over the header and payload bytes that go on the wire.
 	uint8_t calculateCRC() const;
+
+	bool isDelta() const { return type == PACKET_TYPE_CONTROL && extended; }
+	//! Length on the wire, including the CRC. Full packets are sizeof(MPacket), delta packets are shorter.
+	uint8_t wireLength() const {
+		if(!isDelta()) return sizeof(MPacket);
+		return 1 + MControlDelta::HEADER_LENGTH + MControlDelta::valueBytes(payload.delta.changed) + 1;
+	}
+	//! Write the packet as it goes on the wire into `buf` (room for sizeof(MPacket) bytes). Returns the length.
+	uint8_t toWire(uint8_t* buf) const {
+		uint8_t len = wireLength();
+		memcpy(buf, this, len-1);
+		buf[len-1] = crc;
+		return len;
+	}
+	//! Read a packet from the wire. Returns false if `len` doesn't match; doesn't check the CRC.
+	bool fromWire(const uint8_t* buf, size_t len) {
+		if(len < 2 || len > sizeof(MPacket)) return false;
+		memset((uint8_t*)this, 0, sizeof(MPacket));
+		memcpy((uint8_t*)this, buf, len-1);
+		crc = buf[len-1];
+		return wireLength() == len;
+	}
+};
+
+//! CRC-7 (poly 0x09, as used by `MPacket::crc`) over `len` bytes.
+uint8_t calculateCRC7(const uint8_t* buffer, size_t len);
+
+//! Both transmitters' axes, as carried by an `MAggregatePacket`.
+struct __attribute__ ((packed)) MControlPair {
+	MControlPacket primary;   // axes 0..18, primary flag set
+	MControlPacket secondary; // axes SECONDARY_ADD.., primary flag clear
+};
+
+/**
+ * Extended control frame carrying both the primary and the secondary axes, for links whose MTU allows it
+ * (see `MProtocol::maxWireLength()`). One transmission and one receiver dispatch cover both sets, so the receiver
+ * never sees one set updated and the other not, and mixes can combine primary and secondary axes.
+ *
+ * Byte 0 is laid out as in `MPacket`, with `extended` set; on the wire, the frame is told apart from delta
+ * packets (also `extended`) by its length, which is longer than a full `MPacket`. There is no `MPacket` form, so
+ * it goes through `MProtocol::sendAggregatePacket()` and is received through `MPacketView`.
+ */
+struct __attribute__ ((packed)) MAggregatePacket {
+	MPacket::PacketType type    : 2; // always PACKET_TYPE_CONTROL
+	MPacket::PacketSource source: 2;
+	mutable uint8_t seqnum      : 3;
+	uint8_t extended            : 1; // always 1
+
+	MControlPair control;
+
+	uint8_t seqExt              : 4; // see MControlKeyframe
+	uint8_t reserved            : 4;
+
+	mutable uint8_t crc         : 8;
+
+	MAggregatePacket() {
+		memset((uint8_t*)this, 0, sizeof(*this));
+		type = MPacket::PACKET_TYPE_CONTROL;
+		extended = 1;
+		control.primary.primary = true;
+	}
+	uint8_t calculateCRC() const { return calculateCRC7((const uint8_t*)this, sizeof(*this)-1); }
+};
+
+/**
+ * Extended control frame with forward error correction: a full control packet, plus the transmitter's previous
+ * frame, delta encoded relative to the current one. If the previous frame got lost, the receiver recovers it from
+ * here and dispatches it before the current one, so no frame goes missing -- a button pressed for a single frame
+ * still registers, and frame callbacks see every frame. Sent by transmitters with FEC enabled (see
+ * `MTransmitter::setFEC()`) to receivers that announced `MProtocol::CAPABILITY_FEC` when pairing.
+ *
+ * Bytes 0..16 are laid out like a full `MPacket` with a keyframe, except that `extended` is set. The previous
+ * frame's `MControlDelta` follows, with its keyframe field holding the previous frame's id (always current.id - 1),
+ * and only its used value bytes are sent. The CRC is last, as always. Like aggregate frames, these are told apart
+ * by length: 22 to 34 bytes, with one byte of padding before the CRC where that would be the aggregate frame length.
+ */
+struct __attribute__ ((packed)) MFECPacket {
+	static const uint8_t BASE_LENGTH = 1 + 16 + MControlDelta::HEADER_LENGTH + 1;
+
+	MPacket::PacketType type    : 2; // always PACKET_TYPE_CONTROL
+	MPacket::PacketSource source: 2;
+	mutable uint8_t seqnum      : 3;
+	uint8_t extended            : 1; // always 1
+
+	MControlKeyframe current;
+	uint8_t reserved;
+	MControlDelta previous;
+
+	mutable uint8_t crc         : 8;
+
+	MFECPacket() {
+		memset((uint8_t*)this, 0, sizeof(*this));
+		type = MPacket::PACKET_TYPE_CONTROL;
+		extended = 1;
+	}
+
+	//! Length on the wire for a previous frame with the axes in `changed`, including padding and CRC.
+	static uint8_t wireLength(uint32_t changed) {
+		uint8_t len = BASE_LENGTH + MControlDelta::valueBytes(changed);
+		return len == sizeof(MAggregatePacket) ? len + 1 : len;
+	}
+	uint8_t wireLength() const { return wireLength(previous.changed); }
+	//! Write the frame as it goes on the wire into `buf` (room for sizeof(MFECPacket) bytes). Returns the length.
+	uint8_t toWire(uint8_t* buf) const {
+		uint8_t len = wireLength();
+		memcpy(buf, this, len-1);
+		buf[len-1] = crc;
+		return len;
+	}
+	//! Read a frame from the wire. Returns false if `len` doesn't match; doesn't check the CRC.
+	bool fromWire(const uint8_t* buf, size_t len) {
+		if(len < BASE_LENGTH || len > sizeof(MFECPacket)) return false;
+		memset((uint8_t*)this, 0, sizeof(*this));
+		memcpy((uint8_t*)this, buf, len-1);
+		crc = buf[len-1];
+		return wireLength() == len;
+	}
+	uint8_t calculateCRC() const { return calculateCRC7((const uint8_t*)this, wireLength()-1); }
 };
 
 static const uint8_t MAX_SEQUENCE_NUMBER = 8;
@@ -356,9 +609,28 @@ struct MPacketFrame {
 	uint8_t crc;
 };
 
+/**
+ * Human readable packet format, "[" + wire bytes in lowercase hex + "]", for debugging and logging.
+ * 
+ * These work on caller buffers without allocating, and don't print anything. `serializePacket()` writes
+ * a NUL-terminated string and returns its length, or 0 if `size` is too small (`MAX_SERIALIZED_LENGTH`+1
+ * is always enough). `deserializePacket()` takes the string without NUL, and returns false if the format,
+ * the length for the packet type or the CRC is wrong.
+ */
+static const uint8_t MAX_SERIALIZED_LENGTH = 2*sizeof(MPacket) + 2;
+size_t serializePacket(const MPacket& packet, char* buf, size_t size);
+bool deserializePacket(MPacket& packet, const char* str, size_t len);
+//! Allocating convenience versions of the above.
 std::string serializePacket(const MPacket& packet);
 bool deserializePacket(MPacket &packet, const std::string& str);
 
+//! Write `len` bytes as 2*`len` lowercase hex characters, without NUL.
+void hexEncode(const uint8_t* in, size_t len, char* out);
+//! Read 2*`len` hex characters (either case) into `len` bytes. Returns false if any character isn't hex.
+bool hexDecode(const char* in, size_t len, uint8_t* out);
+//! Value of a hex digit, or 0xff.
+uint8_t hexNibble(char c);
+
 }; // namespace rmt
 }; // namespace bb
 
@@ -0,0 +1,238 @@
+#if !defined(BBRMPACKETVIEW_H)
+#define BBRMPACKETVIEW_H
+
+#include "BBRMPacket.h"
+#include <stddef.h>
+
+namespace bb {
+namespace rmt {
+
+/**
+ * Read-only view of a Monaco packet in a byte buffer, eg. the one a radio driver hands over.
+ *
+ * All fields are read with explicit byte and bit offsets rather than through the `MPacket` bitfields, so the view
+ * doesn't depend on the compiler's bitfield layout or byte order, and works on buffers of any alignment. This allows
+ * validating and dispatching a packet in place, without first copying it into an `MPacket`. The offsets are those
+ * of the `MPacket` layout as GCC has always produced it on our (little-endian) targets:
+ *
+ *     byte 0        type (bit 0..1), source (bit 2..3), seqnum (bit 4..6), extended (bit 7)
+ *     byte 1..16    payload -- control packets: see MCONTROL_AXIS_FIELDS, primary is bit 103, keyframe id in
+ *                   byte 14, sequence extension in bits 0..3 of byte 15
+ *     byte 17       CRC-7 over bytes 0..16
+ *
+ * Control packets with extended set are either shorter delta packets (see `MControlDelta`), or longer aggregate
+ * frames (see `MAggregatePacket`) or FEC frames (see `MFECPacket`), told apart by their length. Config packets with
+ * extended set are manifest frames, the answer to `MConfigPacket::CONFIG_GET_MANIFEST`, of any length up to
+ * `MANIFEST_MAX_LENGTH`:
+ *
+ *     byte 0        header as above
+ *     byte 1        CONFIG_GET_MANIFEST (bit 0..5), CONFIG_REPLY_OK (bit 6..7)
+ *     byte 2, 3     number of this frame, number of frames
+ *     byte 4        number of inputs
+ *     byte 5..      one entry per input: its `MConfigPacket::MixPacket`, name length, name without terminator
+ *
+ * The CRC is always the last byte.
+ */
+class MPacketView {
+public:
+    static const uint8_t LENGTH = 18;
+    static const uint8_t PAYLOAD_OFFSET = 1;
+    static const uint8_t PAYLOAD_LENGTH = 16;
+    static const uint8_t CRC_OFFSET = 17;
+    static const uint8_t PRIMARY_BYTE = PAYLOAD_OFFSET + 12;
+    static const uint8_t PRIMARY_BIT = 7;
+    static const uint8_t AGGREGATE_LENGTH = sizeof(MAggregatePacket);
+    static const uint8_t FEC_MAX_LENGTH = sizeof(MFECPacket);
+    static const uint8_t MANIFEST_HEADER_LENGTH = 5;
+    static const uint8_t MANIFEST_ENTRY_MAX_LENGTH = sizeof(MConfigPacket::MixPacket) + 1 + NAME_MAXLEN;
+    //! Shortest frame length limit that still fits any entry; links with less fall back to one input at a time.
+    static const uint8_t MANIFEST_MIN_MAX_LENGTH = MANIFEST_HEADER_LENGTH + MANIFEST_ENTRY_MAX_LENGTH + 1;
+    //! Fits into an XBee payload with the longest integrity tag.
+    static const uint8_t MANIFEST_MAX_LENGTH = 96;
+    //! Longest frame of any kind -- size receive buffers for this.
+    static const uint8_t MAX_LENGTH = MANIFEST_MAX_LENGTH;
+
+    MPacketView(const uint8_t* buf, size_t len): buf_(buf), len_(len) {}
+
+    const uint8_t* data() const { return buf_; }
+    size_t length() const { return len_; }
+
+    bool validLength() const {
+        if(len_ == 0) return false;
+        if(isManifest()) return validManifestLength();
+        if(type() != MPacket::PACKET_TYPE_CONTROL || !extended()) return len_ == size_t(LENGTH);
+        if(len_ == size_t(AGGREGATE_LENGTH)) return true;
+        if(len_ > size_t(LENGTH)) return len_ >= size_t(MFECPacket::BASE_LENGTH) && len_ <= size_t(FEC_MAX_LENGTH) &&
+                                         len_ == size_t(MFECPacket::wireLength(fecChanged()));
+        if(len_ < size_t(DELTA_MIN_LENGTH) || len_ == size_t(LENGTH)) return false;
+        return len_ == size_t(DELTA_MIN_LENGTH + MControlDelta::valueBytes(deltaChanged()));
+    }
+    //! Only meaningful if `validLength()`.
+    bool validCRC() const { return calculateCRC() == crc(); }
+    bool valid() const { return validLength() && validCRC(); }
+
+    // The accessors below require validLength().
+    MPacket::PacketType type() const { return MPacket::PacketType(buf_[0] & 0x3); }
+    MPacket::PacketSource source() const { return MPacket::PacketSource((buf_[0] >> 2) & 0x3); }
+    uint8_t seqnum() const { return (buf_[0] >> 4) & 0x7; }
+    bool extended() const { return (buf_[0] >> 7) & 1; }
+    bool isDelta() const { return type() == MPacket::PACKET_TYPE_CONTROL && extended() && len_ < size_t(LENGTH); }
+    bool isAggregate() const { return type() == MPacket::PACKET_TYPE_CONTROL && extended() && len_ == size_t(AGGREGATE_LENGTH); }
+    bool isFEC() const { return type() == MPacket::PACKET_TYPE_CONTROL && extended() && len_ > size_t(LENGTH) && !isAggregate(); }
+    bool isManifest() const { return type() == MPacket::PACKET_TYPE_CONFIG && extended(); }
+    //! Whether this is a full or delta packet, which `MPacket::fromWire()` can read, rather than another frame.
+    bool isMPacket() const { return len_ <= size_t(LENGTH) && !isManifest(); }
+    uint8_t crc() const { return buf_[len_-1]; }
+    uint8_t calculateCRC() const { return calculateCRC7(buf_, len_-1); }
+    const uint8_t* payload() const { return buf_ + PAYLOAD_OFFSET; }
+
+    // Delta control packets -- header only, use MPacket::fromWire() to get the values
+    static const uint8_t DELTA_MIN_LENGTH = 1 + MControlDelta::HEADER_LENGTH + 1;
+    uint8_t deltaKeyframe() const { return buf_[PAYLOAD_OFFSET]; }
+    uint32_t deltaChanged() const { 
+        return buf_[PAYLOAD_OFFSET+1] | (uint32_t(buf_[PAYLOAD_OFFSET+2]) << 8) | (uint32_t(buf_[PAYLOAD_OFFSET+3] & 0x7) << 16);
+    }
+    bool deltaPrimary() const { return (buf_[PAYLOAD_OFFSET+3] >> 7) & 1; }
+    uint8_t deltaSeqExt() const { return (buf_[PAYLOAD_OFFSET+3] >> 3) & 0xf; }
+
+    // FEC frames -- the previous frame's delta header starts where a full packet's CRC would be
+    uint32_t fecChanged() const {
+        return buf_[CRC_OFFSET+1] | (uint32_t(buf_[CRC_OFFSET+2]) << 8) | (uint32_t(buf_[CRC_OFFSET+3] & 0x7) << 16);
+    }
+
+    // Manifest frames
+    uint8_t manifestChunk() const { return buf_[2]; }
+    uint8_t manifestNumChunks() const { return buf_[3]; }
+    uint8_t manifestNumInputs() const { return buf_[4]; }
+    //! Read the entry at `offset` (start with `MANIFEST_HEADER_LENGTH`) and move `offset` past it. False at the end.
+    bool manifestEntry(uint8_t& offset, MConfigPacket::MixPacket& mix, MaxlenString& name) const {
+        if(offset + sizeof(mix) + 1 > len_ - 1) return false;
+        memcpy(&mix, buf_ + offset, sizeof(mix));
+        uint8_t nameLen = buf_[offset + sizeof(mix)];
+        if(nameLen > NAME_MAXLEN || offset + sizeof(mix) + 1 + nameLen > len_ - 1) return false;
+        name.zero();
+        memcpy(name.buf, buf_ + offset + sizeof(mix) + 1, nameLen);
+        offset += sizeof(mix) + 1 + nameLen;
+        return true;
+    }
+
+    // Full control packets
+    bool primary() const { return (buf_[PRIMARY_BYTE] >> PRIMARY_BIT) & 1; }
+    uint16_t rawAxis(uint8_t num) const { return MControlPacket::rawAxisFromBytes(payload(), num); }
+    void rawAxes(uint32_t raw[MControlPacket::NUM_AXES]) const { MControlAxisCodec<0>::decode(payload(), raw); }
+
+    /**
+     * The buffer as an `MPacket`, for code that works on the structs. No copy is made -- `MPacket` is packed,
+     * so any alignment is fine. Requires `validLength()` and `!isDelta()`: a delta packet is shorter than
+     * an `MPacket` and has its CRC elsewhere.
+     */
+    const MPacket& packet() const { return *(const MPacket*)buf_; }
+    //! The buffer as an `MAggregatePacket`, without a copy. Requires `validLength()` and `isAggregate()`.
+    const MAggregatePacket& aggregate() const { return *(const MAggregatePacket*)buf_; }
+
+protected:
+    bool validManifestLength() const {
+        if(len_ < size_t(MANIFEST_HEADER_LENGTH + 1) || len_ > size_t(MANIFEST_MAX_LENGTH)) return false;
+        size_t offset = MANIFEST_HEADER_LENGTH;
+        while(offset < len_ - 1) {
+            if(offset + sizeof(MConfigPacket::MixPacket) + 1 > len_ - 1) return false;
+            uint8_t nameLen = buf_[offset + sizeof(MConfigPacket::MixPacket)];
+            if(nameLen > NAME_MAXLEN) return false;
+            offset += sizeof(MConfigPacket::MixPacket) + 1 + nameLen;
+        }
+        return offset == len_ - 1;
+    }
+
+    const uint8_t* buf_;
+    size_t len_;
+};
+
+/**
+ * Writes a full Monaco packet into a byte buffer of `MPacketView::LENGTH` bytes, with the same explicit offsets as
+ * `MPacketView`. The result is byte-identical to the same packet built through the `MPacket` struct.
+ */
+class MPacketWriter: public MPacketView {
+public:
+    MPacketWriter(uint8_t* buf): MPacketView(buf, LENGTH), wbuf_(buf) {}
+
+    //! Zero the whole packet.
+    void clear() { memset(wbuf_, 0, LENGTH); }
+
+    void setHeader(MPacket::PacketType type, MPacket::PacketSource source, uint8_t seqnum) {
+        wbuf_[0] = (uint8_t(type) & 0x3) | ((uint8_t(source) & 0x3) << 2) | ((seqnum & 0x7) << 4);
+    }
+    uint8_t* payload() { return wbuf_ + PAYLOAD_OFFSET; }
+
+    //! Control payload: all axes (masked to their bit depths) and the primary flag.
+    void setControl(const uint32_t raw[MControlPacket::NUM_AXES], bool primary) {
+        memset(payload(), 0, sizeof(MControlPacket));
+        MControlAxisCodec<0>::encode(raw, payload());
+        if(primary) wbuf_[PRIMARY_BYTE] |= 1 << PRIMARY_BIT;
+    }
+
+    //! Compute and store the CRC. Call last.
+    void finish() { wbuf_[CRC_OFFSET] = calculateCRC(); }
+
+protected:
+    uint8_t* wbuf_;
+};
+
+/**
+ * Writes a manifest frame (see `MPacketView`) into a buffer of `MPacketView::MANIFEST_MAX_LENGTH` bytes.
+ */
+class MManifestWriter {
+public:
+    MManifestWriter(uint8_t* buf, uint8_t maxLength): buf_(buf), len_(MPacketView::MANIFEST_HEADER_LENGTH) {
+        maxLength_ = maxLength < MPacketView::MANIFEST_MAX_LENGTH ? maxLength : MPacketView::MANIFEST_MAX_LENGTH;
+    }
+
+    //! Bytes an entry with this name takes.
+    static uint8_t entryLength(const MaxlenString& name) { return sizeof(MConfigPacket::MixPacket) + 1 + nameLength(name); }
+
+    void setHeader(MPacket::PacketSource source, uint8_t seqnum, uint8_t chunk, uint8_t numChunks, uint8_t numInputs) {
+        buf_[0] = uint8_t(MPacket::PACKET_TYPE_CONFIG) | ((uint8_t(source) & 0x3) << 2) | ((seqnum & 0x7) << 4) | 0x80;
+        buf_[1] = uint8_t(MConfigPacket::CONFIG_GET_MANIFEST) | (uint8_t(MConfigPacket::CONFIG_REPLY_OK) << 6);
+        buf_[2] = chunk;
+        buf_[3] = numChunks;
+        buf_[4] = numInputs;
+    }
+    //! Whether an entry with this name fits into the frame.
+    bool fits(const MaxlenString& name) const { return len_ + entryLength(name) + 1 <= maxLength_; }
+    //! Append an entry. False if it doesn't fit.
+    bool add(const MConfigPacket::MixPacket& mix, const MaxlenString& name) {
+        if(!fits(name)) return false;
+        uint8_t nameLen = nameLength(name);
+        memcpy(buf_ + len_, &mix, sizeof(mix));
+        buf_[len_ + sizeof(mix)] = nameLen;
+        memcpy(buf_ + len_ + sizeof(mix) + 1, name.buf, nameLen);
+        len_ += sizeof(mix) + 1 + nameLen;
+        return true;
+    }
+    //! Append the CRC. Returns the frame length.
+    uint8_t finish() {
+        buf_[len_] = calculateCRC7(buf_, len_);
+        return len_ + 1;
+    }
+
+protected:
+    static uint8_t nameLength(const MaxlenString& name) {
+        uint8_t len = 0;
+        while(len < NAME_MAXLEN && name.buf[len] != 0) len++;
+        return len;
+    }
+
+    uint8_t* buf_;
+    uint8_t len_, maxLength_;
+};
+
+static_assert(sizeof(MPacket) == MPacketView::LENGTH, "MPacket layout doesn't match MPacketView");
+static_assert(sizeof(MAggregatePacket) == 3 + 2*sizeof(MControlPacket), "MAggregatePacket layout");
+static_assert(offsetof(MFECPacket, previous) == MPacketView::CRC_OFFSET, "MFECPacket layout");
+static_assert(sizeof(MFECPacket) == MFECPacket::BASE_LENGTH + MControlDelta::MAX_VALUE_BYTES, "MFECPacket layout");
+static_assert(MPacketView::MANIFEST_MAX_LENGTH >= MPacketView::FEC_MAX_LENGTH &&
+              MPacketView::MANIFEST_MAX_LENGTH >= MPacketView::MANIFEST_MIN_MAX_LENGTH, "MAX_LENGTH covers all frames");
+
+}; // rmt
+}; // bb
+
+#endif // BBRMPACKETVIEW_H
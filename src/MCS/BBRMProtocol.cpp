@@ -1,6 +1,7 @@
 #include "BBRMProtocol.h"
 #include "BBRMReceiver.h"
 #include "BBRMTransmitter.h"
+#include "../BBRLog.h"
 
 #include <limits.h> // for ULONG_MAX
 
@@ -19,7 +20,13 @@ using namespace bb::rmt;
 MProtocol::MProtocol(): packetReceivedCB_(nullptr) {
 	sentComealive_ = false;
 	pairingSecret_ = 0xbabeface;
+	source_ = MPacket::PACKET_SOURCE_LEFT_REMOTE;
+	primary_ = false;
+	extendedSequence_ = false;
+	integrity_ = INTEGRITY_CRC7;
+	manifestActive_ = false;
     seqnum_ = 0;
+	seqnumExt_ = 0;
 }
 
 bool MProtocol::serialize(StorageBlock& block) {
@@ -31,7 +38,9 @@ bool MProtocol::serialize(StorageBlock& block) {
 bool MProtocol::deserialize(StorageBlock& block) {
 	source_ = (MPacket::PacketSource)block.protocolSpecific[0];
 	primary_ = (block.protocolSpecific[1] != 0);
-	return Protocol::deserialize(block);
+	bool res = Protocol::deserialize(block);
+	pairedNodesChanged();
+	return res;
 }
 
 
@@ -50,22 +59,65 @@ Receiver* MProtocol::createReceiver() {
     return receiver_;
 }
 
+Receiver* MProtocol::createReceiver(MReceiver* receiver) {
+	if(receiver_ != nullptr && receiver_ != receiver) return nullptr;
+	receiver_ = receiver;
+	return receiver_;
+}
+
+bool MProtocol::incomingPacket(const NodeAddr& addr, const MPacketView& view) {
+	if(!view.validLength()) {
+		stats_.sizeErrors++;
+		return false;
+	}
+	if(!view.validCRC()) {
+		stats_.crcErrors++;
+		return false;
+	}
+	if(view.isAggregate()) return incomingAggregatePacket(addr, view.aggregate());
+	if(view.isManifest()) return incomingManifestPacket(addr, view);
+	if(view.isFEC()) { // CRC and padding are in different places for different lengths
+		MFECPacket packet;
+		packet.fromWire(view.data(), view.length());
+		return incomingFECPacket(addr, packet);
+	}
+	if(view.isDelta()) { // shorter than an MPacket, so we need a copy
+		MPacket packet;
+		packet.fromWire(view.data(), view.length());
+		return incomingPacket(addr, packet);
+	}
+	return incomingPacket(addr, view.packet());
+}
+
 bool MProtocol::incomingPacket(const NodeAddr& addr, const MPacket& packet) {
 	bool res;
 	MConfigPacket::ConfigReplyType reply = packet.payload.config.reply;
-	MPacket packet2 = packet;
+	MPacket packet2;
 
+	countReceived(addr, packet.type);
 	if(packetReceivedCB_ != nullptr) packetReceivedCB_(addr, packet);
 
 	switch(packet.type) {
 	case MPacket::PACKET_TYPE_CONTROL:
 		if(receiver_ == nullptr) {
-			printf("Got control packet from %s but we are not a receiver.\n", addr.toString().c_str());
+			BBR_LOGW("Got control packet from %s but we are not a receiver.\n", addr.toString().c_str());
+			stats_.packetsDropped++;
+			return false;
+		}
+		if(packet.extended ? packet.payload.delta.primary : packet.payload.control.primary) commHappened();
+		if(!trackSequence(addr, packet.source, packet.seqnum, packet.extended ? packet.payload.delta.seqExt : packet.payload.keyframe.seqExt)) {
 			return false;
 		}
-		if(packet.payload.control.primary) commHappened();
+#if defined(BBR_LATENCY_STATS)
+		LatencyStats::received(packet.source, packet.seqnum);
+#endif
 
-		return ((MReceiver*)receiver_)->incomingControlPacket(addr, packet.source, packet.seqnum, packet.payload.control);
+		if(packet.extended) {
+			if(((MReceiver*)receiver_)->incomingControlDelta(addr, packet.source, packet.seqnum, packet.payload.delta)) return true;
+			stats_.packetsDropped++; // missed the keyframe
+			return false;
+		}
+		return ((MReceiver*)receiver_)->incomingControlKeyframe(addr, packet.source, packet.seqnum, packet.payload.keyframe);
 		break;
 
 	case MPacket::PACKET_TYPE_STATE:
@@ -75,18 +127,20 @@ bool MProtocol::incomingPacket(const NodeAddr& addr, const MPacket& packet) {
 		break;
 
 	case MPacket::PACKET_TYPE_CONFIG:
-		printf("Config packet from %s\n", addr.toString().c_str());
+		BBR_LOGD("Config packet from %s\n", addr.toString().c_str());
 		if(reply == MConfigPacket::CONFIG_REPLY_ERROR || reply == MConfigPacket::CONFIG_REPLY_OK) {
-			printf("This is a Reply packet! Discarding.\n");
+			BBR_LOGD("This is a Reply packet! Discarding.\n");
+			stats_.packetsDropped++;
 			return false;
 		}
+		packet2 = packet; // the reply is built in place of the request
 		res = incomingConfigPacket(addr, packet.source, packet.seqnum, packet2.payload.config);
 		if(res == true) {
-			printf("Sending reply with OK flag set\n");
+			BBR_LOGD("Sending reply with OK flag set\n");
 			packet2.payload.config.reply = MConfigPacket::CONFIG_REPLY_OK;
 		}
 		else {
-			printf("Sending reply with ERROR flag set\n");
+			BBR_LOGD("Sending reply with ERROR flag set\n");
 			packet2.payload.config.reply = MConfigPacket::CONFIG_REPLY_ERROR;
 		}
 
@@ -98,7 +152,8 @@ bool MProtocol::incomingPacket(const NodeAddr& addr, const MPacket& packet) {
 		break;
 
 	default:
-		printf("Error: Unknown packet type %d\n", packet.type);
+		BBR_LOGW("Error: Unknown packet type %d\n", packet.type);
+		stats_.packetsDropped++;
 		return false;
 	}
 
@@ -107,13 +162,13 @@ bool MProtocol::incomingPacket(const NodeAddr& addr, const MPacket& packet) {
 
 bool MProtocol::incomingConfigPacket(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, MConfigPacket& packet) {
 	if(!isPairedAsConfigurator(addr)) {
-		printf("Warning: Shouldn't accept config packets from %s because it's not a configurator\n", addr.toString().c_str());
+		BBR_LOGW("Warning: Shouldn't accept config packets from %s because it's not a configurator\n", addr.toString().c_str());
 		//return false;
 	}
 
 	if(packet.type == packet.CONFIG_GET_NUM_INPUTS) {
 		if(receiver_ == nullptr) return false;
-		printf("Got request for num inputs, replying with %d\n", receiver_->numInputs());
+		BBR_LOGD("Got request for num inputs, replying with %d\n", receiver_->numInputs());
 		packet.cfgPayload.count.count = receiver_->numInputs();
 		return true;
 	}
@@ -123,7 +178,7 @@ bool MProtocol::incomingConfigPacket(const NodeAddr& addr, MPacket::PacketSource
 		if(receiver_->numInputs() <= packet.cfgPayload.name.index) return false;
 		const std::string& name = receiver_->inputName(packet.cfgPayload.name.index);
 		packet.cfgPayload.name.name = name;
-		printf("Got request for input #%d, replying with \"%s\"\n", packet.cfgPayload.name.index, name.c_str());
+		BBR_LOGD("Got request for input #%d, replying with \"%s\"\n", packet.cfgPayload.name.index, name.c_str());
 		return true;
 	}
 
@@ -131,7 +186,16 @@ bool MProtocol::incomingConfigPacket(const NodeAddr& addr, MPacket::PacketSource
 		if(receiver_ == nullptr) return false;
 		if(receiver_->numInputs() <= packet.cfgPayload.mix.input) return false;
 		axisMixToMixPacket(packet.cfgPayload.mix.input, receiver_->mixForInput(packet.cfgPayload.mix.input), packet.cfgPayload.mix);
-		printf("Got request for mix #%d, replying with mix", packet.cfgPayload.mix.input);
+		BBR_LOGD("Got request for mix #%d, replying with mix\n", packet.cfgPayload.mix.input);
+		return true;
+	}
+
+	if(packet.type == packet.CONFIG_GET_MANIFEST) {
+		uint8_t numChunks = sendManifest(addr, packet.cfgPayload.manifest);
+		if(numChunks == 0) return false;
+		BBR_LOGD("Got request for manifest, sent frames %d..%d of %d\n", packet.cfgPayload.manifest.firstChunk,
+		         packet.cfgPayload.manifest.lastChunk < numChunks ? packet.cfgPayload.manifest.lastChunk : numChunks-1, numChunks);
+		packet.cfgPayload.count.count = numChunks;
 		return true;
 	}
 
@@ -141,9 +205,8 @@ bool MProtocol::incomingConfigPacket(const NodeAddr& addr, MPacket::PacketSource
 		AxisMix mix;
 		InputID input;
 		mixPacketToAxisMix(packet.cfgPayload.mix, input, mix);
-		receiver_->setMix(input, mix);
-		printf("Got request to set mix for #%d", input);
-		return true;
+		BBR_LOGD("Got request to set mix for #%d\n", input);
+		return receiver_->setMix(input, mix);
 	}
 
 	return false;
@@ -157,7 +220,7 @@ bool MProtocol::incomingPairingPacket(const NodeAddr& addr, MPacket::PacketSourc
 
 		// FIXME filter for builder ID
 
-		printf("Replying to %s (\"%s\") with broadcast pairing packet\n", 
+		BBR_LOGI("Replying to %s (\"%s\") with broadcast pairing packet\n", 
 			          addr.toString().c_str(), std::string(packet.pairingPayload.discovery.name).c_str());
 		MPacket reply;
 		reply.source = source_;
@@ -173,9 +236,9 @@ bool MProtocol::incomingPairingPacket(const NodeAddr& addr, MPacket::PacketSourc
 		p.pairingPayload.discovery.name = nodeName_;
 
 		reply.seqnum = seqnum_;
-		seqnum_ = (seqnum_ + 1) % MAX_SEQUENCE_NUMBER;
+		bumpSeqnum();
 		
-		bb::rmt::printf("Broadcasting PAIRING_DISCOVERY_REPLY packet\n");
+		BBR_LOGD("Broadcasting PAIRING_DISCOVERY_REPLY packet\n");
 		sendBroadcastPacket(reply);
 		return true;
 	}
@@ -183,12 +246,12 @@ bool MProtocol::incomingPairingPacket(const NodeAddr& addr, MPacket::PacketSourc
 	if(packet.type == MPairingPacket::PAIRING_DISCOVERY_REPLY) {
 		for(auto& n: discoveredNodes_) {
 			if(n.addr == addr) {
-				bb::rmt::printf("Already have node %s\n", addr.toString().c_str());
+				BBR_LOGD("Already have node %s\n", addr.toString().c_str());
 				return true;
 			}
 		}
 
-		bb::rmt::printf("Received PAIRING_DISCOVERY_REPLY packet from %s\n", addr.toString().c_str());
+		BBR_LOGD("Received PAIRING_DISCOVERY_REPLY packet from %s\n", addr.toString().c_str());
 
 		NodeDescription descr;
 		descr.addr = addr;
@@ -199,12 +262,12 @@ bool MProtocol::incomingPairingPacket(const NodeAddr& addr, MPacket::PacketSourc
 		descr.protoSpecific = 0x0;
 
 		if(!descr.isConfigurator && !descr.isTransmitter && !descr.isReceiver) {
-			bb::rmt::printf("Node \"%s\" at %s is neither configurator nor receiver nor transmitter. Ignoring.\n",
+			BBR_LOGW("Node \"%s\" at %s is neither configurator nor receiver nor transmitter. Ignoring.\n",
 			                std::string(descr.name).c_str(), addr.toString().c_str());
 			return false;
 		} 
 
-		bb::rmt::printf("Discovered \"%s\" at %s (configurator: %s receiver: %s transmitter: %s).\n",
+		BBR_LOGI("Discovered \"%s\" at %s (configurator: %s receiver: %s transmitter: %s).\n",
 					std::string(descr.name).c_str(), addr.toString().c_str(),
 					descr.isConfigurator ? "yes" : "no",
 					descr.isReceiver ? "yes" : "no",
@@ -215,11 +278,11 @@ bool MProtocol::incomingPairingPacket(const NodeAddr& addr, MPacket::PacketSourc
 
 	if(packet.type == MPairingPacket::PAIRING_REQUEST) {
 		if(!acceptsPairingRequests()) {
-			printf("Received pairing request but not in pairing mode. Ignoring.\n");
+			BBR_LOGW("Received pairing request but not in pairing mode. Ignoring.\n");
 			return false;
 		}
 
-		bb::rmt::printf("Received PAIRING_REQUEST packet from %s\n", addr.toString().c_str());
+		BBR_LOGI("Received PAIRING_REQUEST packet from %s\n", addr.toString().c_str());
 
 		const MPairingPacket::PairingRequest& r = packet.pairingPayload.request;
 		
@@ -227,10 +290,15 @@ bool MProtocol::incomingPairingPacket(const NodeAddr& addr, MPacket::PacketSourc
 		reply.source = source_;
 		reply.type = MPacket::PACKET_TYPE_PAIRING;
 		reply.payload.pairing.type = MPairingPacket::PAIRING_REPLY;
+		reply.payload.pairing.pairingPayload.reply.capabilitiesMagic = MPairingPacket::CAPABILITIES_MAGIC;
+		reply.payload.pairing.pairingPayload.reply.capabilities = capabilities();
+		MIntegrity integrity = integrity_;
+		if(maxWireLength() < MPacketView::LENGTH + integrityTagLength(integrity)) integrity = INTEGRITY_CRC7;
+		reply.payload.pairing.pairingPayload.reply.integrity = integrity;
 		
 		// Secret invalid? ==> error
 		if(r.pairingSecret != pairingSecret_) {
-			printf("Invalid secret.\n");
+			BBR_LOGW("Invalid secret.\n");
 			reply.payload.pairing.pairingPayload.reply.res = MPairingPacket::PAIRING_REPLY_INVALID_SECRET;
 			sendPacket(addr, reply);
 			return true;
@@ -238,7 +306,7 @@ bool MProtocol::incomingPairingPacket(const NodeAddr& addr, MPacket::PacketSourc
 
 		// Pairing request nonsensical? ==> error
 		if(!r.pairAsConfigurator && !r.pairAsReceiver && !r.pairAsTransmitter) {
-			printf("Received pairing request but as neither configurator nor receiver nor transmitter.\n");
+			BBR_LOGW("Received pairing request but as neither configurator nor receiver nor transmitter.\n");
 			reply.payload.pairing.pairingPayload.reply.res = MPairingPacket::PAIRING_REPLY_INVALID_ARGUMENT;
 			sendPacket(addr, reply);
 			return true;
@@ -247,7 +315,7 @@ bool MProtocol::incomingPairingPacket(const NodeAddr& addr, MPacket::PacketSourc
 		// Already have this node? ==> error
 		for(auto& n: pairedNodes_) {
 			if(n.addr == addr) {
-				printf("Already paired to %s.\n", addr.toString().c_str());
+				BBR_LOGW("Already paired to %s.\n", addr.toString().c_str());
 				reply.payload.pairing.pairingPayload.reply.res = MPairingPacket::PAIRING_REPLY_ALREADY_PAIRED;
 				sendPacket(addr, reply);
 				return true;
@@ -260,8 +328,10 @@ bool MProtocol::incomingPairingPacket(const NodeAddr& addr, MPacket::PacketSourc
 		descr.isConfigurator = packet.pairingPayload.request.pairAsConfigurator;
 		descr.isReceiver = packet.pairingPayload.request.pairAsReceiver;
 		descr.isTransmitter = packet.pairingPayload.request.pairAsTransmitter;
+		descr.protoSpecific = uint16_t(integrity) << INTEGRITY_SHIFT;
 		
 		Protocol::pairWith(descr);
+		pairedNodesChanged();
 		
 		reply.payload.pairing.pairingPayload.reply.res = MPairingPacket::PAIRING_REPLY_OK;
 		sendPacket(addr, reply);
@@ -269,17 +339,81 @@ bool MProtocol::incomingPairingPacket(const NodeAddr& addr, MPacket::PacketSourc
 	}
 
 	if(packet.type == MPairingPacket::PAIRING_COMEALIVE) {
-		bb::rmt::printf("Received COMEALIVE packet from %s\n", addr.toString().c_str());
+		BBR_LOGI("Received COMEALIVE packet from %s\n", addr.toString().c_str());
+		resetSequence(addr);
 		if(nodeCameAliveCB_ != nullptr) {
 			nodeCameAliveCB_(addr, packet);
 		}
 		return true;
 	}
 
-	printf("Unknown pairing packet type %d\n", packet.type);
+	BBR_LOGW("Unknown pairing packet type %d\n", packet.type);
 	return false;
 }
 
+bool MProtocol::incomingAggregatePacket(const NodeAddr& addr, const MAggregatePacket& packet) {
+	// No packetReceivedCB_ call -- there is no MPacket to hand over
+	countReceived(addr, packet.type);
+	if(receiver_ == nullptr) {
+		BBR_LOGW("Got aggregate control packet from %s but we are not a receiver.\n", addr.toString().c_str());
+		stats_.packetsDropped++;
+		return false;
+	}
+	commHappened();
+	if(!trackSequence(addr, packet.source, packet.seqnum, packet.seqExt)) return false;
+#if defined(BBR_LATENCY_STATS)
+	LatencyStats::received(packet.source, packet.seqnum);
+#endif
+	return ((MReceiver*)receiver_)->incomingControlPair(addr, packet.source, packet.seqnum, packet.control);
+}
+
+bool MProtocol::incomingFECPacket(const NodeAddr& addr, const MFECPacket& packet) {
+	countReceived(addr, packet.type);
+	if(receiver_ == nullptr) {
+		BBR_LOGW("Got FEC control packet from %s but we are not a receiver.\n", addr.toString().c_str());
+		stats_.packetsDropped++;
+		return false;
+	}
+	if(packet.current.control.primary) commHappened();
+	if(!trackSequence(addr, packet.source, packet.seqnum, packet.current.seqExt)) return false;
+#if defined(BBR_LATENCY_STATS)
+	LatencyStats::received(packet.source, packet.seqnum);
+#endif
+	bool recovered = false;
+	bool res = ((MReceiver*)receiver_)->incomingControlFEC(addr, packet.source, packet.seqnum, packet, recovered);
+	if(recovered) countRecovered(addr);
+	return res;
+}
+
+bool MProtocol::incomingManifestPacket(const NodeAddr& addr, const MPacketView& view) {
+	countReceived(addr, MPacket::PACKET_TYPE_CONFIG);
+	uint8_t chunk = view.manifestChunk(), numChunks = view.manifestNumChunks();
+	if(!manifestActive_ || addr != manifestAddr_ || chunk >= numChunks) {
+		BBR_LOGW("Got manifest frame from %s that we didn't ask for.\n", addr.toString().c_str());
+		stats_.packetsDropped++;
+		return false;
+	}
+	if(manifestChunks_.size() != numChunks) manifestChunks_.assign(numChunks, false);
+
+	std::vector<std::string>& names = inputs_[addr];
+	if(names.size() != view.manifestNumInputs()) names.resize(view.manifestNumInputs());
+	MixManager& mgr = mixManager(addr);
+
+	uint8_t offset = MPacketView::MANIFEST_HEADER_LENGTH;
+	MConfigPacket::MixPacket mp;
+	MaxlenString name;
+	while(view.manifestEntry(offset, mp, name)) {
+		InputID input;
+		AxisMix mix;
+		mixPacketToAxisMix(mp, input, mix);
+		if(input >= names.size()) continue;
+		names[input] = name;
+		mgr.setMix(input, mix);
+	}
+	manifestChunks_[chunk] = true;
+	return true;
+}
+
 bool MProtocol::incomingStatePacket(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MStatePacket& s) {
 	Telemetry telem;
 
@@ -357,7 +491,7 @@ bool MProtocol::pairWith(const NodeDescription& descr) {
 	MPacket pairingReplyPacket;
 	NodeAddr pairingReplyAddr;
 	NodeAddr addr = descr.addr;
-	std::function<bool(const MPacket&, const NodeAddr&)> fn = [addr](const MPacket& p, const NodeAddr& a) {
+	Callback<bool(const MPacket&, const NodeAddr&)> fn = [addr](const MPacket& p, const NodeAddr& a) {
 			return p.type == p.PACKET_TYPE_PAIRING &&
 					p.payload.pairing.type == MPairingPacket::PAIRING_REPLY &&
 					a == addr; 
@@ -375,6 +509,26 @@ bool MProtocol::pairWith(const NodeDescription& descr) {
 		return true;
 	} 
 
+	// What the node can receive, and the integrity check it wants. Replies from older nodes have undefined bytes
+	// here, hence the magic.
+	NodeDescription paired = descr;
+	paired.protoSpecific = 0;
+	if(r.capabilitiesMagic == MPairingPacket::CAPABILITIES_MAGIC) {
+		MIntegrity integrity = MIntegrity(r.integrity);
+		if(integrity > INTEGRITY_CRC32C || maxWireLength() < MPacketView::LENGTH + integrityTagLength(integrity)) {
+			printf("Node wants integrity check %d, which we can't do. Not pairing.\n", r.integrity);
+			return false;
+		}
+		paired.protoSpecific = (r.capabilities & CAPABILITY_MASK) | (uint16_t(integrity) << INTEGRITY_SHIFT);
+	}
+	printf("Node capabilities: 0x%x\n", paired.protoSpecific);
+	for(auto& n: pairedNodes_) {
+		if(n.addr == addr) {
+			n.protoSpecific = paired.protoSpecific; // re-pairing, eg. after a firmware update
+			pairedNodesChanged();
+		}
+	}
+
 	for(auto& n: discoveredNodes_) {
 		if(n.addr == addr) {
 			if(!n.isConfigurator && !n.isReceiver && !n.isTransmitter) {
@@ -384,7 +538,9 @@ bool MProtocol::pairWith(const NodeDescription& descr) {
 
 			printf("Pairing with %s (configurator: %d receiver: %d transmitter: %d)\n",
 			n.addr.toString().c_str(), n.isConfigurator, n.isReceiver, n.isTransmitter);
-			return Protocol::pairWith(descr); // this calls pairingCB_() too
+			bool res = Protocol::pairWith(paired); // this calls pairingCB_() too
+			pairedNodesChanged();
+			return res;
 		}
 	}
 
@@ -393,6 +549,86 @@ bool MProtocol::pairWith(const NodeDescription& descr) {
 }
 
 bool MProtocol::retrieveInputs(const NodeDescription& descr) {
+	NodeAddr addr = descr.addr;
+	uint8_t maxLength = manifestMaxLength(addr);
+	if(maxLength < MPacketView::MANIFEST_MIN_MAX_LENGTH) return retrieveInputsOneByOne(descr);
+
+	MPacket packet;
+	packet.source = source_;
+	packet.type = MPacket::PACKET_TYPE_CONFIG;
+	MConfigPacket& c = packet.payload.config;
+	c.type = MConfigPacket::CONFIG_GET_MANIFEST;
+	c.reply = MConfigPacket::CONFIG_TRANSMIT_REPLY;
+	c.cfgPayload.manifest.maxLength = maxLength;
+	c.cfgPayload.manifest.firstChunk = 0;
+	c.cfgPayload.manifest.lastChunk = 0xff;
+
+	printf("MProtocol: Retrieve Inputs in %s\n", addr.toString().c_str());
+
+	mixManager(addr).clearMixes();
+	inputs_[addr].clear();
+	manifestAddr_ = addr;
+	manifestChunks_.clear();
+	manifestActive_ = true;
+
+	Callback<bool(const MPacket&, const NodeAddr&)> fn = [addr](const MPacket& p, const NodeAddr& a) {
+		return a == addr && 
+		       p.type == p.PACKET_TYPE_CONFIG && 
+			   p.payload.config.type == MConfigPacket::CONFIG_GET_MANIFEST &&
+			   (p.payload.config.reply == MConfigPacket::CONFIG_REPLY_OK ||
+			    p.payload.config.reply == MConfigPacket::CONFIG_REPLY_ERROR);
+	};
+
+	// The frames come before the reply. Ask again for the ones that got lost, or for all if the reply got lost too.
+	// Give up after three requests in a row that brought nothing new.
+	bool complete = false;
+	unsigned int have = 0;
+	for(uint8_t fruitless=0; fruitless<3 && !complete; ) {
+		sendPacket(addr, packet);
+
+		MPacket replyPacket;
+		NodeAddr replyAddr;
+		bool replied = waitForPacket(fn, replyAddr, replyPacket, true, 0.5);
+		if(replied && replyPacket.payload.config.reply == MConfigPacket::CONFIG_REPLY_ERROR) {
+			manifestActive_ = false;
+			printf("Node doesn't send manifests, retrieving inputs one by one.\n");
+			return retrieveInputsOneByOne(descr);
+		}
+		if(replied && manifestChunks_.size() != replyPacket.payload.config.cfgPayload.count.count) {
+			manifestChunks_.assign(replyPacket.payload.config.cfgPayload.count.count, false); // all frames lost
+		}
+
+		int first = -1, last = -1;
+		unsigned int had = have;
+		have = 0;
+		for(unsigned int i=0; i<manifestChunks_.size(); i++) {
+			if(manifestChunks_[i]) {
+				have++;
+				continue;
+			}
+			if(first < 0) first = i;
+			last = i;
+		}
+		if(have > had) fruitless = 0;
+		else fruitless++;
+		if(manifestChunks_.size() != 0 && first < 0) {
+			complete = true;
+		} else if(manifestChunks_.size() != 0) {
+			c.cfgPayload.manifest.firstChunk = first;
+			c.cfgPayload.manifest.lastChunk = last;
+		}
+	}
+	manifestActive_ = false;
+
+	if(!complete) {
+		printf("Timed out waiting for manifest.\n");
+		return false;
+	}
+	printf("Received manifest -- %d inputs in %d frames\n", int(inputs_[addr].size()), int(manifestChunks_.size()));
+	return true;
+}
+
+bool MProtocol::retrieveInputsOneByOne(const NodeDescription& descr) {
 	MPacket packet;
 	packet.source = source_;
 	packet.type = MPacket::PACKET_TYPE_CONFIG;
@@ -408,7 +644,7 @@ bool MProtocol::retrieveInputs(const NodeDescription& descr) {
 	MPacket replyPacket;
 	NodeAddr replyAddr;
 	NodeAddr addr = descr.addr;
-	std::function<bool(const MPacket&, const NodeAddr&)> fn = [addr](const MPacket& p, const NodeAddr& a) {
+	Callback<bool(const MPacket&, const NodeAddr&)> fn = [addr](const MPacket& p, const NodeAddr& a) {
 		return a == addr && 
 		       p.type == p.PACKET_TYPE_CONFIG && 
 			   p.payload.config.type == MConfigPacket::CONFIG_GET_NUM_INPUTS &&
@@ -435,7 +671,7 @@ bool MProtocol::retrieveInputs(const NodeDescription& descr) {
 
 		sendPacket(descr.addr, packet);
 		
-		std::function<bool(const MPacket&, const NodeAddr&)> fnName = [addr](const MPacket& p, const NodeAddr& a) {
+		Callback<bool(const MPacket&, const NodeAddr&)> fnName = [addr](const MPacket& p, const NodeAddr& a) {
 			return a == addr && 
 			       p.type == p.PACKET_TYPE_CONFIG && 
 				   p.payload.config.type == MConfigPacket::CONFIG_GET_INPUT_NAME &&
@@ -456,7 +692,7 @@ bool MProtocol::retrieveInputs(const NodeDescription& descr) {
 
 		sendPacket(descr.addr, packet);
 		
-		std::function<bool(const MPacket&, const NodeAddr&)> fnMix = [addr](const MPacket& p, const NodeAddr& a) {
+		Callback<bool(const MPacket&, const NodeAddr&)> fnMix = [addr](const MPacket& p, const NodeAddr& a) {
 			return a == addr && 
 			       p.type == p.PACKET_TYPE_CONFIG && 
 				   p.payload.config.type == MConfigPacket::CONFIG_GET_MIX &&
@@ -492,14 +728,15 @@ bool MProtocol::sendMixes(const NodeDescription& descr) {
 	c.type = MConfigPacket::CONFIG_SET_MIX;
 	c.reply = MConfigPacket::CONFIG_TRANSMIT_REPLY;
 
-	for(auto& m: mgr.mixes()) {
-		Interpolator i1 = m.second.interp1;
-		Interpolator i2 = m.second.interp2;
-		AxisID a1 = m.second.axis1;
-		AxisID a2 = m.second.axis2;
-		MixType t = m.second.mixType;
+	for(uint8_t m=0; m<mgr.numMixes(); m++) {
+		const AxisMix& mix = mgr.mixAtIndex(m);
+		Interpolator i1 = mix.interp1;
+		Interpolator i2 = mix.interp2;
+		AxisID a1 = mix.axis1;
+		AxisID a2 = mix.axis2;
+		MixType t = mix.mixType;
 
-		c.cfgPayload.mix.input = m.first;
+		c.cfgPayload.mix.input = mgr.inputForMixIndex(m);
 		c.cfgPayload.mix.a1 = a1;
 		c.cfgPayload.mix.a2 = a2;
 		c.cfgPayload.mix.i1_0 = i1.i0;
@@ -535,6 +772,164 @@ bool MProtocol::step() {
 
 void MProtocol::bumpSeqnum() {
 	seqnum_ = (seqnum_ + 1) % MAX_SEQUENCE_NUMBER;
+	if(seqnum_ == 0) seqnumExt_ = (seqnumExt_ + 1) & 0xf;
+}
+
+void MProtocol::setExtendedSequence(bool ext) {
+	extendedSequence_ = ext;
+	seqTrackers_.clear();
+}
+
+void MProtocol::finishPacket(MPacket& packet) {
+	packet.seqnum = seqnum_;
+	packet.source = source_;
+	if(packet.type == MPacket::PACKET_TYPE_CONTROL) {
+		if(packet.extended) packet.payload.delta.seqExt = seqnumExt_;
+		else {
+			packet.payload.keyframe.seqExt = seqnumExt_;
+			packet.payload.keyframe.reserved = 0;
+		}
+	}
+	packet.crc = packet.calculateCRC();
+}
+
+void MProtocol::finishPacket(MAggregatePacket& packet) {
+	packet.seqnum = seqnum_;
+	packet.source = source_;
+	packet.seqExt = seqnumExt_;
+	packet.crc = packet.calculateCRC();
+}
+
+void MProtocol::finishPacket(MFECPacket& packet) {
+	packet.seqnum = seqnum_;
+	packet.source = source_;
+	packet.current.seqExt = seqnumExt_;
+	packet.current.reserved = 0;
+	packet.crc = packet.calculateCRC();
+}
+
+bool MProtocol::sendAggregatePacket(const NodeAddr& addr, MAggregatePacket& packet, bool bumpSeqnum) {
+	if(maxWireLength() < MPacketView::AGGREGATE_LENGTH) return false;
+	finishPacket(packet);
+	return sendFrame(addr, (const uint8_t*)&packet, sizeof(packet), bumpSeqnum);
+}
+
+bool MProtocol::sendFECPacket(const NodeAddr& addr, MFECPacket& packet, bool bumpSeqnum) {
+	finishPacket(packet);
+	uint8_t wire[sizeof(MFECPacket)];
+	uint8_t len = packet.toWire(wire);
+	return sendFrame(addr, wire, len, bumpSeqnum);
+}
+
+uint8_t MProtocol::manifestMaxLength(const NodeAddr& addr) {
+	uint8_t len = maxWireLength() - integrityTagLength(integrityFor(addr));
+	return len < MPacketView::MANIFEST_MAX_LENGTH ? len : MPacketView::MANIFEST_MAX_LENGTH;
+}
+
+uint8_t MProtocol::sendManifest(const NodeAddr& addr, const MConfigPacket::ManifestRequest& req) {
+	uint8_t maxLength = manifestMaxLength(addr);
+	if(req.maxLength < maxLength) maxLength = req.maxLength;
+	if(receiver_ == nullptr || maxLength < MPacketView::MANIFEST_MIN_MAX_LENGTH) return 0;
+
+	// Number the frames first -- each one carries the total. Same maxLength, same numbering.
+	uint8_t numInputs = receiver_->numInputs();
+	std::vector<uint8_t> firstInputs(1, 0);
+	uint8_t len = MPacketView::MANIFEST_HEADER_LENGTH;
+	MaxlenString name;
+	for(uint8_t i=0; i<numInputs; i++) {
+		name = receiver_->inputName(i);
+		uint8_t entryLength = MManifestWriter::entryLength(name);
+		if(len + entryLength + 1 > maxLength) {
+			firstInputs.push_back(i);
+			len = MPacketView::MANIFEST_HEADER_LENGTH;
+		}
+		len += entryLength;
+	}
+	uint8_t numChunks = firstInputs.size();
+
+	for(unsigned int chunk=req.firstChunk; chunk<=req.lastChunk && chunk<numChunks; chunk++) {
+		uint8_t wire[MPacketView::MANIFEST_MAX_LENGTH];
+		MManifestWriter writer(wire, maxLength);
+		writer.setHeader(source_, seqnum_, chunk, numChunks, numInputs);
+		uint8_t end = chunk+1 < numChunks ? firstInputs[chunk+1] : numInputs;
+		for(uint8_t i=firstInputs[chunk]; i<end; i++) {
+			MConfigPacket::MixPacket mp;
+			axisMixToMixPacket(i, receiver_->mixForInput(i), mp);
+			name = receiver_->inputName(i);
+			writer.add(mp, name);
+		}
+		len = writer.finish();
+		// Frames go out back to back; give a full send queue a moment before giving up on one
+		if(!sendFrame(addr, wire, len, true)) {
+			delay(2);
+			sendFrame(addr, wire, len, true);
+		}
+	}
+	return numChunks;
+}
+
+MIntegrity MProtocol::integrityFor(const NodeAddr& addr) {
+	for(auto& n: pairedNodes_) {
+		if(n.addr == addr) return MIntegrity((n.protoSpecific >> INTEGRITY_SHIFT) & 0x3);
+	}
+	return INTEGRITY_CRC7;
+}
+
+bool MProtocol::sendFrame(const NodeAddr& addr, const uint8_t* wire, uint8_t len, bool bumpSeqnum) {
+	// Pairing packets go without, so nodes can (re-)pair whatever they agreed before
+	MIntegrity integrity = MPacketView(wire, len).type() == MPacket::PACKET_TYPE_PAIRING ? INTEGRITY_CRC7 : integrityFor(addr);
+	if(integrity == INTEGRITY_CRC7) {
+		if(len > maxWireLength()) return false;
+		return sendWire(addr, wire, len, bumpSeqnum);
+	}
+
+	uint8_t tagged[MAX_TAGGED_LENGTH];
+	if(len > MPacketView::MAX_LENGTH) return false;
+	memcpy(tagged, wire, len);
+	len = appendIntegrityTag(integrity, tagged, len);
+	if(len > maxWireLength()) return false;
+	return sendWire(addr, tagged, len, bumpSeqnum);
+}
+
+bool MProtocol::checkIntegrity(const NodeAddr& addr, const uint8_t* wire, uint8_t& len) {
+	if(len == 0 || MPacketView(wire, len).type() == MPacket::PACKET_TYPE_PAIRING) return true;
+	if(checkIntegrityTag(integrityFor(addr), wire, len)) return true;
+	stats_.crcErrors++;
+	return false;
+}
+
+uint16_t MProtocol::capabilities() {
+	uint16_t caps = 0;
+	if(receiver_ != nullptr && maxWireLength() >= MPacketView::FEC_MAX_LENGTH) caps |= CAPABILITY_FEC;
+	return caps;
+}
+
+bool MProtocol::trackSequence(const NodeAddr& addr, uint8_t source, uint8_t seqnum, uint8_t seqExt) {
+	std::pair<NodeAddr,uint8_t> key(addr, source);
+	auto it = seqTrackers_.find(key);
+	if(it == seqTrackers_.end()) {
+		it = seqTrackers_.insert(std::make_pair(key, SequenceTracker(extendedSequence_ ? 7 : 3))).first;
+	}
+
+	uint16_t seq = extendedSequence_ ? (uint16_t(seqExt & 0xf) << 3) | seqnum : seqnum;
+	SequenceTracker::Loss loss;
+	SequenceTracker::Result res = it->second.track(seq, loss);
+	countSequence(addr, res, loss);
+	if(res == SequenceTracker::SEQ_NEW || !extendedSequence_) return true;
+	stats_.packetsDropped++;
+	return false;
+}
+
+void MProtocol::resetSequence(const NodeAddr& addr) {
+	for(auto it = seqTrackers_.begin(); it != seqTrackers_.end();) {
+		if(it->first.first == addr) it = seqTrackers_.erase(it);
+		else ++it;
+	}
+}
+
+void MProtocol::commTimedOut() {
+	seqTrackers_.clear();
+	Protocol::commTimedOut();
 }
 
 bool MProtocol::sendTelemetry(const Telemetry& telem) {
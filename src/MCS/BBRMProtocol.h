@@ -3,6 +3,9 @@
 
 #include "../BBRProtocol.h"
 #include "BBRMPacket.h"
+#include "BBRMPacketView.h"
+#include "BBRMIntegrity.h"
+#include "BBRMReceiver.h"
 
 namespace bb {
 namespace rmt {
@@ -15,6 +18,18 @@ public:
         RIGHT_TX = 1
     };
 
+    /**
+     * Optional features a node can receive, announced in its pairing reply and kept in the paired node's
+     * `NodeDescription::protoSpecific` (bits 0..10). Nodes that don't announce anything (eg. older firmware) get
+     * none of these.
+     */
+    enum Capability {
+        CAPABILITY_FEC = 0x0001 //!< Understands `MFECPacket` frames
+    };
+    static const uint16_t CAPABILITY_MASK = 0x07ff;
+    //! `NodeDescription::protoSpecific` bits 11..12 hold the `MIntegrity` agreed with the node when pairing.
+    static const uint8_t INTEGRITY_SHIFT = 11;
+
     MProtocol();
 
     virtual ProtocolType protocolType() { return INVALID_PROTOCOL; }
@@ -24,6 +39,8 @@ public:
 
     virtual Transmitter* createTransmitter(uint8_t transmitterType=0);
     virtual Receiver* createReceiver();
+    //! Use the given receiver (eg. an `MStaticReceiver`) instead of creating one. Returns nullptr if there already is another one.
+    virtual Receiver* createReceiver(MReceiver* receiver);
 
     virtual uint8_t numTransmitterTypes() { return 2; }
     virtual uint8_t numChannels(uint8_t transmitterType) { return 19; }
@@ -32,14 +49,51 @@ public:
     bool pairWith(const NodeDescription& descr);
 
     virtual bool receiverSideMixing() { return true; }
+    /**
+     * Fetch the node's inputs and mixes with one `MConfigPacket::CONFIG_GET_MANIFEST` request, answered with as few
+     * manifest frames as the link allows. Frames that got lost are asked for again. Over links that can't carry
+     * manifest frames, or from nodes that don't know them, falls back to one request per input name and mix.
+     */
     virtual bool retrieveInputs(const NodeDescription& descr);
     virtual bool retrieveMixes(const NodeDescription& descr);
 
     virtual bool step();
     virtual bool sendPacket(const NodeAddr& addr, MPacket& packet, bool bumpSeqnum=true) = 0;
     virtual bool sendBroadcastPacket(MPacket& packet, bool bumpSeqnum=true) = 0;
+    //! Longest frame the link can carry in one transmission. Links that can't carry more than an `MPacket` return that.
+    virtual uint8_t maxWireLength() { return MPacketView::LENGTH; }
+    //! Send an aggregate control frame. Only links with `maxWireLength()` >= `MPacketView::AGGREGATE_LENGTH` can.
+    bool sendAggregatePacket(const NodeAddr& addr, MAggregatePacket& packet, bool bumpSeqnum=true);
+    //! Send an FEC control frame. Fails if it is longer than `maxWireLength()`.
+    bool sendFECPacket(const NodeAddr& addr, MFECPacket& packet, bool bumpSeqnum=true);
+    //! What this node can receive, see `Capability`. Sent to nodes pairing with us.
+    virtual uint16_t capabilities();
+
+    /**
+     * Integrity check for nodes that pair with us from now on, on top of the packets' CRC-7 (see `MIntegrity`).
+     * Announced in the pairing reply, so the other node uses it too; existing pairings keep theirs. Only use this
+     * if all nodes that will pair with us are recent enough to understand it -- older ones get no reply they can
+     * read. Falls back to CRC-7 if the tag doesn't fit into `maxWireLength()`. Defaults to `INTEGRITY_CRC7`.
+     */
+    void setIntegrity(MIntegrity integrity) { integrity_ = integrity; }
+    MIntegrity integrity() { return integrity_; }
+    //! The integrity check agreed with the paired node `addr`. `INTEGRITY_CRC7` for unpaired nodes.
+    virtual MIntegrity integrityFor(const NodeAddr& addr);
+    //! Advance the sequence number. Transmitters call this once per transmission, not once per receiver.
     virtual void bumpSeqnum();
     virtual uint8_t seqnum() { return seqnum_; }
+    //! Number of times `seqnum()` wrapped, mod 16 -- the 4 bit extension carried by control frames.
+    uint8_t seqnumExt() { return seqnumExt_; }
+
+    /**
+     * Receivers: include the sequence extension of control frames (see `MControlKeyframe`) when tracking senders'
+     * sequence numbers. With 7 instead of 3 bits, bursts of up to 111 lost packets are measured correctly, rather
+     * than 4, and duplicate and late control frames are dropped. With 3 bits they are only counted: after a burst
+     * of 5 or more lost packets, good ones would look late. Only enable if all transmitters paired with us are
+     * recent enough to send the extension.
+     */
+    void setExtendedSequence(bool ext);
+    bool extendedSequence() { return extendedSequence_; }
 
     void sendComealive();
 
@@ -54,16 +108,21 @@ public:
 
     void setPairingSecret(uint32_t secret) { pairingSecret_ = secret; }
 
-    void setPacketReceivedCB(std::function<void(const NodeAddr&, const MPacket&)> cb) { packetReceivedCB_ = cb; }
-    void setNodeCameAliveCB(std::function<void(const NodeAddr&, const MPairingPacket&)> cb) { nodeCameAliveCB_ = cb; }
+    void setPacketReceivedCB(Callback<void(const NodeAddr&, const MPacket&)> cb) { packetReceivedCB_ = cb; }
+    void setNodeCameAliveCB(Callback<void(const NodeAddr&, const MPairingPacket&)> cb) { nodeCameAliveCB_ = cb; }
 
     bool receiveFromSerial(HardwareSerial *serial);
 
     virtual bool incomingPacket(const NodeAddr& addr, const MPacket& packet);
+    //! Check length and CRC of a packet still in the receive buffer, and dispatch it from there without copying.
+    virtual bool incomingPacket(const NodeAddr& addr, const MPacketView& view);
 	virtual bool incomingConfigPacket(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, MConfigPacket& packet);
 	virtual bool incomingPairingPacket(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MPairingPacket& packet);
 	virtual bool incomingStatePacket(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MStatePacket& packet);
-    virtual bool waitForPacket(std::function<bool(const MPacket&, const NodeAddr& )> fn, 
+	virtual bool incomingAggregatePacket(const NodeAddr& addr, const MAggregatePacket& packet);
+	virtual bool incomingFECPacket(const NodeAddr& addr, const MFECPacket& packet);
+	virtual bool incomingManifestPacket(const NodeAddr& addr, const MPacketView& view);
+    virtual bool waitForPacket(const Callback<bool(const MPacket&, const NodeAddr&)>& fn, 
                                NodeAddr& addr, MPacket& packet, 
                                bool handleOthers, float timeout) = 0;
 
@@ -74,14 +133,57 @@ public:
 
 protected:
     bool isPairedAsConfigurator(const NodeAddr& addr);
-
-    std::function<void(const NodeAddr&, const MPacket&)> packetReceivedCB_;
-    std::function<void(const NodeAddr&, const MPairingPacket&)> nodeCameAliveCB_;
+    //! Called whenever `pairedNodes_` changed, from the main loop.
+    virtual void pairedNodesChanged() {}
+    //! Forget every sender's sequence position -- after a silence, they may have restarted.
+    virtual void commTimedOut();
+    //! Forget the sequence positions of all sources at `addr`, eg. when it announces it restarted.
+    void resetSequence(const NodeAddr& addr);
+
+    //! Send wire bytes of a finished packet or frame, counting it and bumping the seqnum if it went out.
+    virtual bool sendWire(const NodeAddr& addr, const uint8_t* wire, uint8_t len, bool bumpSeqnum) { return false; }
+    //! Add the integrity tag for `addr`, if any, and `sendWire()`. Links' send functions go through here.
+    bool sendFrame(const NodeAddr& addr, const uint8_t* wire, uint8_t len, bool bumpSeqnum);
+    /**
+     * Check and strip the integrity tag of a frame from `addr`, before its length and CRC are checked. Call from
+     * the links' receive paths. Returns false, counting a CRC error, if the tag is missing or wrong.
+     */
+    bool checkIntegrity(const NodeAddr& addr, const uint8_t* wire, uint8_t& len);
+
+    //! Stamp source, sequence number (and its extension, on control frames) and CRC. Call from the send functions.
+    void finishPacket(MPacket& packet);
+    void finishPacket(MAggregatePacket& packet);
+    void finishPacket(MFECPacket& packet);
+    /**
+     * Track the sequence number of a control frame from `source` at `addr`, see `SequenceTracker`, and count the
+     * result. Every source numbers its frames separately, even when they share a link. With extended sequence
+     * numbers, returns false for duplicate and late frames -- they would set the inputs back to older values.
+     */
+    bool trackSequence(const NodeAddr& addr, uint8_t source, uint8_t seqnum, uint8_t seqExt);
+
+    //! Longest manifest frame that can go to `addr`, given the link and the integrity tag.
+    uint8_t manifestMaxLength(const NodeAddr& addr);
+    //! Send the manifest frames `req` asks for to `addr`. Returns the number of frames in the manifest, 0 if none.
+    uint8_t sendManifest(const NodeAddr& addr, const MConfigPacket::ManifestRequest& req);
+    //! `retrieveInputs()` the old way: one round trip for the number of inputs, and two per input.
+    bool retrieveInputsOneByOne(const NodeDescription& descr);
+
+    Callback<void(const NodeAddr&, const MPacket&)> packetReceivedCB_;
+    Callback<void(const NodeAddr&, const MPairingPacket&)> nodeCameAliveCB_;
 
     uint32_t pairingSecret_;
 	MPacket::PacketSource source_;
     bool primary_;
     bool sentComealive_;
+    bool extendedSequence_;
+    MIntegrity integrity_;
+    uint8_t seqnumExt_;
+    std::map<std::pair<NodeAddr,uint8_t>,SequenceTracker> seqTrackers_; // per address and packet source, step() context only
+
+    // Manifest being fetched by retrieveInputs(), filled in by incomingManifestPacket()
+    bool manifestActive_;
+    NodeAddr manifestAddr_;
+    std::vector<bool> manifestChunks_; // frames received
 
     std::string serialRecStr_;
 };
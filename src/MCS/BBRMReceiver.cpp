@@ -1,5 +1,7 @@
 #include "BBRMReceiver.h"
 #include "BBRTypes.h"
+#include "BBRLog.h"
+#include "BBRLatencyStats.h"
 
 using namespace bb;
 using namespace bb::rmt;
@@ -7,45 +9,177 @@ using namespace bb::rmt;
 bool MReceiver::incomingControlPacket(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MControlPacket& packet) {
     if(dataReceivedCB_ != nullptr) dataReceivedCB_(addr, seqnum, &packet, sizeof(packet));
 
-    for(uint8_t i = 0; i<inputs_.size(); i++) {
-        if(!hasMixForInput(i)) continue;
-        Input& inp = inputs_[i];
+    if(planVersion_ != version() || planNumInputs_ != inputs_.size()) buildDispatchPlan();
 
-        const AxisMix& mix = mixForInput(i);
-        AxisID axis1 = mix.axis1;
-        AxisID axis2 = mix.axis2;
+    uint32_t raw[MControlPacket::NUM_AXES+1];
+    packet.decodeAll(raw);
+    raw[ZERO_SLOT] = 0;
 
-        if(packet.primary && ((axis1 >= SECONDARY_ADD && axis1 != AXIS_INVALID) || (axis2 >= SECONDARY_ADD && axis2 != AXIS_INVALID))) {
-            //bb::rmt::printf("Secondary axis, but primary packet - not for us\n");
-            continue;
-        } else if(!packet.primary && (axis1 < SECONDARY_ADD || axis2 < SECONDARY_ADD)) {
-            //bb::rmt::printf("Primary axis, but secondary packet - not for us\n");
-            continue;
+    beginFrame();
+    const std::vector<DispatchEntry>& plan = packet.primary ? primaryPlan_ : secondaryPlan_;
+    for(const DispatchEntry& e: plan) {
+        float out;
+        if(e.compiled != nullptr) {
+            out = e.compiled->compute(raw[e.axis1], raw[e.axis2]);
+        } else {
+            float val1 = packet.getAxis(e.axis1, UNIT_UNITY);
+            float val2 = packet.getAxis(e.axis2, UNIT_UNITY);
+            out = e.mix->compute(val1, 0, 1, val2, 0, 1);
         }
 
-        if(axis1 >= SECONDARY_ADD && axis1 != AXIS_INVALID) {
-            axis1 -= SECONDARY_ADD;
-        }
-        if(axis2 >= SECONDARY_ADD && axis2 != AXIS_INVALID) {
-            axis2 -= SECONDARY_ADD;
-        }
+#if defined(BBR_LATENCY_STATS)
+        if(deliver(e.input, out)) LatencyStats::callbackFired();
+#else
+        deliver(e.input, out);
+#endif
+    }
+    finishFrame(addr, seqnum);
+#if defined(BBR_LATENCY_STATS)
+    LatencyStats::packetDone();
+#endif
+    if(dataFinishedCB_ != nullptr) dataFinishedCB_(addr, seqnum);
+    return true;
+}
 
-        float val1, val2;
+static float pairAxisValue(const MControlPair& pair, uint8_t slot) {
+    if(slot < MControlPacket::NUM_AXES) return pair.primary.getAxis(slot, UNIT_UNITY);
+    return pair.secondary.getAxis(slot - MControlPacket::NUM_AXES, UNIT_UNITY);
+}
+
+bool MReceiver::incomingControlPair(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MControlPair& pair) {
+    if(dataReceivedCB_ != nullptr) dataReceivedCB_(addr, seqnum, &pair, sizeof(pair));
+
+    if(planVersion_ != version() || planNumInputs_ != inputs_.size()) buildDispatchPlan();
 
-        val1 = packet.getAxis(axis1, UNIT_UNITY);
-        val2 = packet.getAxis(axis2, UNIT_UNITY);
-        //bb::rmt::printf("axis1: %d axis2: %d val1: %f val2: %f\n", axis1, axis2, val1, val2);
+    uint32_t raw[2*MControlPacket::NUM_AXES+1];
+    pair.primary.decodeAll(raw);
+    pair.secondary.decodeAll(raw + MControlPacket::NUM_AXES);
+    raw[PAIR_ZERO_SLOT] = 0;
 
-        float out = mix.compute(val1, 0, 1, val2, 0, 1);
+    beginFrame();
+    for(const DispatchEntry& e: pairPlan_) {
+        float out;
+        if(e.compiled != nullptr) {
+            out = e.compiled->compute(raw[e.axis1], raw[e.axis2]);
+        } else {
+            float val1 = pairAxisValue(pair, e.axis1);
+            float val2 = pairAxisValue(pair, e.axis2);
+            out = e.mix->compute(val1, 0, 1, val2, 0, 1);
+        }
 
-        inp.callback(out);
+#if defined(BBR_LATENCY_STATS)
+        if(deliver(e.input, out)) LatencyStats::callbackFired();
+#else
+        deliver(e.input, out);
+#endif
     }
+    finishFrame(addr, seqnum);
+#if defined(BBR_LATENCY_STATS)
+    LatencyStats::packetDone();
+#endif
     if(dataFinishedCB_ != nullptr) dataFinishedCB_(addr, seqnum);
     return true;
 }
 
+bool MReceiver::incomingControlKeyframe(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MControlKeyframe& keyframe) {
+    uint8_t s = source % NUM_SOURCES;
+    keyframes_[s] = keyframe.control;
+    keyframeIDs_[s] = keyframe.id;
+    haveKeyframe_[s] = true;
+    return incomingControlPacket(addr, source, seqnum, keyframe.control);
+}
+
+bool MReceiver::incomingControlDelta(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MControlDelta& delta) {
+    uint8_t s = source % NUM_SOURCES;
+    if(!haveKeyframe_[s] || keyframeIDs_[s] != delta.keyframe) return false;
+
+    uint32_t raw[MControlPacket::NUM_AXES];
+    keyframes_[s].decodeAll(raw);
+    delta.apply(raw);
+    MControlPacket packet;
+    packet.primary = delta.primary;
+    packet.encodeAll(raw);
+    return incomingControlPacket(addr, source, seqnum, packet);
+}
+
+bool MReceiver::incomingControlFEC(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MFECPacket& packet, bool& recovered) {
+    uint8_t s = source % NUM_SOURCES;
+    uint8_t id = packet.current.id;
+    recovered = false;
+    if(haveKeyframe_[s] && keyframeIDs_[s] == uint8_t(id - 2) && packet.previous.keyframe == uint8_t(id - 1)) {
+        uint32_t raw[MControlPacket::NUM_AXES];
+        packet.current.control.decodeAll(raw);
+        packet.previous.apply(raw);
+        MControlPacket previous;
+        previous.primary = packet.previous.primary;
+        previous.encodeAll(raw);
+        incomingControlPacket(addr, source, (seqnum - 1) & 0x7, previous);
+        recovered = true;
+    }
+    return incomingControlKeyframe(addr, source, seqnum, packet.current);
+}
+
+static uint8_t packetAxisIndex(AxisID axis) {
+    if(axis == AXIS_INVALID) return MControlPacket::NUM_AXES;
+    if(axis >= SECONDARY_ADD) axis -= SECONDARY_ADD;
+    if(axis >= MControlPacket::NUM_AXES) return MControlPacket::NUM_AXES;
+    return axis;
+}
+
+static uint8_t pairAxisIndex(AxisID axis) {
+    if(axis == AXIS_INVALID) return 2*MControlPacket::NUM_AXES;
+    uint8_t offset = 0;
+    if(axis >= SECONDARY_ADD) {
+        axis -= SECONDARY_ADD;
+        offset = MControlPacket::NUM_AXES;
+    }
+    if(axis >= MControlPacket::NUM_AXES) return 2*MControlPacket::NUM_AXES;
+    return axis + offset;
+}
+
+void MReceiver::buildDispatchPlan() {
+    primaryPlan_.clear();
+    secondaryPlan_.clear();
+    pairPlan_.clear();
+
+    for(uint8_t i = 0; i<inputs_.size(); i++) {
+        if(!hasMixForInput(i)) continue;
+
+        const AxisMix& mix = mixForInput(i);
+        AxisID axis1 = mix.axis1;
+        AxisID axis2 = mix.axis2;
+
+        DispatchEntry e;
+        e.input = i;
+        e.axis1 = packetAxisIndex(axis1);
+        e.axis2 = packetAxisIndex(axis2);
+        e.compiled = compiledMixForInput(i);
+        e.mix = &mix;
+
+        // Primary packets feed inputs that don't use any secondary axis, secondary packets feed
+        // inputs that don't use any primary axis. An input without valid axes gets both (and always 0).
+        bool usesSecondary = (axis1 >= SECONDARY_ADD && axis1 != AXIS_INVALID) || (axis2 >= SECONDARY_ADD && axis2 != AXIS_INVALID);
+        bool usesPrimary = axis1 < SECONDARY_ADD || axis2 < SECONDARY_ADD;
+        if(!usesSecondary) primaryPlan_.push_back(e);
+        if(!usesPrimary) secondaryPlan_.push_back(e);
+
+        // Aggregate frames carry everything
+        e.axis1 = pairAxisIndex(axis1);
+        e.axis2 = pairAxisIndex(axis2);
+        pairPlan_.push_back(e);
+    }
+
+    planNumInputs_ = inputs_.size();
+    planVersion_ = version();
+}
+
 bool MReceiver::incomingStatePacket(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MStatePacket& packet) {
-    printf("Incoming state packet from %s, source %d, seqnum %d!\n",
+    BBR_LOGD("Incoming state packet from %s, source %d, seqnum %d!\n",
            addr.toString().c_str(), source, seqnum);
     return true;
 }
+
+uint8_t MReceiver::bitDepthForAxis(AxisID axis) const {
+    if(axis >= SECONDARY_ADD && axis != AXIS_INVALID) axis -= SECONDARY_ADD;
+    return MControlPacket::bitDepthForAxis(axis);
+}
@@ -3,6 +3,7 @@
 
 #include "../BBRReceiver.h"
 #include "BBRMPacket.h"
+#include <vector>
 
 namespace bb {
 namespace rmt {
@@ -11,7 +12,56 @@ namespace rmt {
 class MReceiver: public Receiver {
 public:
 	virtual bool incomingControlPacket(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MControlPacket& packet);
+	//! Remember a full control packet as the keyframe for `source`'s deltas, then dispatch it.
+	virtual bool incomingControlKeyframe(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MControlKeyframe& keyframe);
+	/**
+	 * Reconstruct the full control packet from `source`'s keyframe and dispatch it. Returns false, and drops the
+	 * delta, if we don't have the keyframe it refers to -- the next keyframe will get us back in sync.
+	 */
+	virtual bool incomingControlDelta(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MControlDelta& delta);
+	/**
+	 * Dispatch both transmitters' axes in one go, as one frame. Every input with a mix is updated, including
+	 * inputs that mix a primary with a secondary axis, which separate packets can't feed.
+	 */
+	virtual bool incomingControlPair(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MControlPair& pair);
+	/**
+	 * Dispatch an FEC frame's full control packet. If the frame before it is the one we're missing (we hold the
+	 * keyframe from two frames back), reconstruct that one from the frame's delta and dispatch it first, setting
+	 * `recovered`. It gets `seqnum` - 1.
+	 */
+	virtual bool incomingControlFEC(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MFECPacket& packet, bool& recovered);
 	virtual bool incomingStatePacket(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MStatePacket& packet);
+
+	//! Axes 0..18 are the primary transmitter's, SECONDARY_ADD and up the secondary's.
+	virtual uint8_t bitDepthForAxis(AxisID axis) const;
+
+protected:
+	/**
+	 * Dispatch plan, rebuilt whenever mixes or the number of inputs change. Every input with a mix ends up in
+	 * the list for the packets it listens to (primary, secondary, or -- if it has no valid axis -- both), with
+	 * its axes already translated to packet axis indices.
+	 */
+	struct DispatchEntry {
+		InputID input;
+		uint8_t axis1, axis2;         // index into the decoded raw values; ZERO_SLOT if unused
+		const CompiledMix* compiled;  // nullptr if the mix couldn't be compiled...
+		const AxisMix* mix;           // ...in which case we fall back to this
+	};
+	static const uint8_t ZERO_SLOT = MControlPacket::NUM_AXES;
+	//! Same for `pairPlan_`, which indexes primary axes 0..18 and secondary axes from NUM_AXES on.
+	static const uint8_t PAIR_ZERO_SLOT = 2*MControlPacket::NUM_AXES;
+
+	void buildDispatchPlan();
+
+	// Last keyframe per packet source
+	static const uint8_t NUM_SOURCES = 4;
+	MControlPacket keyframes_[NUM_SOURCES];
+	uint8_t keyframeIDs_[NUM_SOURCES];
+	bool haveKeyframe_[NUM_SOURCES] = {false, false, false, false};
+
+	std::vector<DispatchEntry> primaryPlan_, secondaryPlan_, pairPlan_;
+	uint32_t planVersion_ = 0;
+	size_t planNumInputs_ = 0;
 };
 
 }; // rmt
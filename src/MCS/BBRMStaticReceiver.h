@@ -0,0 +1,145 @@
+#if !defined(BBRMSTATICRECEIVER_H)
+#define BBRMSTATICRECEIVER_H
+
+#include "BBRMReceiver.h"
+#include "../BBRStaticMix.h"
+#include "../BBRLatencyStats.h"
+
+namespace bb {
+namespace rmt {
+
+/**
+ * Monaco receiver with mixes fixed at compile time.
+ *
+ * For droids that hard-code their mixes anyway. Every input is a `StaticMix` writing to a float variable:
+ *
+ *     float speed, turn;
+ *     MStaticReceiver<StaticMix<0, INTERP_LIN_CENTERED>, StaticMix<1, INTERP_LIN_CENTERED>>
+ *         rx({INPUT_NAME_SPEED, INPUT_NAME_TURN_RATE}, {&speed, &turn});
+ *     ...
+ *     protocol.createReceiver(&rx);
+ *
+ * Dispatching a control packet is unrolled into straight-line fixed point code per input, without lookups,
+ * callback calls or float divisions; results are identical to `MReceiver` with the same mixes. Inputs
+ * and mixes are still reported through the `Receiver` / `MixManager` interface, so configurators can read them,
+ * but `setMix()` and `addInput()` fail. Every input is written on every packet that concerns it: there is no
+ * change-only delivery, and `setFrameBuffer()` is ignored.
+ */
+template<typename... Mixes>
+class MStaticReceiver: public MReceiver {
+public:
+    static const uint8_t NUM_INPUTS = sizeof...(Mixes);
+
+    MStaticReceiver(const char* const (&names)[NUM_INPUTS], float* const (&variables)[NUM_INPUTS]) {
+        for(uint8_t i=0; i<NUM_INPUTS; i++) {
+            float* var = variables_[i] = variables[i];
+            // Only for reporting -- dispatch doesn't go through the callback
+            MReceiver::addInput(names[i], Callback<void(float)>([var](float v) { *var = v; }));
+        }
+        registerMixes<0, Mixes...>();
+        frozen_ = true;
+    }
+
+    virtual InputID addInput(const std::string& name, float& variable, bool changeOnly = false, float deadband = 0) { 
+        return INPUT_INVALID; 
+    }
+    virtual InputID addInput(const std::string& name, Callback<void(float)> callback, bool changeOnly = false, float deadband = 0) { 
+        return INPUT_INVALID; 
+    }
+    virtual InputID addInput(const std::string& name, bool changeOnly = false, float deadband = 0) { 
+        return INPUT_INVALID; 
+    }
+    virtual bool setMix(InputID input, const AxisMix& mix) {
+        if(frozen_) return false;
+        return MReceiver::setMix(input, mix);
+    }
+    virtual void clearMixes() {}
+    //! Not supported -- inputs always go straight to their variables.
+    virtual void setFrameBuffer(float* frame, uint8_t size,
+                                Callback<void(const NodeAddr&, uint8_t, const float*, const InputMask&)> cb = nullptr) {}
+
+    virtual bool incomingControlPacket(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MControlPacket& packet) {
+        if(dataReceivedCB_ != nullptr) dataReceivedCB_(addr, seqnum, &packet, sizeof(packet));
+        dispatch<0, Mixes...>(packet);
+#if defined(BBR_LATENCY_STATS)
+        LatencyStats::packetDone();
+#endif
+        if(dataFinishedCB_ != nullptr) dataFinishedCB_(addr, seqnum);
+        return true;
+    }
+
+    virtual bool incomingControlPair(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MControlPair& pair) {
+        if(dataReceivedCB_ != nullptr) dataReceivedCB_(addr, seqnum, &pair, sizeof(pair));
+        dispatchPair<0, Mixes...>(pair);
+#if defined(BBR_LATENCY_STATS)
+        LatencyStats::packetDone();
+#endif
+        if(dataFinishedCB_ != nullptr) dataFinishedCB_(addr, seqnum);
+        return true;
+    }
+
+protected:
+    template<uint8_t I> void registerMixes() {}
+    template<uint8_t I, typename Mix, typename... Rest> void registerMixes() {
+        MReceiver::setMix(I, Mix::axisMix());
+        registerMixes<I+1, Rest...>();
+    }
+
+    //! Packet axis index for a mix axis; AXIS_INVALID stays as is.
+    static constexpr uint8_t packetAxis(AxisID axis) {
+        return axis == AXIS_INVALID ? AXIS_INVALID : axis >= SECONDARY_ADD ? axis - SECONDARY_ADD : axis;
+    }
+    //! Same routing as `MReceiver`.
+    static constexpr bool usesSecondary(AxisID a1, AxisID a2) {
+        return (a1 >= SECONDARY_ADD && a1 != AXIS_INVALID) || (a2 >= SECONDARY_ADD && a2 != AXIS_INVALID);
+    }
+    static constexpr bool usesPrimary(AxisID a1, AxisID a2) {
+        return a1 < SECONDARY_ADD || a2 < SECONDARY_ADD;
+    }
+
+    template<uint8_t I> inline void dispatch(const MControlPacket& packet) {}
+    template<uint8_t I, typename Mix, typename... Rest> inline void dispatch(const MControlPacket& packet) {
+        constexpr uint8_t A1 = packetAxis(Mix::axis1), A2 = packetAxis(Mix::axis2);
+        static_assert(A1 == AXIS_INVALID || A1 < MControlPacket::NUM_AXES, "No such axis");
+        static_assert(A2 == AXIS_INVALID || A2 < MControlPacket::NUM_AXES, "No such axis");
+        constexpr bool FOR_PRIMARY = !usesSecondary(Mix::axis1, Mix::axis2);
+        constexpr bool FOR_SECONDARY = !usesPrimary(Mix::axis1, Mix::axis2);
+
+        if(packet.primary ? FOR_PRIMARY : FOR_SECONDARY) {
+            int32_t q16 = Mix::template computeQ16<MControlPacket::bitDepthForAxis(A1), MControlPacket::bitDepthForAxis(A2)>
+                              (packet.getRawAxis(A1), packet.getRawAxis(A2));
+#if defined(BBR_LATENCY_STATS)
+            LatencyStats::callbackFired();
+#endif
+            *variables_[I] = float(q16) * (1.0f / 65536.0f);
+        }
+        dispatch<I+1, Rest...>(packet);
+    }
+
+    //! Raw value of a mix axis from an aggregate frame, which carries both transmitters' axes. 0 for AXIS_INVALID.
+    template<AxisID AXIS> static inline uint16_t pairRawAxis(const MControlPair& pair) {
+        return AXIS == AXIS_INVALID ? 0 :
+               AXIS >= SECONDARY_ADD ? pair.secondary.getRawAxis(packetAxis(AXIS)) : pair.primary.getRawAxis(AXIS);
+    }
+
+    //! Like `dispatch()`, but every input is fed, as `MReceiver::incomingControlPair()` does.
+    template<uint8_t I> inline void dispatchPair(const MControlPair& pair) {}
+    template<uint8_t I, typename Mix, typename... Rest> inline void dispatchPair(const MControlPair& pair) {
+        constexpr uint8_t A1 = packetAxis(Mix::axis1), A2 = packetAxis(Mix::axis2);
+        int32_t q16 = Mix::template computeQ16<MControlPacket::bitDepthForAxis(A1), MControlPacket::bitDepthForAxis(A2)>
+                          (pairRawAxis<Mix::axis1>(pair), pairRawAxis<Mix::axis2>(pair));
+#if defined(BBR_LATENCY_STATS)
+        LatencyStats::callbackFired();
+#endif
+        *variables_[I] = float(q16) * (1.0f / 65536.0f);
+        dispatchPair<I+1, Rest...>(pair);
+    }
+
+    float* variables_[NUM_INPUTS];
+    bool frozen_ = false;
+};
+
+}; // rmt
+}; // bb
+
+#endif // BBRMSTATICRECEIVER_H
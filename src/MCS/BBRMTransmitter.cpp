@@ -42,25 +42,143 @@ const std::string& MTransmitter::inputName(uint8_t input) {
     return EMPTY;
 }
 
+void MTransmitter::setAggregate(bool onoff) {
+    if(onoff == aggregate_) return;
+    aggregate_ = onoff;
+    if(onoff) {
+        char name[20];
+        for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+            uint8_t bitDepth = MControlPacket::bitDepthForAxis(i);
+            snprintf(name, sizeof(name), "Secondary axis %d", i);
+            axes_.push_back({ name, bitDepth, uint32_t((1<<(bitDepth-1))-1) });
+        }
+    } else {
+        axes_.resize(MControlPacket::NUM_AXES);
+    }
+    haveKeyframe_ = false;
+    havePrevious_ = false;
+}
+
 bool MTransmitter::transmit(){
+    if(aggregate_) return transmitAggregate();
+
     MPacket packet;
 
     packet.type = MPacket::PACKET_TYPE_CONTROL;
-    MControlPacket& p = packet.payload.control;
-    for(uint8_t i=0; i<axes_.size(); i++) {
-        p.setAxis(i, axes_[i].value, UNIT_RAW);
+    uint32_t raw[MControlPacket::NUM_AXES];
+    for(uint8_t i=0; i<MControlPacket::NUM_AXES; i++) {
+        raw[i] = i < axes_.size() ? axes_[i].value : 0;
+    }
+
+    // Delta if possible and worth it, keyframe otherwise
+    packet.extended = 0;
+    if(delta_ && !fec_ && haveKeyframe_ && sinceKeyframe_ + 1 < keyframeInterval_ &&
+       packet.payload.delta.encode(keyframeID_, keyframeRaw_, raw, primary_)) {
+        packet.extended = 1;
+        if(packet.wireLength() >= sizeof(MPacket)) packet.extended = 0;
+    }
+    if(packet.extended) {
+        sinceKeyframe_++;
+    } else {
+        MControlPacket& p = packet.payload.control;
+        p.primary = primary_;
+        p.encodeAll(raw);
+        packet.payload.keyframe.id = ++keyframeID_;
+        memcpy(keyframeRaw_, raw, sizeof(raw));
+        haveKeyframe_ = true;
+        sinceKeyframe_ = 0;
     }
-    p.primary = primary_;
+
+    // The previous frame relative to this one, for receivers that take FEC frames
+    MFECPacket fecPacket;
+    bool haveFEC = false;
+    if(fec_ && !packet.extended && havePrevious_ && previousID_ == uint8_t(keyframeID_ - 1) &&
+       fecPacket.previous.encode(previousID_, raw, previousRaw_, previousPrimary_)) {
+        fecPacket.current = packet.payload.keyframe;
+        haveFEC = true;
+    }
+
+#if defined(BBR_LATENCY_STATS)
+    unsigned long txUS = micros();
+    if(latencySetPending_) LatencyStats::record(LatencyStats::SET_TO_TRANSMIT, txUS - latencySetUS_);
+#endif
 
     //printf("We have %d paired nodes\n", protocol_->pairedNodes().size());
     for(auto& n: protocol_->pairedNodes()) {
         if(n.isReceiver) {
             //printf("MTransmitter: Sending packet to %s\n", n.addr.toString().c_str());
-            protocol_->sendPacket(n.addr, packet, false);
+#if defined(BBR_LATENCY_STATS)
+            LatencyStats::transmitted(protocol_->packetSource(), protocol_->seqnum(), txUS, latencySetPending_, latencySetUS_);
+#endif
+            bool fecFits = haveFEC && (n.protoSpecific & MProtocol::CAPABILITY_FEC) &&
+                fecPacket.wireLength() + integrityTagLength(protocol_->integrityFor(n.addr)) <= protocol_->maxWireLength();
+            if(fecFits) protocol_->sendFECPacket(n.addr, fecPacket, false);
+            else protocol_->sendPacket(n.addr, packet, false);
+        }
+    }
+    if(!packet.extended) {
+        memcpy(previousRaw_, raw, sizeof(raw));
+        previousPrimary_ = primary_;
+        previousID_ = keyframeID_;
+        havePrevious_ = true;
+    }
+    // Once per transmission -- every receiver gets the same seqnum, so each sees an unbroken sequence
+    protocol_->bumpSeqnum();
+
+#if defined(BBR_LATENCY_STATS)
+    latencySetPending_ = false;
+#endif
+
+    return true;
+}
+
+bool MTransmitter::transmitAggregate() {
+    havePrevious_ = false;
+    MAggregatePacket packet;
+    uint32_t raw[2*MControlPacket::NUM_AXES];
+    for(uint8_t i=0; i<2*MControlPacket::NUM_AXES; i++) {
+        raw[i] = i < axes_.size() ? axes_[i].value : 0;
+    }
+    packet.control.primary.encodeAll(raw);
+    packet.control.secondary.encodeAll(raw + MControlPacket::NUM_AXES);
+
+#if defined(BBR_LATENCY_STATS)
+    unsigned long txUS = micros();
+    if(latencySetPending_) LatencyStats::record(LatencyStats::SET_TO_TRANSMIT, txUS - latencySetUS_);
+#endif
+
+    bool aggregateFits = protocol_->maxWireLength() >= MPacketView::AGGREGATE_LENGTH;
+    MPacket p(MPacket::PACKET_TYPE_CONTROL, protocol_->packetSource(), protocol_->seqnum());
+    if(!aggregateFits) {
+        // Small MTU -- one full packet per set, same as two separate transmitters would send
+        p.payload.keyframe.control = packet.control.primary;
+        p.payload.keyframe.id = ++keyframeID_;
+    }
+    for(auto& n: protocol_->pairedNodes()) {
+        if(n.isReceiver) {
+#if defined(BBR_LATENCY_STATS)
+            LatencyStats::transmitted(protocol_->packetSource(), protocol_->seqnum(), txUS, latencySetPending_, latencySetUS_);
+#endif
+            if(aggregateFits) protocol_->sendAggregatePacket(n.addr, packet, false);
+            else protocol_->sendPacket(n.addr, p, false);
+        }
+    }
+    protocol_->bumpSeqnum();
+
+    if(!aggregateFits) {
+        // Its own seqnum, or receivers would drop it as a duplicate
+        p.payload.keyframe.control = packet.control.secondary;
+        p.payload.keyframe.id = ++keyframeID_;
+        for(auto& n: protocol_->pairedNodes()) {
+            if(n.isReceiver) protocol_->sendPacket(n.addr, p, false);
         }
         protocol_->bumpSeqnum();
     }
 
+#if defined(BBR_LATENCY_STATS)
+    latencySetPending_ = false;
+#endif
+
     return true;
 }
 
@@ -69,11 +187,15 @@ bool MTransmitter::transmitRawControlPacket(const MControlPacket& p) {
 
     packet.type = MPacket::PACKET_TYPE_CONTROL;
     packet.payload.control = p;
+    packet.payload.keyframe.id = ++keyframeID_;
+    haveKeyframe_ = false; // receivers now hold this one as their keyframe
+    havePrevious_ = false;
     for(auto& n: protocol_->pairedNodes()) {
         if(n.isReceiver) {
             //printf("MTransmitter: Sending raw packet to %s\n", n.addr.toString().c_str());
             protocol_->sendPacket(n.addr, packet, false);
         }
     }
+    protocol_->bumpSeqnum();
     return true;
 }
\ No newline at end of file
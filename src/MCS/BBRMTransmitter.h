@@ -22,6 +22,51 @@ public:
     virtual bool transmitRawControlPacket(const MControlPacket& packet);
 
     virtual bool requiresConnection() { return false; }
+
+    /**
+     * Send delta packets, carrying only the axes that differ from the last keyframe, instead of full control
+     * packets. `transmit()` sends a keyframe at least every `keyframeInterval` packets, and whenever a delta
+     * wouldn't be smaller. Saves airtime when only a few axes move; all receivers must understand deltas
+     * (MReceiver does since they were introduced). Off by default.
+     */
+    void setDeltaEncoding(bool onoff, uint8_t keyframeInterval = 10) { 
+        delta_ = onoff; 
+        keyframeInterval_ = keyframeInterval; 
+        haveKeyframe_ = false;
+    }
+    bool deltaEncoding() { return delta_; }
+
+    /**
+     * Carry the secondary transmitter's axes too, as axes SECONDARY_ADD and up (the IDs receivers use in their
+     * mixes), for a single device that has both sets of controls. `transmit()` then sends both sets in one
+     * `MAggregatePacket` where the link allows it (`MProtocol::maxWireLength()`), and as a primary and a
+     * secondary full packet otherwise. Delta encoding doesn't apply to aggregate frames. Off by default.
+     */
+    void setAggregate(bool onoff);
+    bool aggregate() { return aggregate_; }
+
+    /**
+     * Forward error correction: send every frame as an `MFECPacket` that also carries the previous frame, delta
+     * encoded, so a receiver can make up for a single lost frame. Goes to receivers that announced
+     * `MProtocol::CAPABILITY_FEC` when pairing, over links with room for it (`MProtocol::maxWireLength()`);
+     * others keep getting full packets. Every frame is a keyframe then, so this overrides delta encoding, and it
+     * doesn't apply to aggregate frames. Costs 5 to 17 bytes per frame. Off by default.
+     */
+    void setFEC(bool onoff) { fec_ = onoff; havePrevious_ = false; }
+    bool fec() { return fec_; }
+
+protected:
+    bool transmitAggregate();
+
+    bool aggregate_ = false;
+    bool delta_ = false, haveKeyframe_ = false;
+    uint8_t keyframeInterval_ = 10, sinceKeyframe_ = 0, keyframeID_ = 0;
+    uint32_t keyframeRaw_[MControlPacket::NUM_AXES];
+
+    // Last frame sent, for FEC
+    bool fec_ = false, havePrevious_ = false, previousPrimary_ = false;
+    uint8_t previousID_ = 0;
+    uint32_t previousRaw_[MControlPacket::NUM_AXES];
 };
 }; // rmt
 }; // bb
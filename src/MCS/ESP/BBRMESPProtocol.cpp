@@ -4,6 +4,7 @@
 
 #include "BBRMESPProtocol.h"
 #include "../../BBRTypes.h"
+#include "../../BBRLog.h"
 
 using namespace bb;
 using namespace bb::rmt;
@@ -14,6 +15,21 @@ using namespace bb::rmt;
 
 static MESPProtocol *proto = nullptr;
 
+static const char* espNowErrorName(esp_err_t error) {
+    switch(error) {
+    case ESP_ERR_ESPNOW_NOT_INIT:  return "ESP_ERR_ESPNOW_NOT_INIT";
+    case ESP_ERR_ESPNOW_ARG:       return "ESP_ERR_ESPNOW_ARG";
+    case ESP_ERR_ESPNOW_NO_MEM:    return "ESP_ERR_ESPNOW_NO_MEM";
+    case ESP_ERR_ESPNOW_FULL:      return "ESP_ERR_ESPNOW_FULL";
+    case ESP_ERR_ESPNOW_NOT_FOUND: return "ESP_ERR_ESPNOW_NOT_FOUND";
+    case ESP_ERR_ESPNOW_INTERNAL:  return "ESP_ERR_ESPNOW_INTERNAL";
+    case ESP_ERR_ESPNOW_EXIST:     return "ESP_ERR_ESPNOW_EXIST";
+    case ESP_ERR_ESPNOW_IF:        return "ESP_ERR_ESPNOW_IF";
+    case ESP_ERR_ESPNOW_CHAN:      return "ESP_ERR_ESPNOW_CHAN";
+    default:                       return "unknown";
+    }
+}
+
 static const NodeAddr broadcastAddr = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00};
 static esp_now_peer_info broadcastPeer = {};
 
@@ -91,96 +107,97 @@ bool MESPProtocol::discoverNodes(float timeout) {
 
 void MESPProtocol::onDataSent(const unsigned char *buf, esp_now_send_status_t status) {
     //if(status != ESP_OK) Serial.printf("onDataSent() received error status %d\n", status);
+    if(status != ESP_NOW_SEND_SUCCESS && proto != nullptr) proto->stats_.deliveryFailures++;
 }
 
 void MESPProtocol::onDataReceived(const esp_now_recv_info_t *info, const uint8_t *data, int len) {
     uint8_t* mac = info->src_addr;
 
-    if(len != sizeof(MPacket)) {
-        Serial.printf("onDataReceived(%02x:%02x:%02x:%02x:%02x:%02x, 0x%p, %d) - invalid size (should be %d)\n", 
-                      mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], data, len, sizeof(MPacket));
+    if(proto == nullptr) {
+        BBR_LOGW("Packet received, but proto is NULL\n");
         return;
     }
 
-    MPacket* packet = (MPacket*)data;
-    if(packet->calculateCRC() != packet->crc) {
-        Serial.printf("Packet received, but CRC invalid (0x%x, should be 0x%x)\n", packet->crc, packet->calculateCRC());
+    NodeAddr addr;
+    addr.fromMACAddress(mac);
+    if(len < 0 || len > MAX_TAGGED_LENGTH) {
+        proto->stats_.sizeErrors++;
+        return;
+    }
+    uint8_t wireLen = len;
+    if(!proto->checkIntegrity(addr, data, wireLen)) return;
+
+    MPacketView view(data, wireLen);
+    if(!view.validLength()) {
+        BBR_LOGW("onDataReceived(%02x:%02x:%02x:%02x:%02x:%02x, 0x%p, %d) - invalid size (should be %d)\n", 
+                      mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], data, len, MPacketView::LENGTH);
+        proto->stats_.sizeErrors++;
         return;
     }
 
-    if(proto == nullptr) {
-        Serial.printf("Packet received, but proto is NULL\n");
+    if(!view.validCRC()) {
+        BBR_LOGW("Packet received, but CRC invalid (0x%x, should be 0x%x)\n", view.crc(), view.calculateCRC());
+        proto->stats_.crcErrors++;
         return;
     }
 
-    NodeAddr addr;
-    addr.fromMACAddress(mac);
-    proto->enqueuePacket(addr, *packet);
+    if(!view.isMPacket()) {
+        proto->enqueueFrame(addr, view);
+        return;
+    }
+    MPacket packet; // the only copy -- data is only valid during this callback
+    packet.fromWire(data, wireLen);
+    proto->enqueuePacket(addr, packet);
 }
 
 bool MESPProtocol::step() {
+    BBR_PROFILE_STEP();
     enterPairingModeIfNecessary();
     cleanupTempPeers();
 
-    packetQueueMutex_.lock();
-    //bb::rmt::printf("%d packets in queue\n", packetQueue_.size());
-    std::deque<AddrAndPacket> queue = packetQueue_;
-    packetQueue_.clear();
-    packetQueueMutex_.unlock();
+    std::deque<AddrAndPacket> queue;
+    std::deque<AddrAndFrame> frames;
+    {
+        BBR_PROFILE_PHASE(PHASE_RECEIVE);
+        packetQueueMutex_.lock();
+        //bb::rmt::printf("%d packets in queue\n", packetQueue_.size());
+        queue.swap(packetQueue_);
+        frames.swap(frameQueue_);
+        stats_.queueDepth = 0;
+        packetQueueMutex_.unlock();
+    }
 
-    while(queue.size()) {
-        AddrAndPacket ap = queue.front();
-        queue.pop_front();
+    for(const AddrAndPacket& ap: queue) {
         //printf("Packet from %s type %d\n", ap.addr.toString().c_str(), ap.packet.type);
+        BBR_PROFILE_PHASE(PHASE_DISPATCH);
         incomingPacket(ap.addr, ap.packet);
     }
+    for(const AddrAndFrame& af: frames) {
+        BBR_PROFILE_PHASE(PHASE_DISPATCH);
+        incomingPacket(af.addr, MPacketView(af.wire, af.length));
+    }
 
     return MProtocol::step();
 }
 
 bool MESPProtocol::sendPacket(const NodeAddr& addr, MPacket& packet, bool bumpS) {
-    packet.seqnum = seqnum_;
-    packet.source = source_;
-    packet.crc = packet.calculateCRC();
+    finishPacket(packet);
 
     //bb::rmt::printf("Sending packet to %s\n", addr.toString().c_str());
 
-    esp_err_t error = esp_now_send(addr.byte, (uint8_t*)&packet, sizeof(packet));
+    uint8_t buf[sizeof(MPacket)];
+    uint8_t len = packet.toWire(buf);
+    return sendFrame(addr, buf, len, bumpS);
+}
+
+bool MESPProtocol::sendWire(const NodeAddr& addr, const uint8_t* buf, uint8_t len, bool bumpS) {
+    esp_err_t error = esp_now_send(addr.byte, buf, len);
+    countSent(addr, error == ESP_OK);
     if(error == ESP_OK) {
         if(bumpS) bumpSeqnum();
         return true;
     } else {
-        switch(error) {
-        case ESP_ERR_ESPNOW_NOT_INIT:
-            bb::rmt::printf("esp_now_send() returns error 0x%x (ESP_ERR_ESPNOW_NOT_INIT)\n", error);
-            break;
-        case ESP_ERR_ESPNOW_ARG:
-            bb::rmt::printf("esp_now_send() returns error 0x%x (ESP_ERR_ESPNOW_ARG)\n", error);
-            break;
-        case ESP_ERR_ESPNOW_NO_MEM:
-            bb::rmt::printf("esp_now_send() returns error 0x%x (ESP_ERR_ESPNOW_NO_MEM)\n", error);
-            break;
-        case ESP_ERR_ESPNOW_FULL:
-            bb::rmt::printf("esp_now_send() returns error 0x%x (ESP_ERR_ESPNOW_FULL)\n", error);
-            break;
-        case ESP_ERR_ESPNOW_NOT_FOUND:
-            bb::rmt::printf("esp_now_send() returns error 0x%x (ESP_ERR_ESPNOW_NOT_FOUND)\n", error);
-            break;
-        case ESP_ERR_ESPNOW_INTERNAL:
-            bb::rmt::printf("esp_now_send() returns error 0x%x (ESP_ERR_ESPNOW_INTERNAL)\n", error);
-            break;
-        case ESP_ERR_ESPNOW_EXIST:
-            bb::rmt::printf("esp_now_send() returns error 0x%x (ESP_ERR_ESPNOW_EXIST)\n", error);
-            break;
-        case ESP_ERR_ESPNOW_IF:
-            bb::rmt::printf("esp_now_send() returns error 0x%x (ESP_ERR_ESPNOW_IF)\n", error);
-            break;
-        case ESP_ERR_ESPNOW_CHAN:
-            bb::rmt::printf("esp_now_send() returns error 0x%x (ESP_ERR_ESPNOW_CHAN)\n", error);
-            break;
-        default:
-            bb::rmt::printf("esp_now_send() returns unknown error 0x%x\n", error);
-        }
+        BBR_LOGW("esp_now_send() returns error 0x%x (%s)\n", error, espNowErrorName(error));
     }
     return false;
 }
@@ -214,7 +231,7 @@ bool MESPProtocol::incomingPairingPacket(const NodeAddr& addr, MPacket::PacketSo
         //Serial.printf("Received discovery broadcast. Temporarily adding %s as a peer.\n", addr.toString().c_str());
         addTempPeer(addr);
     } else if((packet.type == packet.PAIRING_REQUEST)) {
-        Serial.printf("Received pairing packet. Temporarily adding %s as a peer.\n", addr.toString().c_str());
+        BBR_LOGI("Received pairing packet. Temporarily adding %s as a peer.\n", addr.toString().c_str());
         addTempPeer(addr);
     }
 
@@ -253,8 +270,8 @@ void MESPProtocol::addTempPeer(const NodeAddr& addr) {
     peerInfo.encrypt = false;
 
     if(esp_now_add_peer(&peerInfo) != ESP_OK) {
-        bb::rmt::printf("Failed to add peer\n");
-    } else bb::rmt::printf("Added temp peer %s\n", addr.toString().c_str());
+        BBR_LOGW("Failed to add peer\n");
+    } else BBR_LOGD("Added temp peer %s\n", addr.toString().c_str());
 
     tempPeers_.push_back({addr, millis()});
 }
@@ -264,9 +281,9 @@ void MESPProtocol::cleanupTempPeers() {
     for(auto& p: tempPeers_) {
         if(WRAPPEDDIFF(millis(), p.msAdded, ULONG_MAX) > keepTempPeerMS_) {
             if(isPaired(p.addr) && isDiscovered(p.addr)) {
-                Serial.printf("Removing %s from temp peer list but not from ESP-NOW, we're paired or have discovered it.\n", p.addr.toString().c_str());
+                BBR_LOGD("Removing %s from temp peer list but not from ESP-NOW, we're paired or have discovered it.\n", p.addr.toString().c_str());
             } else {
-                Serial.printf("Removing %s from temp peer list\n", p.addr.toString().c_str());
+                BBR_LOGD("Removing %s from temp peer list\n", p.addr.toString().c_str());
                 //esp_now_del_peer(p.addr.byte);
             }
         } else {
@@ -279,10 +296,43 @@ void MESPProtocol::cleanupTempPeers() {
 void MESPProtocol::enqueuePacket(const NodeAddr& addr, const MPacket& packet) {
     packetQueueMutex_.lock();
     packetQueue_.push_back({addr, packet});
+    stats_.queueDepth = packetQueue_.size();
+    if(stats_.queueDepth > stats_.queueHighWater) stats_.queueHighWater = stats_.queueDepth;
+    packetQueueMutex_.unlock();
+}
+
+void MESPProtocol::enqueueFrame(const NodeAddr& addr, const MPacketView& view) {
+    AddrAndFrame af;
+    af.addr = addr;
+    af.length = view.length();
+    memcpy(af.wire, view.data(), af.length);
+    packetQueueMutex_.lock();
+    frameQueue_.push_back(af);
+    stats_.queueDepth = packetQueue_.size() + frameQueue_.size();
+    if(stats_.queueDepth > stats_.queueHighWater) stats_.queueHighWater = stats_.queueDepth;
     packetQueueMutex_.unlock();
 }
 
-bool MESPProtocol::waitForPacket(std::function<bool(const MPacket&, const NodeAddr&)> fn, 
+MIntegrity MESPProtocol::integrityFor(const NodeAddr& addr) {
+    MIntegrity integrity = INTEGRITY_CRC7;
+    integrityMutex_.lock();
+    for(auto& ai: integrities_) {
+        if(ai.addr == addr) integrity = ai.integrity;
+    }
+    integrityMutex_.unlock();
+    return integrity;
+}
+
+void MESPProtocol::pairedNodesChanged() {
+    // Built outside the lock, so the receive callback never waits for an allocation
+    std::vector<AddrAndIntegrity> integrities;
+    for(auto& n: pairedNodes_) integrities.push_back({n.addr, MProtocol::integrityFor(n.addr)});
+    integrityMutex_.lock();
+    integrities_.swap(integrities);
+    integrityMutex_.unlock();
+}
+
+bool MESPProtocol::waitForPacket(const Callback<bool(const MPacket&, const NodeAddr&)>& fn, 
                                  NodeAddr& addr, MPacket& packet, 
                                  bool handleOthers, float timeout) {
     bool retval = false;
@@ -292,6 +342,7 @@ bool MESPProtocol::waitForPacket(std::function<bool(const MPacket&, const NodeAd
         while(packetQueue_.size()) {
             AddrAndPacket ap = packetQueue_.front();
             packetQueue_.pop_front();
+            stats_.queueDepth = packetQueue_.size();
 
             if(fn(ap.packet, ap.addr) == true) {
                 addr = ap.addr;
@@ -301,6 +352,11 @@ bool MESPProtocol::waitForPacket(std::function<bool(const MPacket&, const NodeAd
                 incomingPacket(ap.addr, ap.packet);
             }
         }
+        while(frameQueue_.size()) { // never what fn is waiting for
+            AddrAndFrame af = frameQueue_.front();
+            frameQueue_.pop_front();
+            if(handleOthers == true) incomingPacket(af.addr, MPacketView(af.wire, af.length));
+        }
         packetQueueMutex_.unlock();
         if(retval == true) return true;
         timeout -= .01;
@@ -36,16 +36,23 @@ public:
 
     virtual bool sendPacket(const NodeAddr& addr, MPacket& packet, bool bumpSeqnum=true);
     virtual bool sendBroadcastPacket(MPacket& packet, bool bumpSeqnum=true);
+    virtual uint8_t maxWireLength() { return ESP_NOW_MAX_DATA_LEN; }
+    //! Safe to call from the receive callback, which runs in the WiFi task.
+    virtual MIntegrity integrityFor(const NodeAddr& addr);
 
     virtual bool incomingPairingPacket(const NodeAddr& addr, MPacket::PacketSource source, uint8_t seqnum, const MPairingPacket& packet);
 
     virtual void enqueuePacket(const NodeAddr& addr, const MPacket& packet);
-    virtual bool waitForPacket(std::function<bool(const MPacket&, const NodeAddr&)> fn, 
+    //! Queue a checked frame that isn't an `MPacket` (aggregate or FEC control frames) for `step()`.
+    virtual void enqueueFrame(const NodeAddr& addr, const MPacketView& view);
+    virtual bool waitForPacket(const Callback<bool(const MPacket&, const NodeAddr&)>& fn, 
                                NodeAddr& addr, MPacket& packet, 
                                bool handleOthers, float timeout);
 
 
 protected:
+    virtual bool sendWire(const NodeAddr& addr, const uint8_t* buf, uint8_t len, bool bumpS);
+    virtual void pairedNodesChanged();
     void enterPairingModeIfNecessary();
     void addBroadcastAddress();
     void removeBroadcastAddress();
@@ -66,7 +73,22 @@ protected:
         MPacket packet;
     };
     std::deque<AddrAndPacket> packetQueue_;
+    struct AddrAndFrame {
+        NodeAddr addr;
+        uint8_t length;
+        uint8_t wire[MPacketView::MAX_LENGTH];
+    };
+    std::deque<AddrAndFrame> frameQueue_; // same mutex
     std::mutex packetQueueMutex_;
+
+    // Integrity agreed with each paired node, copied from pairedNodes_ for the receive callback. Own mutex:
+    // waitForPacket() holds packetQueueMutex_ while it handles packets, and handling them sends.
+    struct AddrAndIntegrity {
+        NodeAddr addr;
+        MIntegrity integrity;
+    };
+    std::vector<AddrAndIntegrity> integrities_;
+    std::mutex integrityMutex_;
 }; 
 }; // rmt
 }; // bb
@@ -0,0 +1,219 @@
+#include "BBRMLoopbackProtocol.h"
+
+using namespace bb;
+using namespace bb::rmt;
+
+static const NodeAddr broadcastAddr = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00};
+
+static unsigned long defaultClock() {
+    return micros();
+}
+
+MLoopbackMedium::MLoopbackMedium() {
+    usClock_ = defaultClock;
+    latencyUS_ = 0;
+    jitterUS_ = 0;
+    lossRate_ = 0;
+    duplicateRate_ = 0;
+    maxWireLength_ = MPacketView::LENGTH;
+    rand_ = 0x12345678;
+    nextAddr_ = 1;
+    numSent_ = numLost_ = numDelivered_ = numDuplicated_ = numBytesSent_ = 0;
+}
+
+void MLoopbackMedium::setLatencyUS(unsigned long latencyUS, unsigned long jitterUS) {
+    latencyUS_ = latencyUS;
+    jitterUS_ = jitterUS;
+}
+
+// xorshift32 -- deterministic for a given seed, and cheap enough for any target.
+uint32_t MLoopbackMedium::random() {
+    rand_ ^= rand_ << 13;
+    rand_ ^= rand_ >> 17;
+    rand_ ^= rand_ << 5;
+    return rand_;
+}
+
+NodeAddr MLoopbackMedium::attach(MLoopbackProtocol* proto) {
+    protocols_.push_back(proto);
+    NodeAddr addr = {0x02, 0x00, 0x00, 0x00, 0x00, nextAddr_++, 0x00, 0x00};
+    return addr;
+}
+
+void MLoopbackMedium::detach(MLoopbackProtocol* proto) {
+    for(auto it = protocols_.begin(); it != protocols_.end(); it++) {
+        if(*it == proto) {
+            protocols_.erase(it);
+            break;
+        }
+    }
+    std::vector<InFlight> remaining;
+    for(auto& f: inFlight_) {
+        if(f.dest != proto->address() && f.src != proto->address()) remaining.push_back(f);
+    }
+    inFlight_ = remaining;
+}
+
+bool MLoopbackMedium::send(const NodeAddr& src, const NodeAddr& dest, const uint8_t* wire, uint8_t len) {
+    if(len > maxWireLength_) return false;
+    InFlight f;
+    f.src = src;
+    f.length = len;
+    memcpy(f.wire, wire, len);
+
+    for(auto p: protocols_) {
+        if(p->address() == src) continue;
+        if(dest != broadcastAddr && p->address() != dest) continue;
+
+        numSent_++;
+        numBytesSent_ += f.length;
+        if(lossRate_ > 0 && float(random() % 1000000) < lossRate_ * 1000000.0f) {
+            numLost_++;
+            continue;
+        }
+
+        f.dest = p->address();
+        unsigned int copies = 1;
+        if(duplicateRate_ > 0 && float(random() % 1000000) < duplicateRate_ * 1000000.0f) {
+            numDuplicated_++;
+            copies = 2;
+        }
+        for(unsigned int c=0; c<copies; c++) {
+            unsigned long latency = latencyUS_;
+            if(jitterUS_ > 0) latency += random() % (jitterUS_+1);
+            f.deliverAtUS = now() + latency;
+            inFlight_.push_back(f);
+        }
+    }
+    return true;
+}
+
+bool MLoopbackMedium::receive(const NodeAddr& dest, NodeAddr& src, uint8_t* wire, uint8_t& len) {
+    unsigned long t = now();
+    int earliest = -1;
+    for(unsigned int i=0; i<inFlight_.size(); i++) {
+        const InFlight& f = inFlight_[i];
+        if(f.dest != dest || long(t - f.deliverAtUS) < 0) continue;
+        if(earliest < 0 || long(inFlight_[earliest].deliverAtUS - f.deliverAtUS) > 0) earliest = i;
+    }
+    if(earliest < 0) return false;
+
+    src = inFlight_[earliest].src;
+    len = inFlight_[earliest].length;
+    memcpy(wire, inFlight_[earliest].wire, len);
+    inFlight_.erase(inFlight_.begin() + earliest);
+    numDelivered_++;
+    return true;
+}
+
+void MLoopbackMedium::stepAll(MLoopbackProtocol* except) {
+    // Copy -- stepping may attach or detach protocols.
+    std::vector<MLoopbackProtocol*> protocols = protocols_;
+    for(auto p: protocols) {
+        if(p != except) p->step();
+    }
+}
+
+MLoopbackProtocol::MLoopbackProtocol(MLoopbackMedium& medium): medium_(medium) {
+    addr_ = medium_.attach(this);
+    acceptsPairingRequests_ = true;
+    blocking_ = 0;
+}
+
+MLoopbackProtocol::~MLoopbackProtocol() {
+    medium_.detach(this);
+}
+
+bool MLoopbackProtocol::init(const std::string& nodeName) {
+    nodeName_ = nodeName;
+    return true;
+}
+
+bool MLoopbackProtocol::discoverNodes(float timeout) {
+    // MProtocol::discoverNodes() calls step() while waiting -- let the other nodes run too.
+    blocking_++;
+    bool retval = MProtocol::discoverNodes(timeout);
+    blocking_--;
+    return retval;
+}
+
+bool MLoopbackProtocol::step() {
+    BBR_PROFILE_STEP();
+    if(blocking_ > 0) medium_.stepAll(this);
+
+    NodeAddr src;
+    uint8_t wire[MAX_TAGGED_LENGTH];
+    uint8_t len;
+    while(true) {
+        {
+            BBR_PROFILE_PHASE(PHASE_RECEIVE);
+            if(medium_.receive(addr_, src, wire, len) == false) break;
+        }
+        // Length and CRC are checked there
+        BBR_PROFILE_PHASE(PHASE_DISPATCH);
+        if(!checkIntegrity(src, wire, len)) continue;
+        incomingPacket(src, MPacketView(wire, len));
+    }
+
+    return MProtocol::step();
+}
+
+bool MLoopbackProtocol::sendPacket(const NodeAddr& addr, MPacket& packet, bool bumpS) {
+    finishPacket(packet);
+
+    uint8_t wire[sizeof(MPacket)];
+    uint8_t len = packet.toWire(wire);
+    return sendFrame(addr, wire, len, bumpS);
+}
+
+bool MLoopbackProtocol::sendWire(const NodeAddr& addr, const uint8_t* wire, uint8_t len, bool bumpS) {
+    bool ok = medium_.send(addr_, addr, wire, len);
+    countSent(addr, ok);
+    if(ok == false) return false;
+    if(bumpS) bumpSeqnum();
+    return true;
+}
+
+bool MLoopbackProtocol::sendBroadcastPacket(MPacket& packet, bool bumpS) {
+    return sendPacket(broadcastAddr, packet, bumpS);
+}
+
+bool MLoopbackProtocol::waitForPacket(const Callback<bool(const MPacket&, const NodeAddr&)>& fn, 
+                                      NodeAddr& addr, MPacket& packet, 
+                                      bool handleOthers, float timeout) {
+    while(true) {
+        medium_.stepAll(this);
+
+        NodeAddr src;
+        MPacket p;
+        uint8_t wire[MAX_TAGGED_LENGTH];
+        uint8_t len;
+        while(medium_.receive(addr_, src, wire, len)) {
+            if(!checkIntegrity(src, wire, len)) continue;
+            if(!MPacketView(wire, len).isMPacket()) { // not an MPacket, so fn can't be waiting for it
+                if(handleOthers == true) incomingPacket(src, MPacketView(wire, len));
+                continue;
+            }
+            if(p.fromWire(wire, len) == false) {
+                stats_.sizeErrors++;
+                continue;
+            }
+            if(p.calculateCRC() != p.crc) {
+                stats_.crcErrors++;
+                continue;
+            }
+            if(fn(p, src) == true) {
+                addr = src;
+                packet = p;
+                return true;
+            } else if(handleOthers == true) {
+                incomingPacket(src, p);
+            }
+        }
+
+        timeout -= .001;
+        if(timeout < 0) break;
+        delay(1);
+    }
+    return false;
+}
@@ -0,0 +1,124 @@
+#if !defined(BBRMLOOPBACKPROTOCOL_H)
+#define BBRMLOOPBACKPROTOCOL_H
+
+#include "../BBRMProtocol.h"
+#include <vector>
+#include "../../BBRCallback.h"
+
+namespace bb {
+namespace rmt {
+
+class MLoopbackProtocol;
+
+/**
+ * In-memory medium connecting any number of `MLoopbackProtocol` instances.
+ * 
+ * Packets sent into the medium are delivered to the destination's `step()` after a configurable latency
+ * (plus uniformly distributed jitter), or dropped with a configurable probability. Jitter larger than the
+ * send interval reorders packets; they can also be duplicated with a configurable probability. Time is taken from an
+ * injectable clock returning microseconds, which defaults to `micros()`. On the host build, combine this
+ * with virtual time (see `extras/host/hal/BBRHostHAL.h`) to run links faster than real time.
+ * 
+ * Everything runs in the caller's thread. Blocking calls like `discoverNodes()` or `waitForPacket()`
+ * step the other attached protocols while they wait, so a single thread can simulate a whole system.
+ */
+class MLoopbackMedium {
+public:
+    MLoopbackMedium();
+
+    //! Set the one-way latency, and the maximum additional random jitter, in microseconds.
+    void setLatencyUS(unsigned long latencyUS, unsigned long jitterUS = 0);
+    //! Set the probability in [0..1] that a packet gets lost.
+    void setLossRate(float lossRate) { lossRate_ = lossRate; }
+    //! Set the probability in [0..1] that a packet that isn't lost is delivered twice, with independent jitter.
+    void setDuplicateRate(float duplicateRate) { duplicateRate_ = duplicateRate; }
+    //! Set the longest frame the medium carries, eg. 250 to simulate ESP-NOW. Defaults to an `MPacket`.
+    void setMaxWireLength(uint8_t len) { maxWireLength_ = len < MAX_TAGGED_LENGTH ? len : MAX_TAGGED_LENGTH; }
+    uint8_t maxWireLength() const { return maxWireLength_; }
+    //! Set the clock the medium uses, returning microseconds.
+    void setClock(Callback<unsigned long()> usClock) { usClock_ = usClock; }
+    //! Seed the random number generator used for jitter and loss.
+    void setSeed(uint32_t seed) { rand_ = seed != 0 ? seed : 1; }
+    //! Return the current time in microseconds, according to the medium's clock.
+    unsigned long now() { return usClock_(); }
+
+    //! Step every attached protocol except `except` (which may be `nullptr`).
+    void stepAll(MLoopbackProtocol* except = nullptr);
+
+    unsigned long numSent() const { return numSent_; }
+    unsigned long numLost() const { return numLost_; }
+    unsigned long numDelivered() const { return numDelivered_; }
+    unsigned long numDuplicated() const { return numDuplicated_; }
+    //! Bytes put on the medium, as they would go over the air (per receiver, including lost packets).
+    unsigned long numBytesSent() const { return numBytesSent_; }
+    unsigned int numInFlight() const { return inFlight_.size(); }
+
+protected:
+    friend class MLoopbackProtocol;
+
+    NodeAddr attach(MLoopbackProtocol* proto);
+    void detach(MLoopbackProtocol* proto);
+    bool send(const NodeAddr& src, const NodeAddr& dest, const uint8_t* wire, uint8_t len);
+    //! Receive into `wire`, which must have room for `MAX_TAGGED_LENGTH` bytes.
+    bool receive(const NodeAddr& dest, NodeAddr& src, uint8_t* wire, uint8_t& len);
+    uint32_t random();
+
+    struct InFlight {
+        unsigned long deliverAtUS;
+        NodeAddr src, dest;
+        uint8_t length;
+        uint8_t wire[MAX_TAGGED_LENGTH];
+    };
+    std::vector<InFlight> inFlight_;
+    std::vector<MLoopbackProtocol*> protocols_;
+
+    Callback<unsigned long()> usClock_;
+    unsigned long latencyUS_, jitterUS_;
+    float lossRate_, duplicateRate_;
+    uint8_t maxWireLength_;
+    uint32_t rand_;
+    uint8_t nextAddr_;
+    unsigned long numSent_, numLost_, numDelivered_, numDuplicated_, numBytesSent_;
+};
+
+//! Monaco-over-Loopback Protocol, for simulation and testing without radios.
+class MLoopbackProtocol: public MProtocol {
+public:
+    MLoopbackProtocol(MLoopbackMedium& medium);
+    virtual ~MLoopbackProtocol();
+
+    virtual ProtocolType protocolType() { return MONACO_LOOPBACK; }
+
+    virtual bool init(const std::string& nodeName);
+
+    //! Return the address this protocol has on the medium.
+    const NodeAddr& address() const { return addr_; }
+
+    virtual bool acceptsPairingRequests() { return acceptsPairingRequests_; }
+    void setAcceptsPairingRequests(bool accepts) { acceptsPairingRequests_ = accepts; }
+
+    virtual bool discoverNodes(float timeout = 5);
+
+    virtual bool step();
+
+    virtual bool sendPacket(const NodeAddr& addr, MPacket& packet, bool bumpSeqnum=true);
+    virtual bool sendBroadcastPacket(MPacket& packet, bool bumpSeqnum=true);
+    virtual uint8_t maxWireLength() { return medium_.maxWireLength(); }
+
+    virtual bool waitForPacket(const Callback<bool(const MPacket&, const NodeAddr&)>& fn, 
+                               NodeAddr& addr, MPacket& packet, 
+                               bool handleOthers, float timeout);
+
+protected:
+    virtual bool sendWire(const NodeAddr& addr, const uint8_t* wire, uint8_t len, bool bumpSeqnum);
+
+    MLoopbackMedium& medium_;
+    NodeAddr addr_;
+    bool acceptsPairingRequests_;
+    unsigned int blocking_;
+};
+
+}; // rmt
+}; // bb
+
+#endif // BBRMLOOPBACKPROTOCOL_H
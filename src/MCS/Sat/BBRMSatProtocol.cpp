@@ -3,7 +3,7 @@
 using namespace bb;
 using namespace bb::rmt;
 
-MSatProtocol::MSatProtocol(): serialRecStr_(""), ser_(nullptr) {
+MSatProtocol::MSatProtocol(): framing_(FRAMING_BINARY), ser_(nullptr) {
 }
 
 
@@ -19,36 +19,61 @@ bool MSatProtocol::init(HardwareSerial* ser) {
 }
 
 bool MSatProtocol::step() {
+    BBR_PROFILE_STEP();
     if(ser_ == nullptr) return false;
 
     if(ser_->available() == false) {
         return false;
     }
 
-	while(ser_->available()) {
-		char b = ser_->read();
-		serialRecStr_ = serialRecStr_ + b;
-		if(b == ']') {
-			MPacket packet;
-			if(deserializePacket(packet, serialRecStr_)) {
-                // bb::rmt::printf("Got packet type %d, primary %d\n", packet.type, packet.type == MPacket::PACKET_TYPE_CONTROL ? packet.payload.control.primary : 0);
-                // if(packet.type == MPacket::PACKET_TYPE_CONTROL) {
-                //     bb::rmt::printf("Axis 0: %f\n", packet.payload.control.getAxis(0));
-                //}
+	{
+		BBR_PROFILE_PHASE(PHASE_RECEIVE);
+		while(ser_->available()) {
+			switch(decoder_.feed(ser_->read())) {
+			case MFrameDecoder::FRAME_COMPLETE: {
+				// Dispatched straight from the decoder buffer -- length and CRC are checked there
 				NodeAddr addr;
-				incomingPacket(addr, packet);
+				uint8_t len = decoder_.length();
+				BBR_PROFILE_PHASE(PHASE_DISPATCH);
+				if(checkIntegrity(addr, decoder_.data(), len)) incomingPacket(addr, MPacketView(decoder_.data(), len));
+				break;
 			}
-			serialRecStr_ = "";
-		}
-	}	
+			case MFrameDecoder::FRAME_ERROR:
+				stats_.framingErrors++;
+				break;
+			default:
+				break;
+			}
+		}	
+	}
 	return MProtocol::step();
 }
 
+bool MSatProtocol::sendPacket(const NodeAddr& addr, MPacket& packet, bool bumpS) {
+    if(ser_ == nullptr) return false;
+    finishPacket(packet);
+
+    uint8_t wire[sizeof(MPacket)];
+    uint8_t len = packet.toWire(wire);
+    return sendFrame(addr, wire, len, bumpS);
+}
+
+bool MSatProtocol::sendWire(const NodeAddr& addr, const uint8_t* wire, uint8_t len, bool bumpS) {
+    if(ser_ == nullptr) return false;
+    uint8_t frame[MAX_FRAME_LENGTH];
+    len = encodeFrame(wire, len, framing_, frame);
+    if(len == 0) return false;
+    bool ok = ser_->write(frame, len) == len;
+    countSent(addr, ok);
+    if(ok && bumpS) bumpSeqnum();
+    return ok;
+}
+
 void MSatProtocol::printInfo() {
 
 }
 
-bool MSatProtocol::waitForPacket(std::function<bool(const MPacket&, const NodeAddr& )> fn, 
+bool MSatProtocol::waitForPacket(const Callback<bool(const MPacket&, const NodeAddr&)>& fn, 
                                  NodeAddr& addr, MPacket& packet, 
                                  bool handleOthers, float timeout) {
     return false;
@@ -2,11 +2,17 @@
 #define BBRMSATPROTOCOL_H
 
 #include "../BBRMProtocol.h"
+#include "../BBRMFraming.h"
 
 namespace bb {
 namespace rmt {
 
-//! Monaco-over-Serial Satellite Protocol
+/**
+ * Monaco-over-Serial Satellite Protocol.
+ * 
+ * Packets go over the serial port as COBS frames (see `BBRMFraming.h`), or as hex strings for debugging. 
+ * Received frames may use either framing, so the sending side can switch to hex with `setFraming()` at any time.
+ */
 class MSatProtocol: public MProtocol {
 public:
     MSatProtocol();
@@ -26,10 +32,16 @@ public:
     virtual bool discoverNodes(float timeout = 5) { return false; }
 
     virtual bool step();
-    virtual bool sendPacket(const NodeAddr& addr, MPacket& packet, bool bumpSeqnum=true) { return false; }
-    virtual bool sendBroadcastPacket(MPacket& packet, bool bumpSeqnum=true) { return false; }
+    virtual bool sendPacket(const NodeAddr& addr, MPacket& packet, bool bumpSeqnum=true);
+    virtual bool sendBroadcastPacket(MPacket& packet, bool bumpSeqnum=true) { return sendPacket(NodeAddr(), packet, bumpSeqnum); }
+    //! Frames carry anything up to `MAX_FRAMED_LENGTH` bytes.
+    virtual uint8_t maxWireLength() { return MAX_FRAMED_LENGTH; }
 
-    virtual bool waitForPacket(std::function<bool(const MPacket&, const NodeAddr& )> fn, 
+    //! Framing for packets we send. Defaults to `FRAMING_BINARY`.
+    void setFraming(MFraming framing) { framing_ = framing; }
+    MFraming framing() { return framing_; }
+
+    virtual bool waitForPacket(const Callback<bool(const MPacket&, const NodeAddr&)>& fn, 
                                NodeAddr& addr, MPacket& packet, 
                                bool handleOthers, float timeout);
 
@@ -37,7 +49,10 @@ public:
     virtual void printInfo();
 
 protected:
-    std::string serialRecStr_;
+    virtual bool sendWire(const NodeAddr& addr, const uint8_t* wire, uint8_t len, bool bumpSeqnum);
+
+    MFrameDecoder decoder_;
+    MFraming framing_;
     HardwareSerial* ser_;
 };
 
@@ -4,6 +4,7 @@
 
 #include "BBRMXBProtocol.h"
 #include "BBRTypes.h"
+#include "BBRLog.h"
 
 // ACTION PLAN
 // 1. Remove all bb Subsystem dependencies - CHECK
@@ -194,21 +195,30 @@ bool MXBProtocol::init(const std::string& nodeName, uint16_t chan, uint16_t pan,
 }
 
 bool MXBProtocol::step() {
+	BBR_PROFILE_STEP();
 	int packetsHandled = 0;
 	while(available()) {
 		if(apiMode_) {
 			NodeAddr srcAddr;
-			uint8_t rssi;
-			MPacket packet;
-			if(receiveAPIMode(srcAddr, rssi, packet) == false) {
+			uint8_t rssi, offset;
+			APIFrame frame;
+			bool received;
+			{
+				BBR_PROFILE_PHASE(PHASE_RECEIVE);
+				received = receiveAPIModeFrame(frame, srcAddr, rssi, offset);
+			}
+			if(received == false) {
 				//printf("receiveAPIMode(): Failure\n");
 				continue;
 			}
-			//printf("Received packet from %lx:%lx type %d\n", srcAddr.addrHi(), srcAddr.addrLo(), packet.type);
-			MProtocol::incomingPacket(srcAddr, packet);
+			// Dispatched straight from the frame buffer -- length and CRC are checked there
+			BBR_PROFILE_PHASE(PHASE_DISPATCH);
+			uint8_t len = frame.length() - offset;
+			if(!checkIntegrity(srcAddr, frame.data() + offset, len)) continue;
+			MProtocol::incomingPacket(srcAddr, MPacketView(frame.data() + offset, len));
 			packetsHandled++;
 		} else {
-			printf("Stuff available but not in API mode\n");
+			BBR_LOGW("Stuff available but not in API mode\n");
 		}
 	}
 
@@ -254,13 +264,9 @@ bool MXBProtocol::enterATModeIfNecessary() {
 	int numDiscardedBytes = 0;
 
 	for(int timeout = 0; timeout < 1000; timeout++) {
-		if(uart_->available()) {
-			printf("discarding ");
-			while(uart_->available())  {
-				uart_->read();
-				printf(".");
-				numDiscardedBytes++;
-			}
+		while(uart_->available())  {
+			uart_->read();
+			numDiscardedBytes++;
 		}
 		delay(1);
 	}
@@ -303,7 +309,7 @@ bool MXBProtocol::enterATModeIfNecessary() {
 
 	if(success) {
 		if(numDiscardedBytes) {
-			printf(" discarded %d bytes while entering AT mode...", numDiscardedBytes);
+			BBR_LOGD("Discarded %d bytes while entering AT mode\n", numDiscardedBytes);
 		}
 		atmode_millis_ = millis();
 		atmode_ = true;
@@ -427,12 +433,16 @@ bool MXBProtocol::sendBroadcastPacket(MPacket& packet, bool bumpSeqnum) {
 }
 
 bool MXBProtocol::sendPacket(const NodeAddr& dest, MPacket& packet, bool bumpS) {
-	uint8_t buf[11+sizeof(packet)];
-	bool ack = false;
+	finishPacket(packet);
 
-	packet.seqnum = seqnum_;
-	packet.source = source_;
-	packet.crc = packet.calculateCRC();
+	uint8_t wire[sizeof(MPacket)];
+	uint8_t len = packet.toWire(wire);
+	return sendFrame(dest, wire, len, bumpS);
+}
+
+bool MXBProtocol::sendWire(const NodeAddr& dest, const uint8_t* wire, uint8_t len, bool bumpS) {
+	uint8_t buf[11+MAX_TAGGED_LENGTH];
+	bool ack = false;
 
 	buf[0] = 0x0;  // transmit request - 64bit frame. This is deprecated.
 	buf[1] = 0x0;  // no response frame
@@ -450,13 +460,15 @@ bool MXBProtocol::sendPacket(const NodeAddr& dest, MPacket& packet, bool bumpS)
 		buf[10] = 0;						// Use default value of TO
 	}
 
-	memcpy(&(buf[11]), &packet, sizeof(packet));
-	//printf("Sending %d bytes with 0x%x to 0x%lx:%lx - ", sizeof(packet)+11, buf[0], dest.addrHi(), dest.addrLo());
+	memcpy(&(buf[11]), wire, len);
+	//printf("Sending %d bytes with 0x%x to 0x%lx:%lx - ", len+11, buf[0], dest.addrHi(), dest.addrLo());
 	//for(int i=2; i<=9; i++) printf("%02x", buf[i]);
 	//printf("\n");
 
-	APIFrame frame(buf, 11+sizeof(packet));
-	if(send(frame) == true) {
+	APIFrame frame(buf, 11+len);
+	bool ok = send(frame);
+	countSent(dest, ok);
+	if(ok == true) {
 		if(bumpS) bumpSeqnum();
 		return true;
 	}
@@ -468,14 +480,12 @@ bool MXBProtocol::available() {
 	return uart_->available();
 }
 
-bool MXBProtocol::receiveAPIMode(NodeAddr& srcAddr, uint8_t& rssi, MPacket& packet) {
+bool MXBProtocol::receiveAPIModeFrame(APIFrame& frame, NodeAddr& srcAddr, uint8_t& rssi, uint8_t& packetOffset) {
 	if(!apiMode_) {
-		printf("Wrong mode.\n");
+		BBR_LOGW("Wrong mode.\n");
 		return false;
 	} 
 
-	APIFrame frame;
-
 	if(receive(frame) != true) {
 		//printf("receive(): failure\n");
 		return false;
@@ -484,17 +494,19 @@ bool MXBProtocol::receiveAPIMode(NodeAddr& srcAddr, uint8_t& rssi, MPacket& pack
 	//printf("Received frame of length %d, first char 0x%x\n", frame.length(), frame.data()[0]);
 
 	if(frame.is16BitRXPacket()) { // 16bit address frame
-		printf("16bit address packet!\n");
-		if(frame.length() != sizeof(MPacket) + 5) {
-			printf("Invalid API Mode 16bit addr packet size %d (expected %d)\n", frame.length(), sizeof(MPacket) + 5);
+		BBR_LOGD("16bit address packet!\n");
+		if(frame.length() < 5) {
+			BBR_LOGW("Invalid API Mode 16bit addr packet size %d\n", frame.length());
+			stats_.sizeErrors++;
 			return false;
 		}
 		srcAddr.fromXBeeAddress(0, uint32_t(frame.data()[1] << 8) | frame.data()[2]);
 		rssi = frame.data()[3];
-		memcpy(&packet, &(frame.data()[5]), sizeof(packet));
+		packetOffset = 5;
 	} else if(frame.is64BitRXPacket()) { // 64bit address frame
-		if(frame.length() != sizeof(MPacket) + 11) {
-			printf("Invalid API Mode 64bit addr packet size %d (expected %d -- MPacket is %d)\n", frame.length(), sizeof(MPacket) + 11, sizeof(MPacket));
+		if(frame.length() < 11) {
+			BBR_LOGW("Invalid API Mode 64bit addr packet size %d\n", frame.length());
+			stats_.sizeErrors++;
 			return false;
 		}
 		srcAddr.fromXBeeAddress((uint32_t(frame.data()[1]) << 24) | (uint32_t(frame.data()[2]) << 16) |
@@ -502,28 +514,49 @@ bool MXBProtocol::receiveAPIMode(NodeAddr& srcAddr, uint8_t& rssi, MPacket& pack
 					        	(uint32_t(frame.data()[5]) << 24) | (uint32_t(frame.data()[6]) << 16) |
 				         		(uint32_t(frame.data()[7]) <<  8) | uint32_t(frame.data()[8]));
 		rssi = frame.data()[9];
-		memcpy(&packet, &(frame.data()[11]), sizeof(packet));
-#if 0
-		printf("Source addr: 0x%0lx:%0lx \n", srcAddr.addrHi, srcAddr.addrLo);
-		printf("Source: %d Type: %d Seqnum: %d\n", packet.source, packet.type, packet.seqnum);
-#endif
+		packetOffset = 11;
 	} else {
-		printf("Unknown frame type 0x%x\n", frame.data()[0]);
+		BBR_LOGW("Unknown frame type 0x%x\n", frame.data()[0]);
+		stats_.packetsDropped++;
 		return false;
 	}
 
-	uint8_t crc = packet.calculateCRC();
-	if(packet.calculateCRC() != packet.crc) {
+	return true;
+}
+
+bool MXBProtocol::receiveAPIMode(NodeAddr& srcAddr, uint8_t& rssi, MPacket& packet) {
+	APIFrame frame;
+	uint8_t offset;
+	if(receiveAPIModeFrame(frame, srcAddr, rssi, offset) == false) return false;
+
+	uint8_t len = frame.length() - offset;
+	if(!checkIntegrity(srcAddr, frame.data() + offset, len)) {
+		if(debug_ & DEBUG_XBEE_COMM) BBR_LOGD("Error: Wrong integrity tag\n");
+		return false;
+	}
+	MPacketView view(frame.data() + offset, len);
+	if(!view.validLength()) {
+		BBR_LOGW("Invalid API Mode packet size %d\n", int(view.length()));
+		stats_.sizeErrors++;
+		return false;
+	}
+	if(!view.validCRC()) {
 		if(debug_ & DEBUG_XBEE_COMM) {
-			printf("Error: Wrong CRC 0x%x, expected 0x%x\n", crc, packet.crc);
+			BBR_LOGD("Error: Wrong CRC 0x%x, expected 0x%x\n", view.crc(), view.calculateCRC());
 		}
+		stats_.crcErrors++;
+		return false;
+	}
+	if(!view.isMPacket()) { // not an MPacket -- dispatch it right away, nobody waits for control frames
+		MProtocol::incomingPacket(srcAddr, view);
 		return false;
 	}
 
+	packet.fromWire(view.data(), view.length());
 	return true;
 }
 
-bool MXBProtocol::waitForPacket(std::function<bool(const MPacket&, const NodeAddr&)> fn, 
+bool MXBProtocol::waitForPacket(const Callback<bool(const MPacket&, const NodeAddr&)>& fn, 
                                 NodeAddr& addr, MPacket& packet, 
                                 bool handleOthers, float timeout) {
     bool retval = false;
@@ -903,7 +936,7 @@ bool MXBProtocol::send(const APIFrame& frame) {
 }
 
 
-static bool waitfor(std::function<bool(void)> fn, uint8_t timeout) {
+static bool waitfor(const Callback<bool(void)>& fn, uint8_t timeout) {
 	while(fn() == false && timeout>0) {
 		delayMicroseconds(1);
 		timeout = timeout - 1;
@@ -927,6 +960,7 @@ bool MXBProtocol::receive(APIFrame& frame) {
 			break;
 		} else {
 			garbageBytes++;
+			stats_.garbageBytes++;
 			if(garbageBytes > 1000) {
 				printf("Read 1000 garbage bytes\n");
 				garbageBytes = 0;
@@ -942,15 +976,22 @@ bool MXBProtocol::receive(APIFrame& frame) {
 
 	//if(!uart_->available()) delayMicroseconds(200);
 	//if(!uart_->available()) return false;	
-	if(waitfor([this]()->bool {return uart_->available();}, 200) == false) return false;
+	if(waitfor([this]()->bool {return uart_->available();}, 200) == false) {
+		stats_.framingErrors++;
+		return false;
+	}
 	uint8_t lengthMSB = readEscapedByte(uart_);
-	if(waitfor([this]()->bool {return uart_->available();}, 200) == false) return false;
+	if(waitfor([this]()->bool {return uart_->available();}, 200) == false) {
+		stats_.framingErrors++;
+		return false;
+	}
 	//if(!uart_->available()) delayMicroseconds(200);
 	//if(!uart_->available()) return false;	
 	uint8_t lengthLSB = readEscapedByte(uart_);
 
 	if(lengthLSB == 0x7e || lengthMSB == 0x7e) {
 		printf("Extra start delimiter found\n");
+		stats_.framingErrors++;
 		return false;		
 	}
 
@@ -959,18 +1000,25 @@ bool MXBProtocol::receive(APIFrame& frame) {
 	uint8_t *buf = frame.data();
 	for(uint16_t i=0; i<length; i++) {
 		//printf("Reading byte %d of %d\n", i, length);
-		if(waitfor([this]()->bool {return uart_->available();}, 200) == false) return false;
+		if(waitfor([this]()->bool {return uart_->available();}, 200) == false) {
+			stats_.framingErrors++;
+			return false;
+		}
 		//if(!uart_->available()) delayMicroseconds(200);
 		buf[i] = readEscapedByte(uart_);
 	}
 	frame.calcChecksum();
 
-	if(waitfor([this]()->bool {return uart_->available();}, 200) == false) return false;
+	if(waitfor([this]()->bool {return uart_->available();}, 200) == false) {
+		stats_.framingErrors++;
+		return false;
+	}
 	//if(!uart_->available()) delayMicroseconds(200);
 	uint8_t checksum = readEscapedByte(uart_);
 
 	if(frame.verifyChecksum(checksum) == false) {
 		//printf("Checksum invalid - expected 0x%x, got 0x%x\n", frame.checksum(), checksum);
+		stats_.framingErrors++;
 		return false;
 	}
 
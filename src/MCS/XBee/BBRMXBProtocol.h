@@ -79,8 +79,10 @@ public:
 
     virtual bool sendPacket(const NodeAddr& addr, MPacket& packet, bool bumpSeqnum=true);
     virtual bool sendBroadcastPacket(MPacket& packet, bool bumpSeqnum=true);
+    //! 802.15.4 XBees carry up to 100 payload bytes per frame.
+    virtual uint8_t maxWireLength() { return 100; }
 
-    virtual bool waitForPacket(std::function<bool(const MPacket&, const NodeAddr&)> fn, 
+    virtual bool waitForPacket(const Callback<bool(const MPacket&, const NodeAddr&)>& fn, 
                                NodeAddr& addr, MPacket& packet, 
                                bool handleOthers, float timeout);
 
@@ -109,6 +111,7 @@ protected:
 	bool setAPIMode(bool onoff);
 	bool sendAPIModeATCommand(uint8_t frameID, const char* cmd, uint32_t& argument, bool request=false);
 	bool receiveAPIMode(NodeAddr& srcAddr, uint8_t& rssi, MPacket& packet);
+	virtual bool sendWire(const NodeAddr& dest, const uint8_t* wire, uint8_t len, bool bumpS);
 
 protected:
 	DebugFlags debug_;
@@ -206,6 +209,8 @@ protected:
 
 	bool send(const APIFrame& frame);
 	bool receive(APIFrame& frame);
+	//! Receive an RX frame and parse its header. The packet is at `frame.data()+packetOffset`, not yet validated.
+	bool receiveAPIModeFrame(APIFrame& frame, NodeAddr& srcAddr, uint8_t& rssi, uint8_t& packetOffset);
 };
 
 }; // rmt